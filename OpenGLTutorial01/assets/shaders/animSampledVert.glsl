@@ -0,0 +1,77 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec4 aQTangent;	// Tangent frame as a quaternion, w's sign is the bitangent's handedness
+layout (location = 5) in ivec4 aBoneIDs;
+layout (location = 6) in vec4 aBoneWeights;
+layout (location = 7) in mat4 aInstanceModel;	// Takes 7 to 10
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Palettes written by clipSampleVert.glsl, numBones bones per instance, sub-mesh palettes back to back
+uniform samplerBuffer sampledPalette;
+uniform int numBones;
+// Where this sub-mesh's palette starts in an instance's bones
+uniform int meshBoneOffset;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec3 fTangent;
+out vec3 fBitangent;
+
+vec4 boneRow0;
+vec4 boneRow1;
+vec4 boneRow2;
+
+void AddBone(int bone, float weight)
+{
+	int texel = (gl_InstanceID * numBones + meshBoneOffset + bone) * 3;
+	boneRow0 += texelFetch(sampledPalette, texel) * weight;
+	boneRow1 += texelFetch(sampledPalette, texel + 1) * weight;
+	boneRow2 += texelFetch(sampledPalette, texel + 2) * weight;
+}
+
+vec3 RotateByBone(vec3 direction)
+{
+	return vec3(dot(boneRow0.xyz, direction), dot(boneRow1.xyz, direction), dot(boneRow2.xyz, direction));
+}
+
+// Rebuilds the tangent and bitangent from the packed quaternion
+void DecodeQTangent(vec4 q, out vec3 tangent, out vec3 bitangent)
+{
+	q = normalize(q);
+	tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+	bitangent = vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+	bitangent *= (q.w < 0.0) ? -1.0 : 1.0;
+}
+
+void main()
+{
+	boneRow0 = vec4(0.0);
+	boneRow1 = vec4(0.0);
+	boneRow2 = vec4(0.0);
+	AddBone(aBoneIDs[0], aBoneWeights[0]);
+	AddBone(aBoneIDs[1], aBoneWeights[1]);
+	AddBone(aBoneIDs[2], aBoneWeights[2]);
+	AddBone(aBoneIDs[3], aBoneWeights[3]);
+
+	vec4 vertPosition = vec4(aPos, 1.0);
+	vertPosition = vec4(dot(boneRow0, vertPosition), dot(boneRow1, vertPosition), dot(boneRow2, vertPosition), 1.0);
+	vec4 worldPosition = aInstanceModel * vertPosition;
+	gl_Position = projection * (view * worldPosition);
+
+	// Crowd instances are only ever uniformly scaled, so no inverse is needed for the normals
+	mat3 matNormal = mat3(aInstanceModel);
+	Normal = normalize(matNormal * RotateByBone(aNormal));
+	vec3 tangent, bitangent;
+	DecodeQTangent(aQTangent, tangent, bitangent);
+	fTangent = matNormal * RotateByBone(tangent);
+	fBitangent = matNormal * RotateByBone(bitangent);
+
+	FragPos = worldPosition.xyz;
+	TexCoords = aTexCoord;
+}
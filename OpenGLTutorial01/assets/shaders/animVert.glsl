@@ -1,20 +1,26 @@
 #version 430
+// Permutations:
+//   UNIFORM_SCALE - the model matrix has no shear or uneven scale, so it can transform normals itself
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
-layout (location = 5) in vec4 aBoneIDs;
+layout (location = 3) in vec4 aQTangent;	// Tangent frame as a quaternion, w's sign is the bitangent's handedness
+layout (location = 5) in ivec4 aBoneIDs;
 layout (location = 6) in vec4 aBoneWeights;
 
 uniform mat4 model;
+#ifndef UNIFORM_SCALE
+// transpose(inverse(mat3(model))), worked out once per draw on the CPU
+uniform mat3 normalMatrix;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
-const int MAXNUMBEROFBONES = 100;
-uniform mat4 bones[MAXNUMBEROFBONES];
-// Pass the acutal number you are using to control how often this loops
-uniform int numBonesUsed;
+// Every character's bones for the frame live in one texture buffer,
+// three texels (the rows of a 3x4 matrix) per bone. paletteOffset is where this
+// sub-mesh's local palette starts; aBoneIDs index into that palette.
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -22,33 +28,63 @@ out vec2 TexCoords;
 out vec3 fTangent;		// For bump (or normal) mapping
 out vec3 fBitangent;	// For bump (or normal) mapping
 
+vec4 boneRow0;
+vec4 boneRow1;
+vec4 boneRow2;
+
+void AddBone(int index, float weight)
+{
+	int texel = (paletteOffset + index) * 3;
+	boneRow0 += texelFetch(bonePalette, texel) * weight;
+	boneRow1 += texelFetch(bonePalette, texel + 1) * weight;
+	boneRow2 += texelFetch(bonePalette, texel + 2) * weight;
+}
+
+// Bones only rotate and translate, so the blended rotation can take the normals as is
+vec3 RotateByBone(vec3 direction)
+{
+	return vec3(dot(boneRow0.xyz, direction), dot(boneRow1.xyz, direction), dot(boneRow2.xyz, direction));
+}
+
+// Rebuilds the tangent and bitangent from the packed quaternion
+void DecodeQTangent(vec4 q, out vec3 tangent, out vec3 bitangent)
+{
+	q = normalize(q);
+	tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+	bitangent = vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+	bitangent *= (q.w < 0.0) ? -1.0 : 1.0;
+}
+
 void main()
 {
-    //gl_Position = MVP * vec4(vPos, 0.0, 1.0);	
+	boneRow0 = vec4(0.0);
+	boneRow1 = vec4(0.0);
+	boneRow2 = vec4(0.0);
+	AddBone( aBoneIDs[0], aBoneWeights[0] );
+	AddBone( aBoneIDs[1], aBoneWeights[1] );
+	AddBone( aBoneIDs[2], aBoneWeights[2] );
+	AddBone( aBoneIDs[3], aBoneWeights[3] );
+
 	vec4 vertPosition = vec4(aPos, 1.0f);
-	
-	mat4 matModel = model;	
+	vertPosition = vec4(dot(boneRow0, vertPosition), dot(boneRow1, vertPosition), dot(boneRow2, vertPosition), 1.0);
 
-	mat4 BoneTransform = bones[ int(aBoneIDs[0]) ] * aBoneWeights[0];
-	BoneTransform += bones[ int(aBoneIDs[1]) ] * aBoneWeights[1];
-	BoneTransform += bones[ int(aBoneIDs[2]) ] * aBoneWeights[2];
-	BoneTransform += bones[ int(aBoneIDs[3]) ] * aBoneWeights[3];
-	vertPosition = BoneTransform * vertPosition;
-	
-	mat4 matMVP = projection * view * model;		// m = p * v * m;
+	vec4 worldPosition = model * vertPosition;
 	
 	// Final screen space position	
-	gl_Position = matMVP * vertPosition;	
-	
-	// Inverse transform to keep ONLY rotation...
-	mat4 matNormal = inverse( transpose(BoneTransform * model) );
+	gl_Position = projection * (view * worldPosition);
 	
-	Normal = mat3(matNormal) * normalize(aNormal.xyz);
-	fTangent = 	mat3(matNormal) * normalize(aTangent.xyz);
-	fBitangent = 	mat3(matNormal) * normalize(aBitangent.xyz);
+#ifdef UNIFORM_SCALE
+	// Only the length is off, and every user of the normal normalizes it
+	mat3 normalMatrix = mat3(model);
+#endif
+	Normal = normalMatrix * RotateByBone(aNormal);
+	vec3 tangent, bitangent;
+	DecodeQTangent(aQTangent, tangent, bitangent);
+	fTangent = normalMatrix * RotateByBone(tangent);
+	fBitangent = normalMatrix * RotateByBone(bitangent);
 	
-	FragPos = (model * vertPosition).xyz;
+	FragPos = worldPosition.xyz;
 	
 	TexCoords = aTexCoord;			// Sent to fragment shader
 
-}		
\ No newline at end of file
+}
@@ -0,0 +1,113 @@
+#version 330 core
+
+// Builds a whole crowd's bone palettes from clip curves, with transform feedback.
+// Drawn as numBones points per instance: each point samples its bone's chain of local
+// transforms, composes them up to the root and writes the bone's three palette rows.
+
+// Per instance (divisor 1)
+layout (location = 0) in ivec2 aClips;			// Clip played, clip blended towards
+layout (location = 1) in vec2 aTimeOffsets;		// Seconds added to time for each clip
+layout (location = 2) in float aBlend;			// 0 plays aClips.x, 1 plays aClips.y
+
+// Column per node (rows 0-2) or per palette bone (rows 3-6), see cClipCurves
+uniform sampler2D clipSkeleton;
+// Row per frame, column per animated node
+uniform sampler2D clipRotations;
+uniform sampler2D clipTranslations;
+// First frame and number of frames of each clip
+uniform ivec2 clipFrames[16];
+uniform float framesPerSecond;
+uniform float time;
+uniform mat4 globalInverse;
+
+// Captured in this order, three texels per bone like cBonePalette
+out vec4 boneRow0;
+out vec4 boneRow1;
+out vec4 boneRow2;
+
+vec4 QuatMultiply(vec4 a, vec4 b)
+{
+	return vec4(a.w * b.xyz + b.w * a.xyz + cross(a.xyz, b.xyz), a.w * b.w - dot(a.xyz, b.xyz));
+}
+
+vec3 QuatRotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Blends two keys, taking whichever of q and -q is nearer so the rotation goes the short way
+void BlendKeys(vec4 rotation0, vec4 translation0, vec4 rotation1, vec4 translation1, float blend, out vec4 rotation, out vec4 translation)
+{
+	rotation1 *= (dot(rotation0, rotation1) < 0.0) ? -1.0 : 1.0;
+	rotation = normalize(mix(rotation0, rotation1, blend));
+	translation = mix(translation0, translation1, blend);
+}
+
+void SampleClip(int clip, float clipTime, int track, out vec4 rotation, out vec4 translation)
+{
+	ivec2 frames = clipFrames[clip];
+	float frame = clipTime * framesPerSecond;
+	int frame0 = int(mod(floor(frame), float(frames.y)));
+	int frame1 = (frame0 + 1) % frames.y;
+
+	BlendKeys(texelFetch(clipRotations, ivec2(track, frames.x + frame0), 0), texelFetch(clipTranslations, ivec2(track, frames.x + frame0), 0),
+		texelFetch(clipRotations, ivec2(track, frames.x + frame1), 0), texelFetch(clipTranslations, ivec2(track, frames.x + frame1), 0),
+		fract(frame), rotation, translation);
+}
+
+// Local transform of one node for this instance, translation in xyz and uniform scale in w
+void LocalTransform(int node, int track, out vec4 rotation, out vec4 translation)
+{
+	if (track < 0)
+	{
+		rotation = texelFetch(clipSkeleton, ivec2(node, 1), 0);
+		translation = texelFetch(clipSkeleton, ivec2(node, 2), 0);
+		return;
+	}
+
+	SampleClip(aClips.x, time + aTimeOffsets.x, track, rotation, translation);
+	if (aBlend > 0.0)
+	{
+		vec4 rotationTo, translationTo;
+		SampleClip(aClips.y, time + aTimeOffsets.y, track, rotationTo, translationTo);
+		BlendKeys(rotation, translation, rotationTo, translationTo, aBlend, rotation, translation);
+	}
+}
+
+void main()
+{
+	int bone = gl_VertexID;
+	int node = int(texelFetch(clipSkeleton, ivec2(bone, 3), 0).x);
+
+	// Walk up to the root, putting each parent in front of what we have so far.
+	// With one scale per node this stays a quaternion, a translation and a scale.
+	vec4 rotation = vec4(0.0, 0.0, 0.0, 1.0);
+	vec4 translation = vec4(0.0, 0.0, 0.0, 1.0);
+	for (int depth = 0; node >= 0 && depth < 256; depth++)
+	{
+		vec4 nodeInfo = texelFetch(clipSkeleton, ivec2(node, 0), 0);
+		vec4 nodeRotation, nodeTranslation;
+		LocalTransform(node, int(nodeInfo.y), nodeRotation, nodeTranslation);
+
+		translation = vec4(nodeTranslation.xyz + nodeTranslation.w * QuatRotate(nodeRotation, translation.xyz), nodeTranslation.w * translation.w);
+		rotation = QuatMultiply(nodeRotation, rotation);
+		node = int(nodeInfo.x);
+	}
+
+	mat4 objectTransform = mat4(vec4(QuatRotate(rotation, vec3(1.0, 0.0, 0.0)) * translation.w, 0.0),
+		vec4(QuatRotate(rotation, vec3(0.0, 1.0, 0.0)) * translation.w, 0.0),
+		vec4(QuatRotate(rotation, vec3(0.0, 0.0, 1.0)) * translation.w, 0.0),
+		vec4(translation.xyz, 1.0));
+	mat4 boneOffset = transpose(mat4(texelFetch(clipSkeleton, ivec2(bone, 4), 0),
+		texelFetch(clipSkeleton, ivec2(bone, 5), 0),
+		texelFetch(clipSkeleton, ivec2(bone, 6), 0),
+		vec4(0.0, 0.0, 0.0, 1.0)));
+
+	mat4 finalTransform = globalInverse * objectTransform * boneOffset;
+	boneRow0 = vec4(finalTransform[0][0], finalTransform[1][0], finalTransform[2][0], finalTransform[3][0]);
+	boneRow1 = vec4(finalTransform[0][1], finalTransform[1][1], finalTransform[2][1], finalTransform[3][1]);
+	boneRow2 = vec4(finalTransform[0][2], finalTransform[1][2], finalTransform[2][2], finalTransform[3][2]);
+
+	// Rasterization is discarded, but the position still has to be written
+	gl_Position = vec4(0.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+void main()
+{
+	//Flat grey, enough to see where things are
+	FragColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
\ No newline at end of file
@@ -1,4 +1,11 @@
 #version 330 core
+// Permutations, matching vertShader.glsl:
+//   LIT (default), REFLECT or REFRACT
+//   NUM_POINT_LIGHTS - how many of the block's point lights are lit, defaults to all of them
+#if !defined(REFLECT) && !defined(REFRACT)
+#define LIT
+#endif
+
 out vec4 FragColor;
 
 struct Material
@@ -17,49 +24,17 @@ struct Material
 	float shininess;
 };
 
-struct DirLight
-{
-	vec3 direction;
-	
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-struct PointLight
-{
-	vec3 position;
-	
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-struct SpotLight
-{
-	vec3 position;
-	vec3 direction;
-	float cutOff;
-	float outerCutOff;
-	
-	float constant;
-	float linear;
-	float quadratic;
-	
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
+#include "lights.glsl"
 
+#ifdef LIT
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+#elif defined(REFLECT)
 in vec3 reflectedVector;
+#else
 in vec3 refractedVector;
+#endif
 
 uniform samplerCube skybox;
 
@@ -67,14 +42,12 @@ uniform vec3 objectColor;
 uniform vec3 lightColor;
 uniform vec3 lightPos;
 uniform vec3 cameraPos;
-uniform int reflectRefract;
 
-#define NUM_POINT_LIGHTS 4
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS MAX_POINT_LIGHTS
+#endif
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NUM_POINT_LIGHTS];
-uniform SpotLight spotLight;
 
 float near = 0.1;
 float far = 100.0;
@@ -90,40 +63,33 @@ void main()
 	//float depth = LinearizeDepth(gl_FragCoord.z) / far; // divide by far for demonstration
     //FragColor = vec4(vec3(depth), 1.0);
 	
-	if (reflectRefract == 0)
-	{
-		//Using textures and lighting
-		vec3 norm = normalize(Normal);
-		vec3 viewDir = normalize(cameraPos - FragPos);
-		
-		vec3 result = CalcDirLight(dirLight, norm, viewDir);
-		
-		for (int i = 0; i < NUM_POINT_LIGHTS; i++)
-		{
-			result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
-		}
-		
-		result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
-		
-		FragColor = vec4(result, 1.0);
-	}
+#if defined(REFLECT)
+	//Using a reflected skybox
+	vec4 reflectedColour = vec4(texture(skybox, reflectedVector).rgb, 1.0);
+	FragColor = reflectedColour;
+#elif defined(REFRACT)
+	//Refracting the skybox
+	vec4 refractedColour = vec4(texture(skybox, refractedVector).rgb, 1.0);
+	FragColor = refractedColour;
+#else
+	//Using textures and lighting
+	vec3 norm = normalize(Normal);
+	vec3 viewDir = normalize(cameraPos - FragPos);
 	
-	else if (reflectRefract == 1)
-	{
-		//Using a reflected skybox
-		vec4 reflectedColour = vec4(texture(skybox, reflectedVector).rgb, 1.0);
-		FragColor = reflectedColour;
-	}
-
-	else if (reflectRefract == 2)
+	vec3 result = CalcDirLight(dirLight, norm, viewDir);
+	
+	for (int i = 0; i < NUM_POINT_LIGHTS; i++)
 	{
-		//Refracting the skybox
-		vec4 refractedColour = vec4(texture(skybox, refractedVector).rgb, 1.0);
-		FragColor = refractedColour;
+		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
 	}
-
+	
+	result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+	
+	FragColor = vec4(result, 1.0);
+#endif
 }
 
+#ifdef LIT
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
 	vec3 lightDir = normalize(-light.direction);
@@ -193,6 +159,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 	return (ambient + diffuse + specular);
 }
 
+#endif
+
 float LinearizeDepth(float depth)
 {
 	float z = depth * 2.0 - 1.0; // back to NDC 
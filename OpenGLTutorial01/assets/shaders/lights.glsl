@@ -0,0 +1,49 @@
+// The scene's lights, as cLightBuffer uploads them. #include "lights.glsl" to read them.
+
+//Laid out to match cLightBuffer.h under std140, a float fills the slot behind each vec3
+struct DirLight
+{
+	vec3 direction;
+	
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct PointLight
+{
+	vec3 position;
+	float constant;
+	
+	vec3 ambient;
+	float linear;
+	vec3 diffuse;
+	float quadratic;
+	vec3 specular;
+};
+
+struct SpotLight
+{
+	vec3 position;
+	float cutOff;
+	vec3 direction;
+	float outerCutOff;
+	
+	vec3 ambient;
+	float constant;
+	vec3 diffuse;
+	float linear;
+	vec3 specular;
+	float quadratic;
+};
+
+//The block always holds MAX_POINT_LIGHTS so its layout never changes between permutations
+#define MAX_POINT_LIGHTS 4
+
+//Filled by cLightBuffer, shared with every program that declares it
+layout (std140) uniform Lights
+{
+	DirLight dirLight;
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLight;
+};
\ No newline at end of file
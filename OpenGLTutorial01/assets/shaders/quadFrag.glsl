@@ -1,84 +1,72 @@
 #version 330 core
+// POST_EFFECT picks the effect (1 to 5, matching drawType in main.cpp), see cShaderPermutations
+#ifndef POST_EFFECT
+#define POST_EFFECT 1
+#endif
+
 out vec4 FragColor;
   
 in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
-uniform int drawType;
 
 const float offset = 1.0 / 300.0; 
 
 void main()
 { 
-	if (drawType == 1)
-	{
-		//Render the scene as normal
-		FragColor = texture(screenTexture, TexCoords);
-	}
+#if POST_EFFECT == 2
+	//True grayscale
+	FragColor = texture(screenTexture, TexCoords);
+	float average = 0.2126 * FragColor.r + 0.7152 * FragColor.g + 0.0722 * FragColor.b;
+	FragColor = vec4(average, average, average, 1.0);
 
-	else if (drawType == 2)
-	{
-		//True grayscale
-		FragColor = texture(screenTexture, TexCoords);
-		float average = 0.2126 * FragColor.r + 0.7152 * FragColor.g + 0.0722 * FragColor.b;
-		FragColor = vec4(average, average, average, 1.0);
-	}
+#elif POST_EFFECT == 3
+	//Render the scene with inverted colours
+	FragColor = vec4(vec3(1.0 - texture(screenTexture, TexCoords)), 1.0);
 
-	else if (drawType == 3)
-	{
-		//Render the scene with inverted colours
-		FragColor = vec4(vec3(1.0 - texture(screenTexture, TexCoords)), 1.0);
-	}
+#elif POST_EFFECT == 4 || POST_EFFECT == 5
+	//Draw using a kernel for pixel offsets
+	vec2 offsets[9] = vec2[](
+		vec2(-offset,  offset), // top-left
+		vec2( 0.0f,    offset), // top-center
+		vec2( offset,  offset), // top-right
+		vec2(-offset,  0.0f),   // center-left
+		vec2( 0.0f,    0.0f),   // center-center
+		vec2( offset,  0.0f),   // center-right
+		vec2(-offset, -offset), // bottom-left
+		vec2( 0.0f,   -offset), // bottom-center
+		vec2( offset, -offset)  // bottom-right    
+	);
 	
-	else if (drawType >= 4)
-	{
-		//Draw using a kernel for pixel offsets
-		vec2 offsets[9] = vec2[](
-			vec2(-offset,  offset), // top-left
-			vec2( 0.0f,    offset), // top-center
-			vec2( offset,  offset), // top-right
-			vec2(-offset,  0.0f),   // center-left
-			vec2( 0.0f,    0.0f),   // center-center
-			vec2( offset,  0.0f),   // center-right
-			vec2(-offset, -offset), // bottom-left
-			vec2( 0.0f,   -offset), // bottom-center
-			vec2( offset, -offset)  // bottom-right    
-		);
-		
-		float kernel[9];
-		
-		if (drawType == 4)
-		{	//Draw with the sharpen effect
-			kernel = float[](
-				-1, -1, -1,
-				-1,  9, -1,
-				-1, -1, -1
-			);
-		}
-		
-		else if (drawType == 5)
-		{	//Draw with the blur effect
-			kernel = float[](
-				1.0 / 16, 2.0 / 16, 1.0 / 16,
-				2.0 / 16, 4.0 / 16, 2.0 / 16,
-				1.0 / 16, 2.0 / 16, 1.0 / 16  
-			);
-		}
-    
-		vec3 sampleTex[9];
-		for(int i = 0; i < 9; i++)
-		{
-			sampleTex[i] = vec3(texture(screenTexture, TexCoords.xy + offsets[i]));
-		}
-		vec3 col = vec3(0.0);
-		for(int i = 0; i < 9; i++)
-			col += sampleTex[i] * kernel[i];
-		
-		FragColor = vec4(col, 1.0);
-	}
-	else
+#if POST_EFFECT == 4
+	//Draw with the sharpen effect
+	float kernel[9] = float[](
+		-1, -1, -1,
+		-1,  9, -1,
+		-1, -1, -1
+	);
+#else
+	//Draw with the blur effect
+	float kernel[9] = float[](
+		1.0 / 16, 2.0 / 16, 1.0 / 16,
+		2.0 / 16, 4.0 / 16, 2.0 / 16,
+		1.0 / 16, 2.0 / 16, 1.0 / 16  
+	);
+#endif
+
+	vec3 sampleTex[9];
+	for(int i = 0; i < 9; i++)
 	{
-		//If something gets messed up, just draw like normal
-		FragColor = texture(screenTexture, TexCoords);
+		sampleTex[i] = vec3(texture(screenTexture, TexCoords.xy + offsets[i]));
 	}
+	vec3 col = vec3(0.0);
+	for(int i = 0; i < 9; i++)
+		col += sampleTex[i] * kernel[i];
+	
+	FragColor = vec4(col, 1.0);
+
+#else
+	//Render the scene as normal, and anything unknown the same way
+	FragColor = texture(screenTexture, TexCoords);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 330 core
+
+// Skinning only, run once per character per frame with transform feedback.
+// The results are captured as plain vertices and drawn later with vertShader.glsl.
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 5) in ivec4 aBoneIDs;
+layout (location = 6) in vec4 aBoneWeights;
+
+// Same palette as animVert.glsl, three texels (3x4 matrix rows) per bone
+uniform samplerBuffer bonePalette;
+uniform int paletteOffset;
+
+// Captured in this order, matching sVertex
+out vec3 skinnedPosition;
+out vec3 skinnedNormal;
+out vec2 skinnedTexCoords;
+
+vec4 boneRow0;
+vec4 boneRow1;
+vec4 boneRow2;
+
+void AddBone(int index, float weight)
+{
+	int texel = (paletteOffset + index) * 3;
+	boneRow0 += texelFetch(bonePalette, texel) * weight;
+	boneRow1 += texelFetch(bonePalette, texel + 1) * weight;
+	boneRow2 += texelFetch(bonePalette, texel + 2) * weight;
+}
+
+void main()
+{
+	boneRow0 = vec4(0.0);
+	boneRow1 = vec4(0.0);
+	boneRow2 = vec4(0.0);
+	AddBone( aBoneIDs[0], aBoneWeights[0] );
+	AddBone( aBoneIDs[1], aBoneWeights[1] );
+	AddBone( aBoneIDs[2], aBoneWeights[2] );
+	AddBone( aBoneIDs[3], aBoneWeights[3] );
+
+	vec4 position = vec4(aPos, 1.0);
+	skinnedPosition = vec3(dot(boneRow0, position), dot(boneRow1, position), dot(boneRow2, position));
+	skinnedNormal = normalize(vec3(dot(boneRow0.xyz, aNormal), dot(boneRow1.xyz, aNormal), dot(boneRow2.xyz, aNormal)));
+	skinnedTexCoords = aTexCoord;
+
+	// Rasterization is discarded, but the position still has to be written
+	gl_Position = vec4(skinnedPosition, 1.0);
+}
@@ -1,4 +1,11 @@
 #version 330 core
+// Permutations, picked with cShaderPermutations:
+//   LIT (default), REFLECT or REFRACT - what the fragment shader does with the surface
+//   UNIFORM_SCALE - the model matrix has no shear or uneven scale, so it can transform normals itself
+#if !defined(REFLECT) && !defined(REFRACT)
+#define LIT
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
@@ -8,26 +15,39 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 cameraPos;
 
+#ifdef LIT
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+#elif defined(REFLECT)
 out vec3 reflectedVector;
+#else
 out vec3 refractedVector;
+#endif
 
 void main()
 {
 	vec3 worldPosition = vec3(model * vec4(aPos, 1.0));
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	FragPos = worldPosition;
+	gl_Position = projection * view * vec4(worldPosition, 1.0);
+#ifdef UNIFORM_SCALE
+	//Only the length is off, and every user of the normal normalizes it
+	vec3 outNormal = mat3(model) * aNormal;
+#else
 	//Inverse transpose removes the "translation" effects of transformation
 	//leaving only rotation and scale
 	vec3 outNormal = mat3(transpose(inverse(model))) * aNormal;
+#endif
+
+#ifdef LIT
+	FragPos = worldPosition;
 	Normal = outNormal;
-	vec4 reflectNormal = model * vec4(aNormal, 1.0);
 	TexCoords = aTexCoord;
-	
+#else
 	vec3 viewVector = normalize(worldPosition - cameraPos);
-	
+#ifdef REFLECT
 	reflectedVector = reflect(viewVector, normalize(outNormal));
+#else
 	refractedVector = refract(viewVector, normalize(outNormal), 1.00/1.33);
+#endif
+#endif
 }
\ No newline at end of file
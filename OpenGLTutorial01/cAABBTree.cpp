@@ -0,0 +1,329 @@
+#include "cAABBTree.h"
+
+#include <algorithm>
+
+//Half the surface area, all the insertion costs need is to compare them
+static float SurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 size = boundsMax - boundsMin;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static bool Contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax)
+{
+	return glm::all(glm::lessThanEqual(outerMin, innerMin)) && glm::all(glm::greaterThanEqual(outerMax, innerMax));
+}
+
+static bool Overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+{
+	return glm::all(glm::lessThanEqual(minA, maxB)) && glm::all(glm::lessThanEqual(minB, maxA));
+}
+
+cAABBTree::cAABBTree(float margin)
+{
+	this->root = -1;
+	this->freeList = -1;
+	this->numLeaves = 0;
+	this->margin = margin;
+}
+
+int cAABBTree::allocateNode()
+{
+	int node;
+	if (this->freeList != -1)
+	{
+		node = this->freeList;
+		this->freeList = this->nodes[node].parent;
+	}
+	else
+	{
+		node = (int)this->nodes.size();
+		this->nodes.push_back(sNode());
+	}
+
+	sNode& newNode = this->nodes[node];
+	newNode.parent = -1;
+	newNode.child1 = -1;
+	newNode.child2 = -1;
+	newNode.height = 0;
+	newNode.userData = -1;
+	return node;
+}
+
+void cAABBTree::freeNode(int node)
+{
+	this->nodes[node].parent = this->freeList;
+	this->nodes[node].height = -1;
+	this->freeList = node;
+}
+
+int cAABBTree::insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int userData)
+{
+	int leaf = this->allocateNode();
+	this->nodes[leaf].boundsMin = boundsMin - glm::vec3(this->margin);
+	this->nodes[leaf].boundsMax = boundsMax + glm::vec3(this->margin);
+	this->nodes[leaf].userData = userData;
+
+	this->insertLeaf(leaf);
+	this->numLeaves++;
+	return leaf;
+}
+
+void cAABBTree::remove(int proxy)
+{
+	if (proxy < 0 || proxy >= (int)this->nodes.size() || this->nodes[proxy].height != 0)
+		return;
+
+	this->removeLeaf(proxy);
+	this->freeNode(proxy);
+	this->numLeaves--;
+}
+
+bool cAABBTree::update(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	sNode& leaf = this->nodes[proxy];
+	if (Contains(leaf.boundsMin, leaf.boundsMax, boundsMin, boundsMax))
+		return false;
+
+	bool nearby = Overlaps(leaf.boundsMin, leaf.boundsMax, boundsMin, boundsMax);
+	leaf.boundsMin = boundsMin - glm::vec3(this->margin);
+	leaf.boundsMax = boundsMax + glm::vec3(this->margin);
+
+	if (nearby)
+	{
+		//Still about where it was, the branches above just have to grow or shrink around it
+		this->refitAncestors(leaf.parent);
+	}
+	else
+	{
+		this->removeLeaf(proxy);
+		this->insertLeaf(proxy);
+	}
+	return true;
+}
+
+int cAABBTree::getUserData(int proxy)
+{
+	return this->nodes[proxy].userData;
+}
+
+unsigned int cAABBTree::getNumLeaves()
+{
+	return this->numLeaves;
+}
+
+int cAABBTree::getHeight()
+{
+	return this->root == -1 ? 0 : this->nodes[this->root].height;
+}
+
+void cAABBTree::insertLeaf(int leaf)
+{
+	if (this->root == -1)
+	{
+		this->root = leaf;
+		this->nodes[leaf].parent = -1;
+		return;
+	}
+
+	//Head down to the sibling that makes the tree grow least. Going into a child costs the
+	//growth of everything passed on the way, which is what inheritedCost carries down.
+	glm::vec3 leafMin = this->nodes[leaf].boundsMin;
+	glm::vec3 leafMax = this->nodes[leaf].boundsMax;
+	int sibling = this->root;
+	while (!this->nodes[sibling].isLeaf())
+	{
+		const sNode& node = this->nodes[sibling];
+		float area = SurfaceArea(node.boundsMin, node.boundsMax);
+		float combinedArea = SurfaceArea(glm::min(node.boundsMin, leafMin), glm::max(node.boundsMax, leafMax));
+
+		//Making a new branch here with the leaf beside this node
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (unsigned int index = 0; index < 2; index++)
+		{
+			const sNode& child = this->nodes[children[index]];
+			float grownArea = SurfaceArea(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+			if (child.isLeaf())
+				childCosts[index] = grownArea + inheritedCost;
+			else
+				childCosts[index] = grownArea - SurfaceArea(child.boundsMin, child.boundsMax) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	//A new branch takes the sibling's place, with the sibling and the leaf under it
+	int oldParent = this->nodes[sibling].parent;
+	int newParent = this->allocateNode();
+	this->nodes[newParent].parent = oldParent;
+	this->nodes[newParent].boundsMin = glm::min(this->nodes[sibling].boundsMin, leafMin);
+	this->nodes[newParent].boundsMax = glm::max(this->nodes[sibling].boundsMax, leafMax);
+	this->nodes[newParent].height = this->nodes[sibling].height + 1;
+	this->nodes[newParent].child1 = sibling;
+	this->nodes[newParent].child2 = leaf;
+	this->nodes[sibling].parent = newParent;
+	this->nodes[leaf].parent = newParent;
+
+	if (oldParent == -1)
+		this->root = newParent;
+	else if (this->nodes[oldParent].child1 == sibling)
+		this->nodes[oldParent].child1 = newParent;
+	else
+		this->nodes[oldParent].child2 = newParent;
+
+	this->refitAncestors(oldParent);
+}
+
+void cAABBTree::removeLeaf(int leaf)
+{
+	if (leaf == this->root)
+	{
+		this->root = -1;
+		return;
+	}
+
+	//The leaf's parent goes too, its other child moves up into its place
+	int parent = this->nodes[leaf].parent;
+	int grandParent = this->nodes[parent].parent;
+	int sibling = this->nodes[parent].child1 == leaf ? this->nodes[parent].child2 : this->nodes[parent].child1;
+
+	if (grandParent == -1)
+	{
+		this->root = sibling;
+		this->nodes[sibling].parent = -1;
+	}
+	else
+	{
+		if (this->nodes[grandParent].child1 == parent)
+			this->nodes[grandParent].child1 = sibling;
+		else
+			this->nodes[grandParent].child2 = sibling;
+		this->nodes[sibling].parent = grandParent;
+	}
+	this->freeNode(parent);
+	this->nodes[leaf].parent = -1;
+
+	this->refitAncestors(grandParent);
+}
+
+void cAABBTree::refitAncestors(int node)
+{
+	while (node != -1)
+	{
+		node = this->balance(node);
+
+		sNode& branch = this->nodes[node];
+		const sNode& child1 = this->nodes[branch.child1];
+		const sNode& child2 = this->nodes[branch.child2];
+		branch.boundsMin = glm::min(child1.boundsMin, child2.boundsMin);
+		branch.boundsMax = glm::max(child1.boundsMax, child2.boundsMax);
+		branch.height = 1 + std::max(child1.height, child2.height);
+
+		node = branch.parent;
+	}
+}
+
+int cAABBTree::balance(int a)
+{
+	sNode& nodeA = this->nodes[a];
+	if (nodeA.isLeaf() || nodeA.height < 2)
+		return a;
+
+	int b = nodeA.child1;
+	int c = nodeA.child2;
+	int difference = this->nodes[c].height - this->nodes[b].height;
+	if (difference >= -1 && difference <= 1)
+		return a;
+
+	//The taller child comes up into a's place with a under it, and the shorter of its own
+	//two children moves down under a
+	int tall = difference > 0 ? c : b;
+	int tallChild1 = this->nodes[tall].child1;
+	int tallChild2 = this->nodes[tall].child2;
+
+	this->nodes[tall].child1 = a;
+	this->nodes[tall].parent = nodeA.parent;
+	nodeA.parent = tall;
+
+	if (this->nodes[tall].parent == -1)
+		this->root = tall;
+	else if (this->nodes[this->nodes[tall].parent].child1 == a)
+		this->nodes[this->nodes[tall].parent].child1 = tall;
+	else
+		this->nodes[this->nodes[tall].parent].child2 = tall;
+
+	int keep = tallChild1;
+	int moved = tallChild2;
+	if (this->nodes[tallChild1].height < this->nodes[tallChild2].height)
+	{
+		keep = tallChild2;
+		moved = tallChild1;
+	}
+	this->nodes[tall].child2 = keep;
+	if (difference > 0)
+		nodeA.child2 = moved;
+	else
+		nodeA.child1 = moved;
+	this->nodes[moved].parent = a;
+
+	const sNode& aChild1 = this->nodes[nodeA.child1];
+	const sNode& aChild2 = this->nodes[nodeA.child2];
+	nodeA.boundsMin = glm::min(aChild1.boundsMin, aChild2.boundsMin);
+	nodeA.boundsMax = glm::max(aChild1.boundsMax, aChild2.boundsMax);
+	nodeA.height = 1 + std::max(aChild1.height, aChild2.height);
+
+	sNode& nodeTall = this->nodes[tall];
+	const sNode& keptNode = this->nodes[keep];
+	nodeTall.boundsMin = glm::min(nodeA.boundsMin, keptNode.boundsMin);
+	nodeTall.boundsMax = glm::max(nodeA.boundsMax, keptNode.boundsMax);
+	nodeTall.height = 1 + std::max(nodeA.height, keptNode.height);
+
+	return tall;
+}
+
+void cAABBTree::query(const cFrustum& frustum, std::vector<int>& results) const
+{
+	if (this->root == -1)
+		return;
+
+	this->stack.clear();
+	this->stack.push_back(this->root);
+	while (!this->stack.empty())
+	{
+		int node = this->stack.back();
+		this->stack.pop_back();
+
+		const sNode& current = this->nodes[node];
+		cFrustum::eClassification classification = frustum.classifyAABB(current.boundsMin, current.boundsMax);
+		if (classification == cFrustum::OUTSIDE)
+			continue;
+
+		if (current.isLeaf())
+			results.push_back(current.userData);
+		else if (classification == cFrustum::INSIDE)
+			this->collectLeaves(node, results);
+		else
+		{
+			this->stack.push_back(current.child1);
+			this->stack.push_back(current.child2);
+		}
+	}
+}
+
+void cAABBTree::collectLeaves(int node, std::vector<int>& results) const
+{
+	const sNode& current = this->nodes[node];
+	if (current.isLeaf())
+	{
+		results.push_back(current.userData);
+		return;
+	}
+	this->collectLeaves(current.child1, results);
+	this->collectLeaves(current.child2, results);
+}
@@ -0,0 +1,75 @@
+#ifndef _HG_cAABBTree_
+#define _HG_cAABBTree_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cFrustum.h"
+
+//A bounding volume hierarchy over boxes that come, go and move while it's in use.
+//Every leaf is one box with a number of the caller's attached, every branch holds the box
+//around its two children. Inserting picks the sibling that grows the tree's surface area
+//least and then rotates nodes to keep it balanced, so culling a frustum against it skips
+//whole groups of boxes at once.
+//Leaves are stored a little bigger than asked for, so small moves don't touch the tree at all.
+class cAABBTree
+{
+public:
+	//margin is how much each leaf is grown by on every side
+	cAABBTree(float margin = 0.1f);
+
+	//Returns a proxy for the box, which stays the same until it is removed
+	int insert(const glm::vec3& boundsMin, const glm::vec3& boundsMax, int userData);
+	void remove(int proxy);
+	//Nothing happens while the box stays inside the grown one it was stored with. Past that,
+	//a box that still overlaps its old one refits the branches above it, one that has moved
+	//right away is taken out and inserted again where it now belongs.
+	//Returns true if the tree changed.
+	bool update(int proxy, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	int getUserData(int proxy);
+	unsigned int getNumLeaves();
+	//0 for a tree of one leaf (or none)
+	int getHeight();
+
+	//Appends the user data of every leaf touching the frustum. A branch entirely inside it
+	//hands over all its leaves without testing any of them.
+	void query(const cFrustum& frustum, std::vector<int>& results) const;
+
+private:
+	struct sNode
+	{
+		glm::vec3 boundsMin, boundsMax;
+		//The next free node while this one is unused
+		int parent;
+		//-1 for leaves
+		int child1, child2;
+		//Leaves are 0, -1 marks a free node
+		int height;
+		int userData;
+
+		bool isLeaf() const { return child1 == -1; }
+	};
+
+	std::vector<sNode> nodes;
+	int root;
+	int freeList;
+	unsigned int numLeaves;
+	float margin;
+
+	//Only query touches this, it is kept to save allocating a stack every call
+	mutable std::vector<int> stack;
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	//Walks up from node, fixing boxes and heights and rebalancing as it goes
+	void refitAncestors(int node);
+	//Rotates a child of node above it if one side is more than a level taller, returns what is now in node's place
+	int balance(int node);
+	void collectLeaves(int node, std::vector<int>& results) const;
+};
+
+#endif
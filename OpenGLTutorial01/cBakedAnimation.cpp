@@ -0,0 +1,95 @@
+#include "cBakedAnimation.h"
+#include "cSkinnedMesh.h"
+#include "cBonePalette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+cBakedAnimation::cBakedAnimation(cSkinnedMesh* mesh, std::string animationName, float framesPerSecond, bool looping)
+{
+	this->animationName = animationName;
+	this->looping = looping;
+	this->duration = mesh->GetClipDuration(animationName);
+	//Both ends of the clip get a frame, so the last one is the clip's final pose rather than one past it
+	this->numFrames = (unsigned int)std::floor(duration * framesPerSecond) + 1;
+	this->framesPerSecond = this->numFrames > 1 ? (float)(this->numFrames - 1) / duration : framesPerSecond;
+	this->numBones = 0;
+	this->textureID = 0;
+
+	bake(mesh);
+}
+
+cBakedAnimation::~cBakedAnimation()
+{
+	glDeleteTextures(1, &textureID);
+	cGLState::forgetTexture(textureID);
+}
+
+void cBakedAnimation::bake(cSkinnedMesh* mesh)
+{
+	std::vector<glm::mat4> vecFinalTransformation;
+	std::vector<glm::mat4> vecGlobals;
+	std::vector<glm::mat4> vecOffsets;
+	std::vector<glm::vec4> texels;
+
+	//Lay the sub-mesh palettes out one after another along the row
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	meshBoneOffsets.resize(meshes.size());
+	numBones = 0;
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		meshBoneOffsets[index] = numBones;
+		numBones += (unsigned int)meshes[index].boneRemap.size();
+	}
+	texels.resize(numBones * numFrames * TEXELS_PER_BONE);
+
+	for (unsigned int frame = 0; frame < numFrames; frame++)
+	{
+		//The clip's clock wraps back to its first pose at exactly its duration, so the end is taken a hair before it
+		float time = std::min((float)frame / framesPerSecond, duration * 0.9999f);
+		mesh->BoneTransform(time, animationName, vecFinalTransformation, vecGlobals, vecOffsets);
+
+		for (unsigned int index = 0; index < meshes.size(); index++)
+		{
+			const std::vector<unsigned int>& remap = meshes[index].boneRemap;
+			for (unsigned int bone = 0; bone < remap.size(); bone++)
+			{
+				PackBoneRows(vecFinalTransformation[remap[bone]], &texels[(frame * numBones + meshBoneOffsets[index] + bone) * TEXELS_PER_BONE]);
+			}
+		}
+	}
+
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if (numBones == 0 || (GLint)(numBones * TEXELS_PER_BONE) > maxSize || (GLint)numFrames > maxSize)
+	{
+		std::cout << "Baked animation " << animationName << " is too big for a texture" << std::endl;
+		return;
+	}
+
+	glGenTextures(1, &textureID);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, numBones * TEXELS_PER_BONE, numFrames, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+	//Frames are blended in the shader, never filter between texels
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void cBakedAnimation::bind(cShaderProgram& shader)
+{
+	cGLState::bindTexture(BAKED_ANIMATION_TEXTURE_UNIT, GL_TEXTURE_2D, textureID);
+
+	shader.setInt("bakedBones", BAKED_ANIMATION_TEXTURE_UNIT);
+	shader.setInt("numFrames", numFrames);
+	shader.setFloat("framesPerSecond", framesPerSecond);
+	shader.setInt("looping", looping ? 1 : 0);
+}
+
+void cBakedAnimation::bindMesh(cShaderProgram& shader, unsigned int meshIndex)
+{
+	shader.setInt("meshBoneOffset", meshBoneOffsets[meshIndex]);
+}
@@ -0,0 +1,50 @@
+#ifndef _HG_cBakedAnimation_
+#define _HG_cBakedAnimation_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cGLState.h"
+
+class cSkinnedMesh;
+
+//Texture unit the baked bone texture is bound to
+const unsigned int BAKED_ANIMATION_TEXTURE_UNIT = 14;
+
+//A clip sampled at an even rate into a float texture: one row per frame, first and last pose included,
+//three RGBA32F texels (3x4 matrix rows) per bone. Each row holds every sub-mesh's
+//local palette back to back. Lets a whole crowd animate on the GPU without any CPU pose evaluation.
+class cBakedAnimation
+{
+public:
+	//A looping clip plays its last frame into its first, anything else holds its last frame once it's over
+	cBakedAnimation(cSkinnedMesh* mesh, std::string animationName, float framesPerSecond, bool looping = true);
+	~cBakedAnimation();
+	//Not copyable, the baked texture would be deleted twice
+	cBakedAnimation(const cBakedAnimation&) = delete;
+	cBakedAnimation& operator=(const cBakedAnimation&) = delete;
+
+	void bind(cShaderProgram& shader);
+	//Points the shader at one sub-mesh's palette within the row
+	void bindMesh(cShaderProgram& shader, unsigned int meshIndex);
+
+	std::string animationName;
+	//A little under what was asked for, so the frames land evenly from the start of the clip to its end
+	float framesPerSecond;
+	bool looping;
+	float duration;
+	unsigned int numFrames;
+	//Bones per row, summed over all the sub-mesh palettes
+	unsigned int numBones;
+	std::vector<unsigned int> meshBoneOffsets;
+	unsigned int textureID;
+
+private:
+	void bake(cSkinnedMesh* mesh);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "cBonePalette.h"
+
+void PackBoneRows(const glm::mat4& bone, glm::vec4* rows)
+{
+	//glm is column major, so pick the rows out across the columns
+	rows[0] = glm::vec4(bone[0][0], bone[1][0], bone[2][0], bone[3][0]);
+	rows[1] = glm::vec4(bone[0][1], bone[1][1], bone[2][1], bone[3][1]);
+	rows[2] = glm::vec4(bone[0][2], bone[1][2], bone[2][2], bone[3][2]);
+}
+
+cBonePalette::cBonePalette(unsigned int maxBones)
+{
+	this->maxBones = maxBones;
+	this->bonesUsed = 0;
+	this->staging.resize(maxBones * TEXELS_PER_BONE);
+
+	glGenBuffers(1, &TBO);
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, staging.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+
+	//Every bone is three RGBA32F texels, one per matrix row
+	glGenTextures(1, &textureID);
+	cGLState::bindTexture(0, GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+
+	cGLState::bindTexture(0, GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+cBonePalette::~cBonePalette()
+{
+	glDeleteTextures(1, &textureID);
+	cGLState::forgetTexture(textureID);
+	glDeleteBuffers(1, &TBO);
+}
+
+void cBonePalette::beginFrame()
+{
+	bonesUsed = 0;
+}
+
+int cBonePalette::allocate(const glm::mat4* bones, unsigned int count)
+{
+	if (bonesUsed + count > maxBones)
+	{
+		return -1;
+	}
+
+	int offset = bonesUsed;
+	for (unsigned int index = 0; index < count; index++)
+	{
+		PackBoneRows(bones[index], &staging[(offset + index) * TEXELS_PER_BONE]);
+	}
+	bonesUsed += count;
+
+	return offset;
+}
+
+int cBonePalette::allocate(const glm::mat4* bones, const std::vector<unsigned int>& remap)
+{
+	unsigned int count = (unsigned int)remap.size();
+	if (bonesUsed + count > maxBones)
+	{
+		return -1;
+	}
+
+	int offset = bonesUsed;
+	for (unsigned int index = 0; index < count; index++)
+	{
+		PackBoneRows(bones[remap[index]], &staging[(offset + index) * TEXELS_PER_BONE]);
+	}
+	bonesUsed += count;
+
+	return offset;
+}
+
+void cBonePalette::upload()
+{
+	if (bonesUsed == 0)
+		return;
+
+	//Orphan last frame's storage so we never wait on draws still reading it
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, staging.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, bonesUsed * TEXELS_PER_BONE * sizeof(glm::vec4), &staging[0]);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void cBonePalette::bind(cShaderProgram& shader)
+{
+	cGLState::bindTexture(BONE_PALETTE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, textureID);
+
+	shader.setInt("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+}
+
+unsigned int cBonePalette::getBonesUsed()
+{
+	return bonesUsed;
+}
+
+unsigned int cBonePalette::getMaxBones()
+{
+	return maxBones;
+}
@@ -0,0 +1,51 @@
+#ifndef _HG_cBonePalette_
+#define _HG_cBonePalette_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cGLState.h"
+
+//Texture unit the palette is bound to, kept clear of the material samplers
+const unsigned int BONE_PALETTE_TEXTURE_UNIT = 15;
+//Bones are stored as the top three rows of their matrix (a 3x4), the last row is always 0,0,0,1
+const unsigned int TEXELS_PER_BONE = 3;
+
+//Writes the three rows of a bone matrix into rows[0..2]
+void PackBoneRows(const glm::mat4& bone, glm::vec4* rows);
+
+//One big texture buffer holding every character's bone palette for the frame.
+//Characters allocate a slice, the whole thing is uploaded once, and each draw
+//only needs to know its offset into it.
+class cBonePalette
+{
+public:
+	cBonePalette(unsigned int maxBones);
+	~cBonePalette();
+	//Owns the TBO and its texture, so there is only ever one of each palette
+	cBonePalette(const cBonePalette&) = delete;
+	cBonePalette& operator=(const cBonePalette&) = delete;
+
+	void beginFrame();
+	//Copies the bones into the frame's palette, returns the offset (in bones) or -1 if it is full
+	int allocate(const glm::mat4* bones, unsigned int count);
+	//Same, but only copies the bones listed in remap (a mesh's local palette)
+	int allocate(const glm::mat4* bones, const std::vector<unsigned int>& remap);
+	void upload();
+	void bind(cShaderProgram& shader);
+
+	unsigned int getBonesUsed();
+	unsigned int getMaxBones();
+
+	unsigned int TBO, textureID;
+
+private:
+	std::vector<glm::vec4> staging;
+	unsigned int bonesUsed;
+	unsigned int maxBones;
+};
+
+#endif
@@ -0,0 +1,369 @@
+#include "cCPUSkinner.h"
+#include "cBonePalette.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+//MSVC lets any function use AVX2 intrinsics, the CPU check decides whether they run
+#define SKINNING_HAS_AVX2_PATH
+#define AVX2_FUNCTION
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SKINNING_HAS_AVX2_PATH
+#define AVX2_FUNCTION __attribute__((target("avx2,fma")))
+#endif
+
+//Vertices per unit of work handed to a thread, a multiple of 8
+const unsigned int SKINNING_CHUNK_SIZE = 2048;
+
+static bool CPUHasAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	//FMA, and the OS saving the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(SKINNING_HAS_AVX2_PATH)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+	return false;
+#endif
+}
+
+static void SkinScalar(const cCPUSkinner::sSkinningStreams& streams, const float* palette,
+	unsigned int first, unsigned int count, sVertex* output)
+{
+	for (unsigned int vertex = first; vertex < first + count; vertex++)
+	{
+		float rows[12] = { 0.0f };
+		for (unsigned int influence = 0; influence < 4; influence++)
+		{
+			float weight = streams.boneWeight[influence][vertex];
+			const float* bone = palette + streams.boneOffset[influence][vertex];
+			for (unsigned int index = 0; index < 12; index++)
+				rows[index] += bone[index] * weight;
+		}
+
+		float px = streams.positionX[vertex], py = streams.positionY[vertex], pz = streams.positionZ[vertex];
+		float nx = streams.normalX[vertex], ny = streams.normalY[vertex], nz = streams.normalZ[vertex];
+
+		sVertex& out = output[vertex - first];
+		out.Position.x = rows[0] * px + rows[1] * py + rows[2] * pz + rows[3];
+		out.Position.y = rows[4] * px + rows[5] * py + rows[6] * pz + rows[7];
+		out.Position.z = rows[8] * px + rows[9] * py + rows[10] * pz + rows[11];
+
+		glm::vec3 normal(rows[0] * nx + rows[1] * ny + rows[2] * nz,
+			rows[4] * nx + rows[5] * ny + rows[6] * nz,
+			rows[8] * nx + rows[9] * ny + rows[10] * nz);
+		float length = std::sqrt(glm::dot(normal, normal));
+		out.Normal = length > 0.0f ? normal / length : normal;
+		out.TexCoords = streams.texCoords[vertex];
+	}
+}
+
+#ifdef SKINNING_HAS_AVX2_PATH
+//Eight vertices at a time. The streams are padded, so a whole group can always be read,
+//only the vertices that really exist are written out.
+AVX2_FUNCTION static void SkinAVX2(const cCPUSkinner::sSkinningStreams& streams, const float* palette,
+	unsigned int first, unsigned int count, sVertex* output)
+{
+	for (unsigned int group = first; group < first + count; group += 8)
+	{
+		__m256 rows[12];
+		for (unsigned int index = 0; index < 12; index++)
+			rows[index] = _mm256_setzero_ps();
+
+		for (unsigned int influence = 0; influence < 4; influence++)
+		{
+			__m256i offsets = _mm256_loadu_si256((const __m256i*)&streams.boneOffset[influence][group]);
+			__m256 weight = _mm256_loadu_ps(&streams.boneWeight[influence][group]);
+			for (unsigned int index = 0; index < 12; index++)
+				rows[index] = _mm256_fmadd_ps(_mm256_i32gather_ps(palette + index, offsets, 4), weight, rows[index]);
+		}
+
+		__m256 px = _mm256_loadu_ps(&streams.positionX[group]);
+		__m256 py = _mm256_loadu_ps(&streams.positionY[group]);
+		__m256 pz = _mm256_loadu_ps(&streams.positionZ[group]);
+		__m256 nx = _mm256_loadu_ps(&streams.normalX[group]);
+		__m256 ny = _mm256_loadu_ps(&streams.normalY[group]);
+		__m256 nz = _mm256_loadu_ps(&streams.normalZ[group]);
+
+		__m256 outPX = _mm256_fmadd_ps(rows[0], px, _mm256_fmadd_ps(rows[1], py, _mm256_fmadd_ps(rows[2], pz, rows[3])));
+		__m256 outPY = _mm256_fmadd_ps(rows[4], px, _mm256_fmadd_ps(rows[5], py, _mm256_fmadd_ps(rows[6], pz, rows[7])));
+		__m256 outPZ = _mm256_fmadd_ps(rows[8], px, _mm256_fmadd_ps(rows[9], py, _mm256_fmadd_ps(rows[10], pz, rows[11])));
+		__m256 outNX = _mm256_fmadd_ps(rows[0], nx, _mm256_fmadd_ps(rows[1], ny, _mm256_mul_ps(rows[2], nz)));
+		__m256 outNY = _mm256_fmadd_ps(rows[4], nx, _mm256_fmadd_ps(rows[5], ny, _mm256_mul_ps(rows[6], nz)));
+		__m256 outNZ = _mm256_fmadd_ps(rows[8], nx, _mm256_fmadd_ps(rows[9], ny, _mm256_mul_ps(rows[10], nz)));
+
+		__m256 lengthSquared = _mm256_fmadd_ps(outNX, outNX, _mm256_fmadd_ps(outNY, outNY, _mm256_mul_ps(outNZ, outNZ)));
+		__m256 scale = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_max_ps(lengthSquared, _mm256_set1_ps(1e-30f))));
+		outNX = _mm256_mul_ps(outNX, scale);
+		outNY = _mm256_mul_ps(outNY, scale);
+		outNZ = _mm256_mul_ps(outNZ, scale);
+
+		//Back to the interleaved layout the vertex buffer wants
+		float lanes[6][8];
+		_mm256_storeu_ps(lanes[0], outPX);
+		_mm256_storeu_ps(lanes[1], outPY);
+		_mm256_storeu_ps(lanes[2], outPZ);
+		_mm256_storeu_ps(lanes[3], outNX);
+		_mm256_storeu_ps(lanes[4], outNY);
+		_mm256_storeu_ps(lanes[5], outNZ);
+
+		for (unsigned int lane = 0; lane < 8 && group + lane < first + count; lane++)
+		{
+			sVertex& out = output[group + lane - first];
+			out.Position = glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+			out.Normal = glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+			out.TexCoords = streams.texCoords[group + lane];
+		}
+	}
+}
+#endif
+
+cCPUSkinner::cCPUSkinner(unsigned int numThreads) : pool(numThreads)
+{
+	this->hasAVX2 = CPUHasAVX2();
+}
+
+cCPUSkinner::~cCPUSkinner()
+{
+}
+
+const cCPUSkinner::sSkinningStreams& cCPUSkinner::getStreams(const cMesh* mesh)
+{
+	std::map<const cMesh*, sSkinningStreams>::iterator it = mapMeshToStreams.find(mesh);
+	if (it != mapMeshToStreams.end())
+		return it->second;
+
+	//First time we see this mesh, split its vertices into streams
+	sSkinningStreams& streams = mapMeshToStreams[mesh];
+	streams.numVertices = (unsigned int)mesh->skinnedVertices.size();
+	unsigned int padded = (streams.numVertices + 7) & ~7u;
+
+	streams.positionX.resize(padded, 0.0f);
+	streams.positionY.resize(padded, 0.0f);
+	streams.positionZ.resize(padded, 0.0f);
+	streams.normalX.resize(padded, 0.0f);
+	streams.normalY.resize(padded, 0.0f);
+	streams.normalZ.resize(padded, 0.0f);
+	streams.texCoords.resize(padded, glm::vec2(0.0f));
+	for (unsigned int influence = 0; influence < 4; influence++)
+	{
+		streams.boneOffset[influence].resize(padded, 0);
+		streams.boneWeight[influence].resize(padded, 0.0f);
+	}
+
+	for (unsigned int index = 0; index < streams.numVertices; index++)
+	{
+		const sSkinnedMeshVertex& vertex = mesh->skinnedVertices[index];
+		streams.positionX[index] = vertex.Position.x;
+		streams.positionY[index] = vertex.Position.y;
+		streams.positionZ[index] = vertex.Position.z;
+		streams.normalX[index] = vertex.Normal.x;
+		streams.normalY[index] = vertex.Normal.y;
+		streams.normalZ[index] = vertex.Normal.z;
+		streams.texCoords[index] = vertex.TexCoords;
+		for (unsigned int influence = 0; influence < 4; influence++)
+		{
+			streams.boneOffset[influence][index] = vertex.BoneID[influence] * TEXELS_PER_BONE * 4;
+			streams.boneWeight[influence][index] = vertex.BoneWeights[influence] / 65535.0f;
+		}
+	}
+
+	return streams;
+}
+
+void cCPUSkinner::addJob(cMesh* mesh, const glm::mat4* bones, int* baseVertex)
+{
+	//Characters sharing a pose share the skinned result as well
+	std::pair<const cMesh*, const glm::mat4*> key(mesh, bones);
+	std::map<std::pair<const cMesh*, const glm::mat4*>, unsigned int>::iterator it = mapJobLookup.find(key);
+	if (it != mapJobLookup.end())
+	{
+		vecJobs[it->second].baseVertexTargets.push_back(baseVertex);
+		return;
+	}
+
+	sJob job;
+	job.streams = &getStreams(mesh);
+	job.palette.resize(mesh->boneRemap.size() * TEXELS_PER_BONE);
+	for (unsigned int index = 0; index < mesh->boneRemap.size(); index++)
+	{
+		PackBoneRows(bones[mesh->boneRemap[index]], &job.palette[index * TEXELS_PER_BONE]);
+	}
+	//Meshes without bones still need something to read
+	if (job.palette.empty())
+		job.palette.resize(TEXELS_PER_BONE, glm::vec4(0.0f));
+	job.baseVertexTargets.push_back(baseVertex);
+
+	mapJobLookup[key] = (unsigned int)vecJobs.size();
+	vecJobs.push_back(job);
+}
+
+void cCPUSkinner::run()
+{
+	vecChunks.clear();
+	for (unsigned int jobIndex = 0; jobIndex < vecJobs.size(); jobIndex++)
+	{
+		sJob& job = vecJobs[jobIndex];
+		job.output.resize(job.streams->numVertices);
+		for (unsigned int first = 0; first < job.streams->numVertices; first += SKINNING_CHUNK_SIZE)
+		{
+			sChunk chunk;
+			chunk.job = jobIndex;
+			chunk.firstVertex = first;
+			chunk.numVertices = glm::min(SKINNING_CHUNK_SIZE, job.streams->numVertices - first);
+			vecChunks.push_back(chunk);
+		}
+	}
+
+	pool.run((unsigned int)vecChunks.size(), [this](unsigned int index) { skinChunk(vecChunks[index]); });
+}
+
+void cCPUSkinner::upload(cSkinnedVertexCache* cache)
+{
+	for (unsigned int jobIndex = 0; jobIndex < vecJobs.size(); jobIndex++)
+	{
+		sJob& job = vecJobs[jobIndex];
+		int baseVertex = job.output.empty() ? -1 : cache->write(&job.output[0], (unsigned int)job.output.size());
+		for (unsigned int index = 0; index < job.baseVertexTargets.size(); index++)
+			*job.baseVertexTargets[index] = baseVertex;
+	}
+
+	vecJobs.clear();
+	mapJobLookup.clear();
+	vecChunks.clear();
+}
+
+void cCPUSkinner::skinChunk(const sChunk& chunk)
+{
+	sJob& job = vecJobs[chunk.job];
+	const float* palette = &job.palette[0].x;
+	sVertex* output = &job.output[chunk.firstVertex];
+
+#ifdef SKINNING_HAS_AVX2_PATH
+	if (hasAVX2)
+	{
+		SkinAVX2(*job.streams, palette, chunk.firstVertex, chunk.numVertices, output);
+		return;
+	}
+#endif
+	SkinScalar(*job.streams, palette, chunk.firstVertex, chunk.numVertices, output);
+}
+
+bool cCPUSkinner::usingAVX2()
+{
+	return hasAVX2;
+}
+
+unsigned int cCPUSkinner::getNumThreads()
+{
+	return pool.getNumThreads();
+}
+
+void cCPUSkinner::benchmark(unsigned int numVertices, unsigned int numBones, unsigned int iterations)
+{
+	//A made up mesh: random positions, unit normals, four random bones per vertex
+	sSkinningStreams streams;
+	streams.numVertices = numVertices;
+	unsigned int padded = (numVertices + 7) & ~7u;
+	streams.positionX.resize(padded);
+	streams.positionY.resize(padded);
+	streams.positionZ.resize(padded);
+	streams.normalX.resize(padded);
+	streams.normalY.resize(padded);
+	streams.normalZ.resize(padded);
+	streams.texCoords.resize(padded, glm::vec2(0.0f));
+	for (unsigned int influence = 0; influence < 4; influence++)
+	{
+		streams.boneOffset[influence].resize(padded);
+		streams.boneWeight[influence].resize(padded, 0.25f);
+	}
+	for (unsigned int index = 0; index < padded; index++)
+	{
+		streams.positionX[index] = (float)(std::rand() % 1000) / 100.0f;
+		streams.positionY[index] = (float)(std::rand() % 1000) / 100.0f;
+		streams.positionZ[index] = (float)(std::rand() % 1000) / 100.0f;
+		streams.normalX[index] = 0.0f;
+		streams.normalY[index] = 1.0f;
+		streams.normalZ[index] = 0.0f;
+		for (unsigned int influence = 0; influence < 4; influence++)
+			streams.boneOffset[influence][index] = (std::rand() % numBones) * TEXELS_PER_BONE * 4;
+	}
+
+	std::vector<glm::vec4> palette(numBones * TEXELS_PER_BONE);
+	for (unsigned int bone = 0; bone < numBones; bone++)
+	{
+		glm::mat4 transform = glm::mat4(1.0f);
+		transform[3] = glm::vec4((float)bone, 0.0f, 0.0f, 1.0f);
+		PackBoneRows(transform, &palette[bone * TEXELS_PER_BONE]);
+	}
+	std::vector<sVertex> output(numVertices);
+
+	typedef std::chrono::high_resolution_clock clock;
+	double totalVertices = (double)numVertices * iterations;
+
+	//One core, scalar
+	clock::time_point start = clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
+		SkinScalar(streams, &palette[0].x, 0, numVertices, &output[0]);
+	double seconds = std::chrono::duration<double>(clock::now() - start).count();
+	std::cout << "CPU skinning, scalar: " << totalVertices / seconds / 1000000.0 << " million vertices/s per core" << std::endl;
+
+	//One core, AVX2
+#ifdef SKINNING_HAS_AVX2_PATH
+	if (hasAVX2)
+	{
+		std::vector<sVertex> scalarOutput = output;
+
+		start = clock::now();
+		for (unsigned int iteration = 0; iteration < iterations; iteration++)
+			SkinAVX2(streams, &palette[0].x, 0, numVertices, &output[0]);
+		seconds = std::chrono::duration<double>(clock::now() - start).count();
+		std::cout << "CPU skinning, AVX2: " << totalVertices / seconds / 1000000.0 << " million vertices/s per core" << std::endl;
+
+		//Both paths should agree to within rounding
+		float maxError = 0.0f;
+		for (unsigned int index = 0; index < numVertices; index++)
+		{
+			glm::vec3 difference = glm::abs(output[index].Position - scalarOutput[index].Position);
+			maxError = glm::max(maxError, glm::max(difference.x, glm::max(difference.y, difference.z)));
+		}
+		std::cout << "CPU skinning, largest AVX2/scalar difference: " << maxError << std::endl;
+	}
+#endif
+
+	//The whole pool, through the same path a frame takes
+	sJob job;
+	job.streams = &streams;
+	job.palette = palette;
+	job.output.resize(numVertices);
+	vecJobs.push_back(job);
+
+	start = clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
+		run();
+	seconds = std::chrono::duration<double>(clock::now() - start).count();
+	std::cout << "CPU skinning, " << getNumThreads() << " threads: " << totalVertices / seconds / 1000000.0 << " million vertices/s ("
+		<< totalVertices / seconds / 1000000.0 / getNumThreads() << " per core)" << std::endl;
+
+	vecJobs.clear();
+	vecChunks.clear();
+}
@@ -0,0 +1,80 @@
+#ifndef _HG_cCPUSkinner_
+#define _HG_cCPUSkinner_
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <vector>
+
+#include "cMesh.h"
+#include "cSkinnedVertexCache.h"
+#include "cWorkerPool.h"
+
+//Skins meshes on the CPU for machines without a real GPU (llvmpipe and friends),
+//where vertex shader skinning is the slowest part of the frame. Vertices are kept
+//as SoA streams and skinned eight at a time with AVX2 (scalar if the CPU lacks it),
+//spread over a pool of worker threads. Results go into a cSkinnedVertexCache and
+//are drawn like any other pre-skinned mesh.
+class cCPUSkinner
+{
+public:
+	//0 threads means one per hardware thread
+	cCPUSkinner(unsigned int numThreads = 0);
+	~cCPUSkinner();
+
+	//Queues a mesh to be skinned with the skeleton's bones, baseVertex receives where
+	//the result lands in the cache on upload. The same mesh and bones are only skinned once.
+	void addJob(cMesh* mesh, const glm::mat4* bones, int* baseVertex);
+	//Skins everything queued, using every worker
+	void run();
+	//Streams the results into the cache and clears the queue
+	void upload(cSkinnedVertexCache* cache);
+
+	bool usingAVX2();
+	unsigned int getNumThreads();
+
+	//Skins a made up mesh over and over and prints vertices per second,
+	//for the scalar and AVX2 paths on one core and for the whole pool
+	void benchmark(unsigned int numVertices, unsigned int numBones, unsigned int iterations);
+
+	struct sSkinningStreams
+	{
+		//Real vertex count, the streams themselves are padded to a multiple of 8
+		unsigned int numVertices;
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> normalX, normalY, normalZ;
+		std::vector<glm::vec2> texCoords;
+		//Where each influence's bone starts in the palette (in floats) and how much it counts
+		std::vector<int> boneOffset[4];
+		std::vector<float> boneWeight[4];
+	};
+
+private:
+	struct sJob
+	{
+		const sSkinningStreams* streams;
+		//The mesh's local palette, three rows per bone
+		std::vector<glm::vec4> palette;
+		std::vector<sVertex> output;
+		std::vector<int*> baseVertexTargets;
+	};
+	struct sChunk
+	{
+		unsigned int job;
+		unsigned int firstVertex;
+		unsigned int numVertices;
+	};
+
+	std::map<const cMesh*, sSkinningStreams> mapMeshToStreams;
+	std::vector<sJob> vecJobs;
+	std::map<std::pair<const cMesh*, const glm::mat4*>, unsigned int> mapJobLookup;
+	std::vector<sChunk> vecChunks;
+
+	bool hasAVX2;
+	cWorkerPool pool;
+
+	const sSkinningStreams& getStreams(const cMesh* mesh);
+	void skinChunk(const sChunk& chunk);
+};
+
+#endif
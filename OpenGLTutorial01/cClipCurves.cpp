@@ -0,0 +1,294 @@
+#include "cClipCurves.h"
+#include "cSkinnedMesh.h"
+#include "cBonePalette.h"
+
+#include <cmath>
+#include <iostream>
+
+//Skeleton texture rows, each column is one node (rows 0-2) or one palette bone (rows 3-6)
+const int SKELETON_ROW_NODE = 0;			//Parent, curve column
+const int SKELETON_ROW_BIND_ROTATION = 1;
+const int SKELETON_ROW_BIND_TRANSLATION = 2;	//Translation, uniform scale in w
+const int SKELETON_ROW_BONE = 3;			//Skeleton node
+const int SKELETON_ROW_BONE_OFFSET = 4;		//Takes 4 to 6, the offset matrix's rows
+const int SKELETON_ROWS = 7;
+
+//Keys are stored with one scale for all three axes, so composing them on the GPU stays a
+//quaternion product. Clips that squash and stretch get the average.
+static glm::vec4 PackTranslationScale(const sLocalTransform& key)
+{
+	float scale = (key.Scale.x + key.Scale.y + key.Scale.z) / 3.0f;
+	return glm::vec4(glm::vec3(key.Translation), scale);
+}
+
+static bool HasUniformScale(const sLocalTransform& key)
+{
+	float scale = (key.Scale.x + key.Scale.y + key.Scale.z) / 3.0f;
+	return std::fabs(key.Scale.x - scale) <= 0.001f * std::fabs(scale)
+		&& std::fabs(key.Scale.y - scale) <= 0.001f * std::fabs(scale)
+		&& std::fabs(key.Scale.z - scale) <= 0.001f * std::fabs(scale);
+}
+
+cClipCurves::cClipCurves(cSkinnedMesh* mesh, float framesPerSecond)
+{
+	this->mesh = mesh;
+	this->framesPerSecond = framesPerSecond;
+	this->numNodes = (unsigned int)mesh->VecSkeletonNodes.size();
+	this->numFrames = 0;
+	this->numTracks = 0;
+	this->nodeTracks.assign(numNodes, -1);
+
+	//A node only matters if some bone hangs off it. Parents come first, so walking
+	//the array backwards sees every child before its parent.
+	this->nodeNeeded.assign(numNodes, false);
+	for (int node = (int)numNodes - 1; node >= 0; node--)
+	{
+		if (mesh->VecSkeletonNodes[node].BoneIndex >= 0)
+			nodeNeeded[node] = true;
+		int parent = mesh->VecSkeletonNodes[node].Parent;
+		if (nodeNeeded[node] && parent >= 0)
+			nodeNeeded[parent] = true;
+	}
+
+	//Lay the sub-mesh palettes out one after another, like cBakedAnimation does
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	meshBoneOffsets.resize(meshes.size());
+	numBones = 0;
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		meshBoneOffsets[index] = numBones;
+		numBones += (unsigned int)meshes[index].boneRemap.size();
+	}
+
+	glGenTextures(1, &skeletonTextureID);
+	glGenTextures(1, &rotationTextureID);
+	glGenTextures(1, &translationTextureID);
+	unsigned int textures[3] = { skeletonTextureID, rotationTextureID, translationTextureID };
+	for (unsigned int index = 0; index < 3; index++)
+	{
+		//Everything is read with texelFetch, frames are blended in the shader
+		cGLState::bindTexture(0, GL_TEXTURE_2D, textures[index]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
+
+	uploadSkeleton();
+}
+
+cClipCurves::~cClipCurves()
+{
+	glDeleteTextures(1, &skeletonTextureID);
+	cGLState::forgetTexture(skeletonTextureID);
+	glDeleteTextures(1, &rotationTextureID);
+	cGLState::forgetTexture(rotationTextureID);
+	glDeleteTextures(1, &translationTextureID);
+	cGLState::forgetTexture(translationTextureID);
+}
+
+int cClipCurves::addClip(std::string animationName)
+{
+	int existing = findClip(animationName);
+	if (existing >= 0)
+		return existing;
+	if (vecClips.size() >= MAX_CLIPS)
+	{
+		std::cout << "Clip curves are full, can't add " << animationName << std::endl;
+		return -1;
+	}
+
+	int meshClip = mesh->FindClip(animationName);
+	sClipRange range;
+	range.name = animationName;
+	range.firstFrame = numFrames;
+	range.numFrames = (unsigned int)std::ceil(mesh->GetClipDuration(animationName) * framesPerSecond);
+	if (range.numFrames == 0)
+		range.numFrames = 1;
+
+	//Nodes this clip moves need a curve
+	for (unsigned int node = 0; node < numNodes; node++)
+	{
+		if (nodeNeeded[node] && nodeTracks[node] < 0 && mesh->VecClips[meshClip].Channels[node] != NULL)
+			addTrack(node);
+	}
+
+	numFrames += range.numFrames;
+	rotations.resize(numFrames * numTracks);
+	translations.resize(numFrames * numTracks);
+
+	std::vector<sLocalTransform> pose(numNodes);
+	bool warned = false;
+	for (unsigned int frame = 0; frame < range.numFrames; frame++)
+	{
+		mesh->SampleLocalPose(meshClip, (float)frame / framesPerSecond, &pose[0]);
+		for (unsigned int node = 0; node < numNodes; node++)
+		{
+			if (nodeTracks[node] < 0)
+				continue;
+
+			unsigned int texel = (range.firstFrame + frame) * numTracks + nodeTracks[node];
+			rotations[texel] = pose[node].Rotation;
+			translations[texel] = PackTranslationScale(pose[node]);
+			if (!warned && !HasUniformScale(pose[node]))
+			{
+				std::cout << "Clip " << animationName << " scales unevenly, its curves will use the average scale" << std::endl;
+				warned = true;
+			}
+		}
+	}
+
+	vecClips.push_back(range);
+	uploadCurves();
+	return (int)vecClips.size() - 1;
+}
+
+int cClipCurves::findClip(std::string animationName)
+{
+	for (unsigned int index = 0; index < vecClips.size(); index++)
+	{
+		if (vecClips[index].name == animationName)
+			return (int)index;
+	}
+	return -1;
+}
+
+void cClipCurves::setKey(int clip, unsigned int frame, unsigned int node, const sLocalTransform& key)
+{
+	if (clip < 0 || clip >= (int)vecClips.size() || frame >= vecClips[clip].numFrames || node >= numNodes)
+		return;
+
+	bool newTrack = nodeTracks[node] < 0;
+	if (newTrack)
+		addTrack(node);
+
+	unsigned int texel = (vecClips[clip].firstFrame + frame) * numTracks + nodeTracks[node];
+	rotations[texel] = key.Rotation;
+	translations[texel] = PackTranslationScale(key);
+
+	if (newTrack)
+	{
+		uploadCurves();
+		return;
+	}
+
+	//Just the one key
+	cGLState::bindTexture(0, GL_TEXTURE_2D, rotationTextureID);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, nodeTracks[node], vecClips[clip].firstFrame + frame, 1, 1, GL_RGBA, GL_FLOAT, &rotations[texel]);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, translationTextureID);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, nodeTracks[node], vecClips[clip].firstFrame + frame, 1, 1, GL_RGBA, GL_FLOAT, &translations[texel]);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void cClipCurves::addTrack(unsigned int node)
+{
+	//Widen every row by one column, filled with the bind pose for clips that don't move the node
+	unsigned int newTracks = numTracks + 1;
+	glm::vec4 bindRotation = mesh->VecSkeletonNodes[node].BindPose.Rotation;
+	glm::vec4 bindTranslation = PackTranslationScale(mesh->VecSkeletonNodes[node].BindPose);
+
+	std::vector<glm::vec4> newRotations(numFrames * newTracks, bindRotation);
+	std::vector<glm::vec4> newTranslations(numFrames * newTracks, bindTranslation);
+	for (unsigned int frame = 0; frame < numFrames; frame++)
+	{
+		for (unsigned int track = 0; track < numTracks; track++)
+		{
+			newRotations[frame * newTracks + track] = rotations[frame * numTracks + track];
+			newTranslations[frame * newTracks + track] = translations[frame * numTracks + track];
+		}
+	}
+
+	rotations.swap(newRotations);
+	translations.swap(newTranslations);
+	nodeTracks[node] = (int)numTracks;
+	numTracks = newTracks;
+	uploadSkeleton();
+}
+
+void cClipCurves::uploadSkeleton()
+{
+	unsigned int width = glm::max(glm::max(numNodes, numBones), 1u);
+	std::vector<glm::vec4> texels(width * SKELETON_ROWS, glm::vec4(0.0f));
+
+	for (unsigned int node = 0; node < numNodes; node++)
+	{
+		texels[SKELETON_ROW_NODE * width + node] = glm::vec4((float)mesh->VecSkeletonNodes[node].Parent, (float)nodeTracks[node], 0.0f, 0.0f);
+		texels[SKELETON_ROW_BIND_ROTATION * width + node] = mesh->VecSkeletonNodes[node].BindPose.Rotation;
+		texels[SKELETON_ROW_BIND_TRANSLATION * width + node] = PackTranslationScale(mesh->VecSkeletonNodes[node].BindPose);
+	}
+
+	//Which node drives each palette bone, and the offset that takes the vertices into bone space
+	std::vector<int> boneNodes(mesh->NumBones, -1);
+	for (unsigned int node = 0; node < numNodes; node++)
+	{
+		if (mesh->VecSkeletonNodes[node].BoneIndex >= 0)
+			boneNodes[mesh->VecSkeletonNodes[node].BoneIndex] = (int)node;
+	}
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		const std::vector<unsigned int>& remap = meshes[index].boneRemap;
+		for (unsigned int bone = 0; bone < remap.size(); bone++)
+		{
+			unsigned int column = meshBoneOffsets[index] + bone;
+			glm::vec4 rows[TEXELS_PER_BONE];
+			PackBoneRows(mesh->VecBoneInfo[remap[bone]].BoneOffset, rows);
+
+			texels[SKELETON_ROW_BONE * width + column] = glm::vec4((float)boneNodes[remap[bone]], 0.0f, 0.0f, 0.0f);
+			for (unsigned int row = 0; row < TEXELS_PER_BONE; row++)
+				texels[(SKELETON_ROW_BONE_OFFSET + row) * width + column] = rows[row];
+		}
+	}
+
+	cGLState::bindTexture(0, GL_TEXTURE_2D, skeletonTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, SKELETON_ROWS, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void cClipCurves::uploadCurves()
+{
+	if (numFrames == 0 || numTracks == 0)
+		return;
+
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if ((GLint)numTracks > maxSize || (GLint)numFrames > maxSize)
+	{
+		std::cout << "Clip curves are too big for a texture" << std::endl;
+		return;
+	}
+
+	//Unit quaternions lose nothing worth seeing at 16 bits. Translations keep full floats,
+	//models in centimetres move too far for halves.
+	cGLState::bindTexture(0, GL_TEXTURE_2D, rotationTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16_SNORM, numTracks, numFrames, 0, GL_RGBA, GL_FLOAT, &rotations[0]);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, translationTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, numTracks, numFrames, 0, GL_RGBA, GL_FLOAT, &translations[0]);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void cClipCurves::bind(cShaderProgram& shader)
+{
+	cGLState::bindTexture(CLIP_SKELETON_TEXTURE_UNIT, GL_TEXTURE_2D, skeletonTextureID);
+	cGLState::bindTexture(CLIP_ROTATION_TEXTURE_UNIT, GL_TEXTURE_2D, rotationTextureID);
+	cGLState::bindTexture(CLIP_TRANSLATION_TEXTURE_UNIT, GL_TEXTURE_2D, translationTextureID);
+
+	shader.setInt("clipSkeleton", CLIP_SKELETON_TEXTURE_UNIT);
+	shader.setInt("clipRotations", CLIP_ROTATION_TEXTURE_UNIT);
+	shader.setInt("clipTranslations", CLIP_TRANSLATION_TEXTURE_UNIT);
+	shader.setFloat("framesPerSecond", framesPerSecond);
+	shader.setMat4("globalInverse", mesh->GlobalInverseTransformation);
+	glm::ivec2 clipFrames[MAX_CLIPS];
+	for (unsigned int index = 0; index < vecClips.size(); index++)
+	{
+		clipFrames[index] = glm::ivec2(vecClips[index].firstFrame, vecClips[index].numFrames);
+	}
+	if (!vecClips.empty())
+		glUniform2iv(shader.getUniformLocation("clipFrames"), (GLsizei)vecClips.size(), &clipFrames[0].x);
+}
+
+void cClipCurves::bindMesh(cShaderProgram& shader, unsigned int meshIndex)
+{
+	shader.setInt("meshBoneOffset", meshBoneOffsets[meshIndex]);
+}
@@ -0,0 +1,77 @@
+#ifndef _HG_cClipCurves_
+#define _HG_cClipCurves_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cPosePool.h"
+#include "cGLState.h"
+
+class cSkinnedMesh;
+
+//Texture units the curves are bound to, clear of the baked clip (14) and the bone palette (15)
+const unsigned int CLIP_SKELETON_TEXTURE_UNIT = 10;
+const unsigned int CLIP_ROTATION_TEXTURE_UNIT = 11;
+const unsigned int CLIP_TRANSLATION_TEXTURE_UNIT = 12;
+
+//A skeleton's clips kept as local joint curves for clipSampleVert.glsl to sample on the GPU.
+//Unlike cBakedAnimation, which stores a 3x4 matrix per palette bone per frame, this stores a
+//16 bit quaternion plus translation and uniform scale (24 bytes) per frame only for the nodes a
+//clip actually animates. Everything else reads its bind pose from the skeleton texture.
+//Being local transforms, clips can be blended per instance and edited after they are loaded.
+class cClipCurves
+{
+public:
+	cClipCurves(cSkinnedMesh* mesh, float framesPerSecond);
+	~cClipCurves();
+
+	//Clips the sampling shader can tell apart, the size of its clipFrames array
+	static const unsigned int MAX_CLIPS = 16;
+
+	//Samples the named clip into the curves and returns its index, or -1 if there is no room
+	int addClip(std::string animationName);
+	int findClip(std::string animationName);
+	//Overwrites one node's key. Nodes no clip animated yet get a curve of their own.
+	void setKey(int clip, unsigned int frame, unsigned int node, const sLocalTransform& key);
+
+	void bind(cShaderProgram& shader);
+	//Points the shader at one sub-mesh's palette within an instance's bones
+	void bindMesh(cShaderProgram& shader, unsigned int meshIndex);
+
+	struct sClipRange
+	{
+		std::string name;
+		unsigned int firstFrame;
+		unsigned int numFrames;
+	};
+	std::vector<sClipRange> vecClips;
+	float framesPerSecond;
+	//Bones per instance, summed over all the sub-mesh palettes
+	unsigned int numBones;
+	std::vector<unsigned int> meshBoneOffsets;
+
+	unsigned int skeletonTextureID, rotationTextureID, translationTextureID;
+
+private:
+	cSkinnedMesh* mesh;
+	unsigned int numNodes;
+	unsigned int numFrames;
+	//Curve column of each skeleton node, -1 if it sits in its bind pose in every clip
+	std::vector<int> nodeTracks;
+	//Nodes with a bone under them, the only ones worth a curve
+	std::vector<bool> nodeNeeded;
+	unsigned int numTracks;
+	//CPU copies of the curves, one row of numTracks keys per frame
+	std::vector<glm::vec4> rotations;
+	std::vector<glm::vec4> translations;
+
+	void addTrack(unsigned int node);
+	void uploadSkeleton();
+	void uploadCurves();
+};
+
+#endif
@@ -0,0 +1,417 @@
+#include "cCrowdSimulation.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CROWD_SSE
+#endif
+
+//Agents per unit of work handed to a thread, a multiple of 4
+const unsigned int CROWD_CHUNK_SIZE = 512;
+//Cells a neighbour query keeps track of on the stack, a 5x5 block covers any radius up to two cells
+const unsigned int CROWD_QUERY_CELLS = 25;
+
+const float CROWD_PI = 3.14159265f;
+const float CROWD_TWO_PI = 6.28318531f;
+
+#ifdef CROWD_SSE
+//sin of four angles at once. Wraps to -pi..pi, folds onto -pi/2..pi/2 (where sin is
+//symmetric about the fold) and finishes with a 9th order polynomial, good to about 4e-6.
+static __m128 SinApprox(__m128 x)
+{
+	const __m128 pi = _mm_set1_ps(CROWD_PI);
+	const __m128 twoPi = _mm_set1_ps(CROWD_TWO_PI);
+	const __m128 invTwoPi = _mm_set1_ps(1.0f / CROWD_TWO_PI);
+
+	__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, invTwoPi)));
+	x = _mm_sub_ps(x, _mm_mul_ps(turns, twoPi));
+	x = _mm_min_ps(x, _mm_sub_ps(pi, x));
+	x = _mm_max_ps(x, _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), pi), x));
+
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 result = _mm_set1_ps(1.0f / 362880.0f);
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(-1.0f / 5040.0f));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(1.0f / 120.0f));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(-1.0f / 6.0f));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(1.0f));
+	return _mm_mul_ps(result, x);
+}
+
+static __m128 WrapAngle(__m128 x)
+{
+	__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.0f / CROWD_TWO_PI))));
+	return _mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(CROWD_TWO_PI)));
+}
+#endif
+
+static float WrapAngle(float x)
+{
+	return x - CROWD_TWO_PI * std::floor(x / CROWD_TWO_PI + 0.5f);
+}
+
+cCrowdSimulation::cCrowdSimulation(unsigned int numThreads) : pool(numThreads)
+{
+	this->SeparationRadius = 1.0f;
+	this->SeparationStrength = 2.0f;
+	this->numAgents = 0;
+	this->cellMask = 0;
+	this->cellSize = 1.0f;
+	this->passDeltaTime = 0.0f;
+}
+
+cCrowdSimulation::~cCrowdSimulation()
+{
+}
+
+int cCrowdSimulation::addAgent(glm::vec3 position, float heading, float speed, float turnSpeed)
+{
+	int agent = (int)numAgents++;
+	unsigned int padded = (numAgents + 3) & ~3u;
+	positionX.resize(padded, 0.0f);
+	positionY.resize(padded, 0.0f);
+	positionZ.resize(padded, 0.0f);
+	this->heading.resize(padded, 0.0f);
+	this->speed.resize(padded, 0.0f);
+	this->turnSpeed.resize(padded, 0.0f);
+	separationX.resize(padded, 0.0f);
+	separationZ.resize(padded, 0.0f);
+
+	positionX[agent] = position.x;
+	positionY[agent] = position.y;
+	positionZ[agent] = position.z;
+	this->heading[agent] = WrapAngle(glm::radians(heading));
+	setVelocity(agent, speed, turnSpeed);
+	return agent;
+}
+
+unsigned int cCrowdSimulation::getNumAgents()
+{
+	return numAgents;
+}
+
+void cCrowdSimulation::setVelocity(int agent, float speed, float turnSpeed)
+{
+	this->speed[agent] = speed;
+	this->turnSpeed[agent] = glm::radians(turnSpeed);
+}
+
+void cCrowdSimulation::setPosition(int agent, glm::vec3 position)
+{
+	positionX[agent] = position.x;
+	positionY[agent] = position.y;
+	positionZ[agent] = position.z;
+}
+
+glm::vec3 cCrowdSimulation::getPosition(int agent)
+{
+	return glm::vec3(positionX[agent], positionY[agent], positionZ[agent]);
+}
+
+float cCrowdSimulation::getHeading(int agent)
+{
+	return glm::degrees(heading[agent]);
+}
+
+void cCrowdSimulation::step(float deltaTime)
+{
+	if (numAgents == 0)
+		return;
+
+	passDeltaTime = deltaTime;
+	buildGrid();
+	runPass(SEPARATION_PASS);
+	runPass(INTEGRATE_PASS);
+}
+
+unsigned int cCrowdSimulation::hashCell(int cellX, int cellZ)
+{
+	return ((unsigned int)cellX * 73856093u ^ (unsigned int)cellZ * 19349663u) & cellMask;
+}
+
+void cCrowdSimulation::buildGrid()
+{
+	//Twice as many buckets as agents keeps unrelated cells from sharing much
+	unsigned int tableSize = 64;
+	while (tableSize < numAgents * 2)
+		tableSize <<= 1;
+	cellMask = tableSize - 1;
+	cellSize = glm::max(SeparationRadius, 0.001f);
+
+	//Counting sort of the agents by bucket
+	cellStart.assign(tableSize + 1, 0);
+	agentCell.resize(numAgents);
+	cellAgents.resize(numAgents);
+	cellPositionX.resize(numAgents + 3, 0.0f);
+	cellPositionZ.resize(numAgents + 3, 0.0f);
+	float invCellSize = 1.0f / cellSize;
+	for (unsigned int agent = 0; agent < numAgents; agent++)
+	{
+		int cellX = (int)std::floor(positionX[agent] * invCellSize);
+		int cellZ = (int)std::floor(positionZ[agent] * invCellSize);
+		agentCell[agent] = hashCell(cellX, cellZ);
+		cellStart[agentCell[agent] + 1]++;
+	}
+	for (unsigned int cell = 0; cell < tableSize; cell++)
+		cellStart[cell + 1] += cellStart[cell];
+	//Each bucket's start doubles as its write cursor, leaving it on the next bucket's start
+	for (unsigned int agent = 0; agent < numAgents; agent++)
+	{
+		unsigned int slot = cellStart[agentCell[agent]]++;
+		cellAgents[slot] = agent;
+		cellPositionX[slot] = positionX[agent];
+		cellPositionZ[slot] = positionZ[agent];
+	}
+	for (unsigned int cell = tableSize; cell > 0; cell--)
+		cellStart[cell] = cellStart[cell - 1];
+	cellStart[0] = 0;
+}
+
+void cCrowdSimulation::queryNeighbours(glm::vec3 position, float radius, std::vector<int>& neighbours)
+{
+	if (cellStart.empty())
+		return;
+
+	float invCellSize = 1.0f / cellSize;
+	int minX = (int)std::floor((position.x - radius) * invCellSize);
+	int maxX = (int)std::floor((position.x + radius) * invCellSize);
+	int minZ = (int)std::floor((position.z - radius) * invCellSize);
+	int maxZ = (int)std::floor((position.z + radius) * invCellSize);
+	float radiusSquared = radius * radius;
+
+	//A query this wide covers so much of the grid that checking every agent costs about the same
+	if ((long long)(maxX - minX + 1) * (maxZ - minZ + 1) > CROWD_QUERY_CELLS)
+	{
+		for (unsigned int agent = 0; agent < numAgents; agent++)
+		{
+			float dx = positionX[agent] - position.x;
+			float dz = positionZ[agent] - position.z;
+			if (dx * dx + dz * dz <= radiusSquared)
+				neighbours.push_back((int)agent);
+		}
+		return;
+	}
+
+	unsigned int visited[CROWD_QUERY_CELLS];
+	unsigned int numVisited = 0;
+	for (int cellZ = minZ; cellZ <= maxZ; cellZ++)
+	{
+		for (int cellX = minX; cellX <= maxX; cellX++)
+		{
+			//Different cells can land in the same bucket, only look through it once
+			unsigned int hash = hashCell(cellX, cellZ);
+			bool seen = false;
+			for (unsigned int index = 0; index < numVisited && !seen; index++)
+				seen = visited[index] == hash;
+			if (seen)
+				continue;
+			visited[numVisited++] = hash;
+
+			for (unsigned int index = cellStart[hash]; index < cellStart[hash + 1]; index++)
+			{
+				unsigned int agent = cellAgents[index];
+				float dx = positionX[agent] - position.x;
+				float dz = positionZ[agent] - position.z;
+				if (dx * dx + dz * dz <= radiusSquared)
+					neighbours.push_back((int)agent);
+			}
+		}
+	}
+}
+
+void cCrowdSimulation::runPass(ePass pass)
+{
+	unsigned int numChunks = (numAgents + CROWD_CHUNK_SIZE - 1) / CROWD_CHUNK_SIZE;
+	pool.run(numChunks, [this, pass](unsigned int index)
+	{
+		unsigned int first = index * CROWD_CHUNK_SIZE;
+		unsigned int count = glm::min(CROWD_CHUNK_SIZE, numAgents - first);
+		if (pass == SEPARATION_PASS)
+			separateChunk(first, count);
+		else
+			integrateChunk(first, count);
+	});
+}
+
+void cCrowdSimulation::separateChunk(unsigned int first, unsigned int count)
+{
+	float radiusSquared = SeparationRadius * SeparationRadius;
+	float invRadius = 1.0f / SeparationRadius;
+	float invCellSize = 1.0f / cellSize;
+
+	//Chunks walk the agents in bucket order, so neighbours usually share the 3x3 block
+	//of buckets around them with the agent before
+	int blockX = 0, blockZ = 0;
+	unsigned int blockStart[9], blockEnd[9];
+	unsigned int numBlockBuckets = 0;
+	bool haveBlock = false;
+
+	for (unsigned int slot = first; slot < first + count; slot++)
+	{
+		float x = cellPositionX[slot];
+		float z = cellPositionZ[slot];
+		int cellX = (int)std::floor(x * invCellSize);
+		int cellZ = (int)std::floor(z * invCellSize);
+
+		if (!haveBlock || cellX != blockX || cellZ != blockZ)
+		{
+			//Cells are as wide as the radius, so the 3x3 block around us covers it.
+			//Different cells can land in the same bucket, only look through it once.
+			blockX = cellX;
+			blockZ = cellZ;
+			haveBlock = true;
+			numBlockBuckets = 0;
+			unsigned int visited[9];
+			for (int neighbourZ = cellZ - 1; neighbourZ <= cellZ + 1; neighbourZ++)
+			{
+				for (int neighbourX = cellX - 1; neighbourX <= cellX + 1; neighbourX++)
+				{
+					unsigned int hash = hashCell(neighbourX, neighbourZ);
+					bool seen = false;
+					for (unsigned int index = 0; index < numBlockBuckets && !seen; index++)
+						seen = visited[index] == hash;
+					if (seen || cellStart[hash] == cellStart[hash + 1])
+						continue;
+					visited[numBlockBuckets] = hash;
+					blockStart[numBlockBuckets] = cellStart[hash];
+					blockEnd[numBlockBuckets] = cellStart[hash + 1];
+					numBlockBuckets++;
+				}
+			}
+		}
+
+		//(1 - distance / radius) / distance, from full strength on the same spot to nothing
+		//at the radius. No branches, most candidates are out of range.
+		float pushX = 0.0f, pushZ = 0.0f;
+#ifdef CROWD_SSE
+		__m128 sumX = _mm_setzero_ps(), sumZ = _mm_setzero_ps();
+		__m128 agentX = _mm_set1_ps(x), agentZ = _mm_set1_ps(z);
+		__m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+		for (unsigned int bucket = 0; bucket < numBlockBuckets; bucket++)
+		{
+			//Reads up to 3 past the bucket, the position copies are padded for it
+			for (unsigned int index = blockStart[bucket]; index < blockEnd[bucket]; index += 4)
+			{
+				__m128 dx = _mm_sub_ps(agentX, _mm_loadu_ps(&cellPositionX[index]));
+				__m128 dz = _mm_sub_ps(agentZ, _mm_loadu_ps(&cellPositionZ[index]));
+				__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+
+				//rsqrt plus one Newton step is plenty for a push
+				__m128 invDistance = _mm_rsqrt_ps(_mm_max_ps(distanceSquared, _mm_set1_ps(1e-8f)));
+				invDistance = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), invDistance),
+					_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(distanceSquared, _mm_mul_ps(invDistance, invDistance))));
+				__m128 push = _mm_sub_ps(invDistance, _mm_set1_ps(invRadius));
+
+				__m128 valid = _mm_cmplt_ps(lanes, _mm_set1_ps((float)(blockEnd[bucket] - index)));
+				__m128 inside = _mm_and_ps(_mm_cmplt_ps(distanceSquared, _mm_set1_ps(radiusSquared)), _mm_cmpgt_ps(distanceSquared, _mm_set1_ps(1e-8f)));
+				push = _mm_and_ps(push, _mm_and_ps(inside, valid));
+
+				//Standing right on top of someone (we always find ourselves), split them by slot
+				int onTop = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(1e-8f)), valid));
+				for (unsigned int lane = 0; onTop != 0; lane++, onTop >>= 1)
+				{
+					if ((onTop & 1) && index + lane != slot)
+						pushX += slot < index + lane ? 1.0f : -1.0f;
+				}
+				sumX = _mm_add_ps(sumX, _mm_mul_ps(dx, push));
+				sumZ = _mm_add_ps(sumZ, _mm_mul_ps(dz, push));
+			}
+		}
+		float lanesX[4], lanesZ[4];
+		_mm_storeu_ps(lanesX, sumX);
+		_mm_storeu_ps(lanesZ, sumZ);
+		pushX += lanesX[0] + lanesX[1] + lanesX[2] + lanesX[3];
+		pushZ += lanesZ[0] + lanesZ[1] + lanesZ[2] + lanesZ[3];
+#else
+		for (unsigned int bucket = 0; bucket < numBlockBuckets; bucket++)
+		{
+			for (unsigned int index = blockStart[bucket]; index < blockEnd[bucket]; index++)
+			{
+				float dx = x - cellPositionX[index];
+				float dz = z - cellPositionZ[index];
+				float distanceSquared = dx * dx + dz * dz;
+				float push = 1.0f / std::sqrt(glm::max(distanceSquared, 1e-8f)) - invRadius;
+				push = distanceSquared < radiusSquared && distanceSquared > 1e-8f ? push : 0.0f;
+				pushX += dx * push;
+				pushZ += dz * push;
+
+				//Standing right on top of someone, split them by slot
+				if (distanceSquared <= 1e-8f && index != slot)
+					pushX += slot < index ? 1.0f : -1.0f;
+			}
+		}
+#endif
+
+		unsigned int agent = cellAgents[slot];
+		separationX[agent] = pushX * SeparationStrength;
+		separationZ[agent] = pushZ * SeparationStrength;
+	}
+}
+
+void cCrowdSimulation::integrateChunk(unsigned int first, unsigned int count)
+{
+	float deltaTime = passDeltaTime;
+	//Chunks start on a multiple of 4 and the streams are padded, so whole groups of 4 are safe
+	unsigned int end = first + ((count + 3) & ~3u);
+
+#ifdef CROWD_SSE
+	__m128 dt = _mm_set1_ps(deltaTime);
+	__m128 quarterTurn = _mm_set1_ps(CROWD_PI * 0.5f);
+	for (unsigned int agent = first; agent < end; agent += 4)
+	{
+		__m128 angle = _mm_add_ps(_mm_loadu_ps(&heading[agent]), _mm_mul_ps(_mm_loadu_ps(&turnSpeed[agent]), dt));
+		angle = WrapAngle(angle);
+		_mm_storeu_ps(&heading[agent], angle);
+
+		__m128 sinHeading = SinApprox(angle);
+		__m128 cosHeading = SinApprox(_mm_add_ps(angle, quarterTurn));
+		__m128 distance = _mm_mul_ps(_mm_loadu_ps(&speed[agent]), dt);
+
+		//Same convention as cSkinnedGameObject::Move, a heading of 0 walks down +z
+		__m128 x = _mm_add_ps(_mm_loadu_ps(&positionX[agent]), _mm_mul_ps(distance, sinHeading));
+		__m128 z = _mm_add_ps(_mm_loadu_ps(&positionZ[agent]), _mm_mul_ps(distance, cosHeading));
+		x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(&separationX[agent]), dt));
+		z = _mm_add_ps(z, _mm_mul_ps(_mm_loadu_ps(&separationZ[agent]), dt));
+		_mm_storeu_ps(&positionX[agent], x);
+		_mm_storeu_ps(&positionZ[agent], z);
+	}
+#else
+	for (unsigned int agent = first; agent < end; agent++)
+	{
+		heading[agent] = WrapAngle(heading[agent] + turnSpeed[agent] * deltaTime);
+		float distance = speed[agent] * deltaTime;
+		positionX[agent] += distance * std::sin(heading[agent]) + separationX[agent] * deltaTime;
+		positionZ[agent] += distance * std::cos(heading[agent]) + separationZ[agent] * deltaTime;
+	}
+#endif
+}
+
+unsigned int cCrowdSimulation::getNumThreads()
+{
+	return pool.getNumThreads();
+}
+
+void cCrowdSimulation::benchmark(unsigned int numAgents, unsigned int iterations)
+{
+	//A made up crowd with our settings, milling about a square about two agents per radius apart
+	cCrowdSimulation crowd(getNumThreads());
+	crowd.SeparationRadius = SeparationRadius;
+	crowd.SeparationStrength = SeparationStrength;
+	float side = std::sqrt((float)numAgents) * SeparationRadius * 0.5f;
+	for (unsigned int index = 0; index < numAgents; index++)
+	{
+		glm::vec3 position(side * rand() / RAND_MAX, 0.0f, side * rand() / RAND_MAX);
+		crowd.addAgent(position, 360.0f * rand() / RAND_MAX, 1.0f + rand() / (float)RAND_MAX, 90.0f * rand() / RAND_MAX - 45.0f);
+	}
+
+	typedef std::chrono::high_resolution_clock clock;
+	clock::time_point start = clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
+		crowd.step(1.0f / 60.0f);
+	double seconds = std::chrono::duration<double>(clock::now() - start).count();
+	std::cout << "Crowd simulation, " << numAgents << " agents on " << getNumThreads() << " threads: "
+		<< seconds * 1000.0 / iterations << " ms per step" << std::endl;
+}
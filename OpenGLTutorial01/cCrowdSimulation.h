@@ -0,0 +1,81 @@
+#ifndef _HG_cCrowdSimulation_
+#define _HG_cCrowdSimulation_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cWorkerPool.h"
+
+//Moves thousands of walking characters at once. Agents live in SoA streams and are
+//stepped four at a time with SSE (sin/cos included), spread over a pool of worker
+//threads. A uniform grid hashed into a flat table answers "who is near me", which
+//the step uses to push agents apart. A cSkinnedGameObject can JoinCrowd and then
+//becomes a view onto its agent.
+class cCrowdSimulation
+{
+public:
+	//0 threads means one per hardware thread
+	cCrowdSimulation(unsigned int numThreads = 0);
+	~cCrowdSimulation();
+
+	//Heading is in degrees like cSkinnedGameObject::OrientationEuler.y, turn speed in degrees per second.
+	//Returns the agent's slot.
+	int addAgent(glm::vec3 position, float heading, float speed, float turnSpeed);
+	unsigned int getNumAgents();
+
+	void setVelocity(int agent, float speed, float turnSpeed);
+	void setPosition(int agent, glm::vec3 position);
+	glm::vec3 getPosition(int agent);
+	float getHeading(int agent);
+
+	//Moves every agent on by deltaTime seconds
+	void step(float deltaTime);
+
+	//Appends every agent within radius of position (on the ground plane) to neighbours.
+	//Uses the grid built by the last step, and allocates nothing beyond what neighbours grows by.
+	void queryNeighbours(glm::vec3 position, float radius, std::vector<int>& neighbours);
+
+	//Agents closer than this push each other apart, it is also the grid's cell size
+	float SeparationRadius;
+	//Metres per second of push when two agents stand on the same spot
+	float SeparationStrength;
+
+	unsigned int getNumThreads();
+	//Steps a made up crowd over and over and prints milliseconds per step
+	void benchmark(unsigned int numAgents, unsigned int iterations);
+
+private:
+	//Real agent count, the streams are padded to a multiple of 4 with agents that stand still
+	unsigned int numAgents;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> heading;			//Radians, kept within -pi..pi
+	std::vector<float> speed;
+	std::vector<float> turnSpeed;		//Radians per second
+	std::vector<float> separationX, separationZ;
+
+	//Agents sorted by hashed cell, cellStart[hash] is where a cell's agents begin
+	std::vector<unsigned int> cellStart;
+	std::vector<unsigned int> cellAgents;
+	//Positions copied into bucket order, so scanning a bucket reads memory front to back
+	std::vector<float> cellPositionX, cellPositionZ;
+	std::vector<unsigned int> agentCell;
+	unsigned int cellMask;
+	float cellSize;
+
+	enum ePass
+	{
+		SEPARATION_PASS,
+		INTEGRATE_PASS
+	};
+	float passDeltaTime;
+	cWorkerPool pool;
+
+	unsigned int hashCell(int cellX, int cellZ);
+	void buildGrid();
+	void runPass(ePass pass);
+	void separateChunk(unsigned int first, unsigned int count);
+	void integrateChunk(unsigned int first, unsigned int count);
+};
+
+#endif
@@ -8,15 +8,15 @@ cFrameBuffer::cFrameBuffer(unsigned int SCR_HEIGHT, unsigned int SCR_WIDTH)
 void cFrameBuffer::resize(unsigned int SCR_HEIGHT, unsigned int SCR_WIDTH)
 {
 	glGenFramebuffers(1, &FBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	cGLState::bindFramebuffer(FBO);
 
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	cGLState::bindTexture(0, GL_TEXTURE_2D, 0);
 
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureID, 0);
 
@@ -29,5 +29,5 @@ void cFrameBuffer::resize(unsigned int SCR_HEIGHT, unsigned int SCR_WIDTH)
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cout << "Frame Buffer = BAD" << std::endl;
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	cGLState::bindFramebuffer(0);
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 
 #include <iostream>
 
+#include "cGLState.h"
+
 class cFrameBuffer
 {
 public:
@@ -0,0 +1,122 @@
+#include "cFrustum.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+cFrustum::cFrustum()
+{
+	//Wide open until someone gives us a matrix
+	for (unsigned int index = 0; index < 6; index++)
+		planes[index] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	storePlanesSoA();
+}
+
+cFrustum::cFrustum(const glm::mat4& projectionView)
+{
+	extractPlanes(projectionView);
+}
+
+void cFrustum::extractPlanes(const glm::mat4& projectionView)
+{
+	//glm is column major, so the rows are picked out across the columns
+	glm::vec4 rows[4];
+	for (unsigned int row = 0; row < 4; row++)
+		rows[row] = glm::vec4(projectionView[0][row], projectionView[1][row], projectionView[2][row], projectionView[3][row]);
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (unsigned int index = 0; index < 6; index++)
+		planes[index] /= glm::length(glm::vec3(planes[index]));
+	storePlanesSoA();
+}
+
+void cFrustum::storePlanesSoA()
+{
+	for (unsigned int index = 0; index < 8; index++)
+	{
+		glm::vec4 plane = index < 6 ? planes[index] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		planeX[index] = plane.x;
+		planeY[index] = plane.y;
+		planeZ[index] = plane.z;
+		planeW[index] = plane.w;
+	}
+}
+
+bool cFrustum::intersectsAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	return classifyAABB(boundsMin, boundsMax) != OUTSIDE;
+}
+
+cFrustum::eClassification cFrustum::classifyAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	//Centre and half size: the box reaches |normal| . extents along each plane's normal either way
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+
+#ifdef FRUSTUM_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+	__m128 extentsX = _mm_set1_ps(extents.x), extentsY = _mm_set1_ps(extents.y), extentsZ = _mm_set1_ps(extents.z);
+
+	int outside = 0;
+	int intersects = 0;
+	for (unsigned int group = 0; group < 8; group += 4)
+	{
+		__m128 normalX = _mm_loadu_ps(&planeX[group]);
+		__m128 normalY = _mm_loadu_ps(&planeY[group]);
+		__m128 normalZ = _mm_loadu_ps(&planeZ[group]);
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)),
+			_mm_add_ps(_mm_mul_ps(normalZ, centerZ), _mm_loadu_ps(&planeW[group])));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentsX),
+			_mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentsY)), _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentsZ));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		intersects |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+	}
+#else
+	bool outside = false;
+	bool intersects = false;
+	for (unsigned int index = 0; index < 6; index++)
+	{
+		glm::vec3 normal(planes[index]);
+		float distance = glm::dot(normal, center) + planes[index].w;
+		float radius = glm::dot(glm::abs(normal), extents);
+		outside = outside || distance + radius < 0.0f;
+		intersects = intersects || distance - radius < 0.0f;
+	}
+#endif
+
+	if (outside)
+		return OUTSIDE;
+	return intersects ? INTERSECTS : INSIDE;
+}
+
+bool cFrustum::intersectsSphere(const glm::vec3& center, float radius) const
+{
+	for (unsigned int index = 0; index < 6; index++)
+	{
+		if (glm::dot(glm::vec3(planes[index]), center) + planes[index].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+void TransformAABB(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	glm::vec3& outMin, glm::vec3& outMax)
+{
+	//Move the centre, and grow the extents by the absolute value of the rotation/scale part
+	glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+	glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+	glm::vec3 newExtents = absolute * extents;
+
+	outMin = center - newExtents;
+	outMax = center + newExtents;
+}
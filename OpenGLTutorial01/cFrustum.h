@@ -0,0 +1,41 @@
+#ifndef _HG_cFrustum_
+#define _HG_cFrustum_
+
+#include <glm/glm.hpp>
+
+//The six planes of a view volume, pulled straight out of a projection * view matrix.
+//Planes point inwards, so anything fully on the negative side of one is outside.
+class cFrustum
+{
+public:
+	cFrustum();
+	cFrustum(const glm::mat4& projectionView);
+
+	void extractPlanes(const glm::mat4& projectionView);
+	bool intersectsAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+	enum eClassification
+	{
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE
+	};
+	//Tests the box against four planes at a time with SSE. INSIDE means every plane has all of it on
+	//the inner side, so anything within the box is visible without testing it.
+	eClassification classifyAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	//Left, right, bottom, top, near, far as (normal, distance)
+	glm::vec4 planes[6];
+
+private:
+	//The planes again as SoA, two groups of four with two planes that pass everything on the end
+	float planeX[8], planeY[8], planeZ[8], planeW[8];
+	void storePlanesSoA();
+};
+
+//Box that holds the given box after it has been transformed
+void TransformAABB(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	glm::vec3& outMin, glm::vec3& outMax);
+
+#endif
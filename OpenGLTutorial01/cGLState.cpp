@@ -0,0 +1,227 @@
+#include "cGLState.h"
+
+unsigned int cGLState::program = cGLState::UNKNOWN;
+unsigned int cGLState::VAO = cGLState::UNKNOWN;
+unsigned int cGLState::FBO = cGLState::UNKNOWN;
+unsigned int cGLState::activeUnit = cGLState::UNKNOWN;
+unsigned int cGLState::textures[MAX_CACHED_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+unsigned int cGLState::capabilities[NUM_CAPABILITIES];
+unsigned int cGLState::depthFuncValue = cGLState::UNKNOWN;
+unsigned int cGLState::stencilFuncValue = cGLState::UNKNOWN;
+unsigned int cGLState::stencilRef = cGLState::UNKNOWN;
+unsigned int cGLState::stencilFuncMask = cGLState::UNKNOWN;
+unsigned int cGLState::stencilFailOp = cGLState::UNKNOWN;
+unsigned int cGLState::depthFailOp = cGLState::UNKNOWN;
+unsigned int cGLState::depthPassOp = cGLState::UNKNOWN;
+unsigned int cGLState::stencilWriteMask = cGLState::UNKNOWN;
+unsigned int cGLState::numIssued = 0;
+unsigned int cGLState::numSkipped = 0;
+
+//The arrays can't be given UNKNOWN in their definition, so this does it before main runs
+static struct sGLStateInitialiser
+{
+	sGLStateInitialiser() { cGLState::invalidate(); }
+} glStateInitialiser;
+
+bool cGLState::change(unsigned int& cached, unsigned int value)
+{
+	if (cached == value)
+	{
+		numSkipped++;
+		return false;
+	}
+
+	cached = value;
+	numIssued++;
+	return true;
+}
+
+void cGLState::useProgram(unsigned int program)
+{
+	if (change(cGLState::program, program))
+		glUseProgram(program);
+}
+
+void cGLState::bindVertexArray(unsigned int VAO)
+{
+	if (change(cGLState::VAO, VAO))
+		glBindVertexArray(VAO);
+}
+
+void cGLState::bindFramebuffer(unsigned int FBO)
+{
+	if (change(cGLState::FBO, FBO))
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+}
+
+void cGLState::activeTexture(unsigned int unit)
+{
+	if (change(activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+int cGLState::getTextureTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:			return TARGET_2D;
+	case GL_TEXTURE_CUBE_MAP:	return TARGET_CUBE_MAP;
+	case GL_TEXTURE_BUFFER:		return TARGET_BUFFER;
+	default:					return -1;
+	}
+}
+
+void cGLState::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	activeTexture(unit);
+
+	int targetIndex = getTextureTarget(target);
+	if (unit >= MAX_CACHED_TEXTURE_UNITS || targetIndex < 0)
+	{
+		numIssued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	if (change(textures[unit][targetIndex], texture))
+		glBindTexture(target, texture);
+}
+
+int cGLState::getCapability(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:			return CAP_DEPTH_TEST;
+	case GL_STENCIL_TEST:		return CAP_STENCIL_TEST;
+	case GL_BLEND:				return CAP_BLEND;
+	case GL_CULL_FACE:			return CAP_CULL_FACE;
+	case GL_RASTERIZER_DISCARD:	return CAP_RASTERIZER_DISCARD;
+	default:					return -1;
+	}
+}
+
+void cGLState::setCapability(GLenum capability, bool enabled)
+{
+	int index = getCapability(capability);
+	if (index >= 0 && !change(capabilities[index], enabled ? 1 : 0))
+		return;
+	if (index < 0)
+		numIssued++;
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void cGLState::enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void cGLState::disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void cGLState::depthFunc(GLenum func)
+{
+	if (change(depthFuncValue, func))
+		glDepthFunc(func);
+}
+
+void cGLState::stencilFunc(GLenum func, int ref, unsigned int mask)
+{
+	if (stencilFuncValue == func && stencilRef == (unsigned int)ref && stencilFuncMask == mask)
+	{
+		numSkipped++;
+		return;
+	}
+
+	stencilFuncValue = func;
+	stencilRef = (unsigned int)ref;
+	stencilFuncMask = mask;
+	numIssued++;
+	glStencilFunc(func, ref, mask);
+}
+
+void cGLState::stencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass)
+{
+	if (stencilFailOp == stencilFail && depthFailOp == depthFail && depthPassOp == depthPass)
+	{
+		numSkipped++;
+		return;
+	}
+
+	stencilFailOp = stencilFail;
+	depthFailOp = depthFail;
+	depthPassOp = depthPass;
+	numIssued++;
+	glStencilOp(stencilFail, depthFail, depthPass);
+}
+
+void cGLState::stencilMask(unsigned int mask)
+{
+	if (change(stencilWriteMask, mask))
+		glStencilMask(mask);
+}
+
+void cGLState::forgetProgram(unsigned int program)
+{
+	//A deleted program stays current until another replaces it, so just stop assuming anything
+	if (cGLState::program == program)
+		cGLState::program = UNKNOWN;
+}
+
+void cGLState::forgetVertexArray(unsigned int VAO)
+{
+	if (cGLState::VAO == VAO)
+		cGLState::VAO = 0;
+}
+
+void cGLState::forgetTexture(unsigned int texture)
+{
+	for (unsigned int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++)
+	{
+		for (unsigned int target = 0; target < NUM_TEXTURE_TARGETS; target++)
+		{
+			if (textures[unit][target] == texture)
+				textures[unit][target] = 0;
+		}
+	}
+}
+
+void cGLState::invalidate()
+{
+	program = UNKNOWN;
+	VAO = UNKNOWN;
+	FBO = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (unsigned int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++)
+	{
+		for (unsigned int target = 0; target < NUM_TEXTURE_TARGETS; target++)
+			textures[unit][target] = UNKNOWN;
+	}
+	for (unsigned int index = 0; index < NUM_CAPABILITIES; index++)
+		capabilities[index] = UNKNOWN;
+	depthFuncValue = UNKNOWN;
+	stencilFuncValue = stencilRef = stencilFuncMask = UNKNOWN;
+	stencilFailOp = depthFailOp = depthPassOp = UNKNOWN;
+	stencilWriteMask = UNKNOWN;
+}
+
+void cGLState::beginFrame()
+{
+	numIssued = 0;
+	numSkipped = 0;
+}
+
+unsigned int cGLState::getNumIssued()
+{
+	return numIssued;
+}
+
+unsigned int cGLState::getNumSkipped()
+{
+	return numSkipped;
+}
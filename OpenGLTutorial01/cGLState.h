@@ -0,0 +1,86 @@
+#ifndef _HG_cGLState_
+#define _HG_cGLState_
+
+#include <glad/glad.h>
+
+//Texture units the cache keeps track of, units past this always go through to the GL
+const unsigned int MAX_CACHED_TEXTURE_UNITS = 16;
+
+//A shadow copy of the GL state the renderer keeps changing.
+//Every program, vertex array, texture, framebuffer and depth/stencil change goes through here,
+//so a call that would set what is already set is dropped instead of reaching the driver.
+//That only holds while nothing binds behind its back: everything in the project binds through
+//these, anything that deletes a bound object forgets it, and invalidate() covers the rest.
+class cGLState
+{
+public:
+	static void useProgram(unsigned int program);
+	static void bindVertexArray(unsigned int VAO);
+	static void bindFramebuffer(unsigned int FBO);
+	//Leaves unit active afterwards, so glTexImage2D and friends can follow straight on
+	static void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+	//Only depth test, stencil test, blending, face culling and rasterizer discard are cached
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void depthFunc(GLenum func);
+	static void stencilFunc(GLenum func, int ref, unsigned int mask);
+	static void stencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+	static void stencilMask(unsigned int mask);
+
+	//Call after deleting an object that might still be bound
+	static void forgetProgram(unsigned int program);
+	static void forgetVertexArray(unsigned int VAO);
+	static void forgetTexture(unsigned int texture);
+
+	//Forget everything, the next call of each kind goes through whatever it sets
+	static void invalidate();
+
+	//Counting starts over every frame
+	static void beginFrame();
+	static unsigned int getNumIssued();
+	static unsigned int getNumSkipped();
+
+private:
+	enum eTextureTarget
+	{
+		TARGET_2D,
+		TARGET_CUBE_MAP,
+		TARGET_BUFFER,
+		NUM_TEXTURE_TARGETS
+	};
+	enum eCapability
+	{
+		CAP_DEPTH_TEST,
+		CAP_STENCIL_TEST,
+		CAP_BLEND,
+		CAP_CULL_FACE,
+		CAP_RASTERIZER_DISCARD,
+		NUM_CAPABILITIES
+	};
+
+	//Every cached value starts out as UNKNOWN, which nothing real can equal
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+	static unsigned int program;
+	static unsigned int VAO;
+	static unsigned int FBO;
+	static unsigned int activeUnit;
+	static unsigned int textures[MAX_CACHED_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+	static unsigned int capabilities[NUM_CAPABILITIES];
+	static unsigned int depthFuncValue;
+	static unsigned int stencilFuncValue, stencilRef, stencilFuncMask;
+	static unsigned int stencilFailOp, depthFailOp, depthPassOp;
+	static unsigned int stencilWriteMask;
+
+	static unsigned int numIssued, numSkipped;
+
+	static int getTextureTarget(GLenum target);
+	static int getCapability(GLenum capability);
+	static void setCapability(GLenum capability, bool enabled);
+	static void activeTexture(unsigned int unit);
+	//Counts the call and says whether it has to go through
+	static bool change(unsigned int& cached, unsigned int value);
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "cInstancedCrowd.h"
+
+#include <cstddef>
+
+//Vertex attribute slots after the skinned vertex layout
+const unsigned int INSTANCE_MODEL_LOCATION = 7;		//Takes 7 to 10
+const unsigned int INSTANCE_TIME_LOCATION = 11;
+
+cInstancedCrowd::cInstancedCrowd(cSkinnedMesh* mesh, cBakedAnimation* animation)
+{
+	this->mesh = mesh;
+	this->animation = animation;
+	this->numUploaded = 0;
+
+	glGenBuffers(1, &instanceVBO);
+
+	//Every sub-mesh gets a VAO of our own on its buffers plus the per instance data,
+	//so nobody else's draws see (or re-point) these attributes
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		unsigned int vao = meshes[index].createVAO();
+		vecVAOs.push_back(vao);
+		cGLState::bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(sCrowdInstance),
+				(void*)(offsetof(sCrowdInstance, Model) + column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+			glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+		}
+
+		glVertexAttribPointer(INSTANCE_TIME_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(sCrowdInstance), (void*)offsetof(sCrowdInstance, TimeOffset));
+		glEnableVertexAttribArray(INSTANCE_TIME_LOCATION);
+		glVertexAttribDivisor(INSTANCE_TIME_LOCATION, 1);
+	}
+
+	cGLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+cInstancedCrowd::~cInstancedCrowd()
+{
+	for (unsigned int index = 0; index < vecVAOs.size(); index++)
+	{
+		glDeleteVertexArrays(1, &vecVAOs[index]);
+		cGLState::forgetVertexArray(vecVAOs[index]);
+	}
+	glDeleteBuffers(1, &instanceVBO);
+}
+
+void cInstancedCrowd::updateInstances()
+{
+	numUploaded = (unsigned int)instances.size();
+	if (numUploaded == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(sCrowdInstance), &instances[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cInstancedCrowd::Draw(cShaderProgram& shader, float time)
+{
+	if (numUploaded == 0)
+		return;
+
+	shader.useProgram();
+	animation->bind(shader);
+	shader.setFloat("time", time);
+
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		animation->bindMesh(shader, index);
+		meshes[index].DrawInstanced(shader, numUploaded, vecVAOs[index]);
+	}
+}
+
+void cInstancedCrowd::Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sInstancedSkinUniforms& uniforms, float depth)
+{
+	if (numUploaded == 0)
+		return;
+
+	sDrawPacket packet;
+	packet.program = program;
+	packet.intLocation = uniforms.locations[sInstancedSkinUniforms::MESH_BONE_OFFSET];
+	packet.indexed = true;
+	packet.instanceCount = numUploaded;
+
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size() && index < animation->meshBoneOffsets.size(); index++)
+	{
+		packet.material = meshes[index].material;
+		packet.VAO = vecVAOs[index];
+		packet.count = (unsigned int)meshes[index].indices.size();
+		packet.intValue = animation->meshBoneOffsets[index];
+		bucket.submit(pass, packet, depth);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef _HG_cInstancedCrowd_
+#define _HG_cInstancedCrowd_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cSkinnedMesh.h"
+#include "cBakedAnimation.h"
+#include "cGLState.h"
+#include "cRenderQueue.h"
+#include "cShaderUniforms.h"
+
+struct sCrowdInstance
+{
+	glm::mat4 Model;
+	//Seconds added to the crowd clock so instances don't all move in lockstep
+	float TimeOffset;
+};
+
+//Draws many copies of one skinned mesh, animated from a baked clip,
+//with a single instanced draw per sub-mesh
+class cInstancedCrowd
+{
+public:
+	cInstancedCrowd(cSkinnedMesh* mesh, cBakedAnimation* animation);
+	~cInstancedCrowd();
+	//The instance buffer and VAOs are ours alone
+	cInstancedCrowd(const cInstancedCrowd&) = delete;
+	cInstancedCrowd& operator=(const cInstancedCrowd&) = delete;
+
+	std::vector<sCrowdInstance> instances;
+
+	//Call after changing the instances
+	void updateInstances();
+	void Draw(cShaderProgram& shader, float time);
+	//Queues one instanced packet per sub-mesh. Binding the animation and setting the camera
+	//and time on the program is left to the caller, once a frame.
+	void Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sInstancedSkinUniforms& uniforms, float depth);
+
+private:
+	cSkinnedMesh* mesh;
+	cBakedAnimation* animation;
+	unsigned int instanceVBO;
+	//One per sub-mesh: its vertex and index buffers plus our instance attributes
+	std::vector<unsigned int> vecVAOs;
+	unsigned int numUploaded;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "cLightBuffer.h"
+
+#include <cstddef>
+
+static_assert(sizeof(sDirLight) == 64, "sDirLight doesn't match its std140 layout");
+static_assert(sizeof(sPointLight) == 64, "sPointLight doesn't match its std140 layout");
+static_assert(sizeof(sSpotLight) == 80, "sSpotLight doesn't match its std140 layout");
+
+cLightBuffer::cLightBuffer()
+{
+	block = sLightBlock();
+	dirtyBegin = 0;
+	dirtyEnd = 0;
+
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(sLightBlock), &block, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	//The indexed binding stays put, nothing else has to bind it again
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, UBO);
+}
+
+cLightBuffer::~cLightBuffer()
+{
+	glDeleteBuffers(1, &UBO);
+}
+
+void cLightBuffer::attach(cShaderProgram& shader)
+{
+	shader.bindUniformBlock("Lights", LIGHT_BLOCK_BINDING);
+}
+
+void cLightBuffer::markDirty(unsigned int offset, unsigned int size)
+{
+	if (dirtyBegin >= dirtyEnd)
+	{
+		dirtyBegin = offset;
+		dirtyEnd = offset + size;
+		return;
+	}
+
+	dirtyBegin = glm::min(dirtyBegin, offset);
+	dirtyEnd = glm::max(dirtyEnd, offset + size);
+}
+
+void cLightBuffer::setDirLight(const sDirLight& light)
+{
+	block.dirLight = light;
+	markDirty(offsetof(sLightBlock, dirLight), sizeof(sDirLight));
+}
+
+void cLightBuffer::setPointLight(unsigned int index, const sPointLight& light)
+{
+	if (index >= MAX_POINT_LIGHTS)
+		return;
+
+	block.pointLights[index] = light;
+	markDirty(offsetof(sLightBlock, pointLights) + index * sizeof(sPointLight), sizeof(sPointLight));
+}
+
+void cLightBuffer::setSpotLight(const sSpotLight& light)
+{
+	block.spotLight = light;
+	markDirty(offsetof(sLightBlock, spotLight), sizeof(sSpotLight));
+}
+
+void cLightBuffer::setSpotLightPose(const glm::vec3& position, const glm::vec3& direction)
+{
+	block.spotLight.position = position;
+	block.spotLight.direction = direction;
+	markDirty(offsetof(sLightBlock, spotLight), offsetof(sSpotLight, ambient));
+}
+
+const sDirLight& cLightBuffer::getDirLight()
+{
+	return block.dirLight;
+}
+
+const sPointLight& cLightBuffer::getPointLight(unsigned int index)
+{
+	return block.pointLights[index];
+}
+
+const sSpotLight& cLightBuffer::getSpotLight()
+{
+	return block.spotLight;
+}
+
+void cLightBuffer::upload()
+{
+	if (dirtyBegin >= dirtyEnd)
+		return;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, (const char*)&block + dirtyBegin);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	dirtyBegin = 0;
+	dirtyEnd = 0;
+}
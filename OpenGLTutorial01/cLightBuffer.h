@@ -0,0 +1,98 @@
+#ifndef _HG_cLightBuffer_
+#define _HG_cLightBuffer_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "cShaderProgram.h"
+
+//Uniform block binding point the lights live at, shared by every program that reads them
+const unsigned int LIGHT_BLOCK_BINDING = 0;
+//Has to match MAX_POINT_LIGHTS in lights.glsl
+const unsigned int MAX_POINT_LIGHTS = 4;
+
+//The structs below mirror the "Lights" block in lights.glsl under std140 rules.
+//Every vec3 takes a 16 byte slot, so a float is tucked in behind each one to fill it.
+struct sDirLight
+{
+	glm::vec3 direction;
+	float pad0;
+	glm::vec3 ambient;
+	float pad1;
+	glm::vec3 diffuse;
+	float pad2;
+	glm::vec3 specular;
+	float pad3;
+};
+
+struct sPointLight
+{
+	glm::vec3 position;
+	float constant;
+	glm::vec3 ambient;
+	float linear;
+	glm::vec3 diffuse;
+	float quadratic;
+	glm::vec3 specular;
+	float pad0;
+};
+
+//Position and direction come first so following the camera only dirties the first 32 bytes
+struct sSpotLight
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 direction;
+	float outerCutOff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+};
+
+//Every light in the scene packed into one uniform buffer.
+//Setters only touch the CPU copy and widen a dirty range, upload() sends that range in one
+//glBufferSubData. Programs just need attaching once, after which they all read the same buffer.
+class cLightBuffer
+{
+public:
+	cLightBuffer();
+	~cLightBuffer();
+	//One UBO per buffer, copies would share (and delete) it
+	cLightBuffer(const cLightBuffer&) = delete;
+	cLightBuffer& operator=(const cLightBuffer&) = delete;
+
+	//Points the program's "Lights" block at LIGHT_BLOCK_BINDING, harmless if it has none
+	void attach(cShaderProgram& shader);
+
+	void setDirLight(const sDirLight& light);
+	void setPointLight(unsigned int index, const sPointLight& light);
+	void setSpotLight(const sSpotLight& light);
+	//The part of the spotlight that moves every frame
+	void setSpotLightPose(const glm::vec3& position, const glm::vec3& direction);
+
+	const sDirLight& getDirLight();
+	const sPointLight& getPointLight(unsigned int index);
+	const sSpotLight& getSpotLight();
+
+	void upload();
+
+	unsigned int UBO;
+
+private:
+	struct sLightBlock
+	{
+		sDirLight dirLight;
+		sPointLight pointLights[MAX_POINT_LIGHTS];
+		sSpotLight spotLight;
+	};
+	sLightBlock block;
+	//Byte range changed since the last upload, empty when dirtyBegin >= dirtyEnd
+	unsigned int dirtyBegin, dirtyEnd;
+
+	void markDirty(unsigned int offset, unsigned int size);
+};
+
+#endif
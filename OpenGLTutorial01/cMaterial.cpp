@@ -0,0 +1,74 @@
+#include "cMaterial.h"
+
+//Every material sampler with its name hashed at compile time, in unit order
+struct sMaterialSampler
+{
+	const char* name;
+	unsigned int hash;
+};
+
+static const sMaterialSampler materialSamplers[] = {
+	{ "material.texture_diffuse1", UniformNameHash("material.texture_diffuse1") },
+	{ "material.texture_diffuse2", UniformNameHash("material.texture_diffuse2") },
+	{ "material.texture_diffuse3", UniformNameHash("material.texture_diffuse3") },
+	{ "material.texture_diffuse4", UniformNameHash("material.texture_diffuse4") },
+	{ "material.texture_diffuse5", UniformNameHash("material.texture_diffuse5") },
+	{ "material.texture_specular1", UniformNameHash("material.texture_specular1") },
+	{ "material.texture_specular2", UniformNameHash("material.texture_specular2") },
+	{ "material.texture_specular3", UniformNameHash("material.texture_specular3") },
+	{ "material.texture_specular4", UniformNameHash("material.texture_specular4") },
+	{ "material.texture_specular5", UniformNameHash("material.texture_specular5") },
+};
+static_assert(sizeof(materialSamplers) / sizeof(materialSamplers[0]) == MATERIAL_SPECULAR_FIRST_UNIT + MAX_MATERIAL_TEXTURES_PER_TYPE,
+	"One sampler name per material unit");
+
+static const unsigned int SHININESS_HASH = UniformNameHash("material.shininess");
+
+//0 is left for draws without a material
+unsigned int cMaterial::nextSortID = 1;
+
+cMaterial::cMaterial()
+{
+	shininess = 32.0f;
+	sortID = nextSortID++;
+	numDiffuse = 0;
+	numSpecular = 0;
+}
+
+void cMaterial::addTexture(const sTexture& texture)
+{
+	sMaterialTexture materialTexture;
+	materialTexture.ID = texture.ID;
+
+	if (texture.type == "texture_diffuse" && numDiffuse < MAX_MATERIAL_TEXTURES_PER_TYPE)
+		materialTexture.unit = MATERIAL_DIFFUSE_FIRST_UNIT + numDiffuse++;
+	else if (texture.type == "texture_specular" && numSpecular < MAX_MATERIAL_TEXTURES_PER_TYPE)
+		materialTexture.unit = MATERIAL_SPECULAR_FIRST_UNIT + numSpecular++;
+	else
+		return;
+
+	textures.push_back(materialTexture);
+}
+
+void cMaterial::setSamplerUnits(cShaderProgram& shader)
+{
+	for (unsigned int unit = 0; unit < sizeof(materialSamplers) / sizeof(materialSamplers[0]); unit++)
+	{
+		//Samplers only take ints, a float here is an error and leaves the sampler on unit 0
+		int location = shader.getUniformLocation(materialSamplers[unit].name, materialSamplers[unit].hash);
+		if (location != -1)
+			glUniform1i(location, unit);
+	}
+	shader.materialSamplersSet = true;
+}
+
+void cMaterial::bind(cShaderProgram& shader) const
+{
+	if (!shader.materialSamplersSet)
+		setSamplerUnits(shader);
+
+	glUniform1f(shader.getUniformLocation("material.shininess", SHININESS_HASH), shininess);
+
+	for (unsigned int index = 0; index < textures.size(); index++)
+		cGLState::bindTexture(textures[index].unit, GL_TEXTURE_2D, textures[index].ID);
+}
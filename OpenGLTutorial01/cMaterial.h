@@ -0,0 +1,58 @@
+#ifndef _HG_cMaterial_
+#define _HG_cMaterial_
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "cShaderProgram.h"
+#include "cGLState.h"
+
+struct sTexture
+{
+	unsigned int ID;
+	std::string type;
+	std::string path;
+};
+
+//How many of each kind the Material struct in fragShader.glsl has room for
+const unsigned int MAX_MATERIAL_TEXTURES_PER_TYPE = 5;
+//Each material sampler always sits on the same unit, worked out from its name alone
+//(texture_diffuseN on N - 1, texture_specularN after the diffuse ones). That way a program's
+//sampler uniforms are set once and never again, whichever material draws with it.
+const unsigned int MATERIAL_DIFFUSE_FIRST_UNIT = 0;
+const unsigned int MATERIAL_SPECULAR_FIRST_UNIT = MATERIAL_DIFFUSE_FIRST_UNIT + MAX_MATERIAL_TEXTURES_PER_TYPE;
+
+//The textures and shininess of one aiMaterial, shared by every mesh that uses it
+class cMaterial
+{
+public:
+	cMaterial();
+
+	//Gives the texture the unit its type and count call for.
+	//Types the shaders have no sampler for (normal and height maps) and extras past
+	//MAX_MATERIAL_TEXTURES_PER_TYPE are dropped, nothing would have read them.
+	void addTexture(const sTexture& texture);
+
+	//Expects shader to be the current program. Points its samplers at their units the first
+	//time it sees the program, after that it's just the shininess and the texture binds.
+	void bind(cShaderProgram& shader) const;
+
+	float shininess;
+	//Small and different for every material, for grouping draws by material (see cRenderQueue)
+	unsigned int sortID;
+
+private:
+	struct sMaterialTexture
+	{
+		unsigned int ID;
+		unsigned int unit;
+	};
+	std::vector<sMaterialTexture> textures;
+	unsigned int numDiffuse, numSpecular;
+
+	static unsigned int nextSortID;
+	static void setSamplerUnits(cShaderProgram& shader);
+};
+
+#endif
@@ -1,67 +1,145 @@
 #include "cMesh.h"
 
-cMesh::cMesh(std::vector<sVertex> theVertices, std::vector<unsigned int> theIndices, std::vector<sTexture> theTextures)
+#include <cfloat>
+
+cMesh::cMesh(std::vector<sVertex> theVertices, std::vector<unsigned int> theIndices, const cMaterial* theMaterial)
 {
 	vertices = theVertices;
 	indices = theIndices;
-	textures = theTextures;
+	material = theMaterial;
 	skinnedMesh = false;
+	TangentVBO = 0;
+	computeBounds();
 	setupMesh();
 }
 
-cMesh::cMesh(std::vector<sSkinnedMeshVertex> theVertices, std::vector<unsigned int> theIndices, std::vector<sTexture> theTextures)
+cMesh::cMesh(std::vector<sSkinnedMeshVertex> theVertices, std::vector<unsigned int> theIndices, const cMaterial* theMaterial,
+	std::vector<glm::i16vec4> theTangentFrames)
 {
 	skinnedVertices = theVertices;
+	tangentFrames = theTangentFrames;
 	indices = theIndices;
-	textures = theTextures;
+	material = theMaterial;
 	skinnedMesh = true;
+	TangentVBO = 0;
+	computeBounds();
 	setupMesh();
 }
 
-void cMesh::Draw(cShaderProgram shader)
+void cMesh::Draw(cShaderProgram& shader)
 {
-	unsigned int diffuseNum = 1;
-	unsigned int specularNum = 1;
+	bindMaterial(shader);
+	DrawGeometry();
+}
 
-	for (int index = 0; index < textures.size(); index++)
-	{
-		glActiveTexture(GL_TEXTURE0 + index);
+void cMesh::DrawGeometry()
+{
+	//The VAO stays bound, everything that touches vertex state binds its own first,
+	//so drawing the same mesh again costs no bind
+	cGLState::bindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+}
+
+void cMesh::DrawInstanced(cShaderProgram& shader, unsigned int instanceCount, unsigned int vao)
+{
+	bindMaterial(shader);
+
+	cGLState::bindVertexArray(vao != 0 ? vao : VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+}
+
+unsigned int cMesh::getVAO()
+{
+	return VAO;
+}
+
+unsigned int cMesh::getEBO()
+{
+	return EBO;
+}
+
+void cMesh::DrawBaseVertex(cShaderProgram& shader, unsigned int vao, int baseVertex)
+{
+	bindMaterial(shader);
 
-		std::string number;
-		std::string name = textures[index].type;
-		if (name == "texture_diffuse")
-			number = std::to_string(diffuseNum++);
-		else if (name == "texture_specular")
-			number = std::to_string(specularNum++);
+	//The element buffer binding is part of the VAO, so point it at our indices for this draw
+	cGLState::bindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glDrawElementsBaseVertex(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0, baseVertex);
+}
 
-		shader.setFloat(("material." + name + number).c_str(), index);
-		glBindTexture(GL_TEXTURE_2D, textures[index].ID);
+void cMesh::computeBounds()
+{
+	unsigned int numVertices = skinnedMesh ? skinnedVertices.size() : vertices.size();
+	if (numVertices == 0)
+	{
+		boundsMin = boundsMax = glm::vec3(0.0f);
+		return;
 	}
-	glActiveTexture(GL_TEXTURE0);
 
-	//Once all textures are bound, draw
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (unsigned int index = 0; index < numVertices; index++)
+	{
+		const glm::vec3& position = skinnedMesh ? skinnedVertices[index].Position : vertices[index].Position;
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
 }
 
-void cMesh::setupMesh()
+void cMesh::bindMaterial(cShaderProgram& shader)
 {
+	if (material != NULL)
+		material->bind(shader);
+}
 
+void cMesh::setupMesh()
+{
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	//Bind VAO
+	cGLState::bindVertexArray(VAO);
+	//Set vertex data
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	if (skinnedMesh)
-	{
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-		//Bind VAO
-		glBindVertexArray(VAO);
-		//Set vertex data
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, skinnedVertices.size() * sizeof(sSkinnedMeshVertex), &skinnedVertices[0], GL_STATIC_DRAW);
-		//Set index data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(sVertex), &vertices[0], GL_STATIC_DRAW);
+	//Set index data
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+	//Tangent frame, only if the mesh has one
+	if (skinnedMesh && !tangentFrames.empty())
+	{
+		glGenBuffers(1, &TangentVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, TangentVBO);
+		glBufferData(GL_ARRAY_BUFFER, tangentFrames.size() * sizeof(glm::i16vec4), &tangentFrames[0], GL_STATIC_DRAW);
+	}
+
+	setupAttributes();
+	cGLState::bindVertexArray(0);
+}
 
+unsigned int cMesh::createVAO()
+{
+	unsigned int vao = 0;
+	glGenVertexArrays(1, &vao);
+	cGLState::bindVertexArray(vao);
+	setupAttributes();
+	cGLState::bindVertexArray(0);
+	return vao;
+}
+
+void cMesh::setupAttributes()
+{
+	//Into whichever VAO is bound, the element buffer binding is part of it too
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+	if (skinnedMesh)
+	{
 		//Set vertex attributes
 		//Position
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)0);
@@ -72,36 +150,23 @@ void cMesh::setupMesh()
 		//Texture coordinates
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, TexCoords));
 		glEnableVertexAttribArray(2);
-		//Tangent
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, Tangent));
-		glEnableVertexAttribArray(3);
-		//BiTangent
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, BiTangent));
-		glEnableVertexAttribArray(4);
-		//Bone IDs
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, BoneID));
+		//Bone IDs, read as integers so the shader can index with them directly
+		glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, BoneID));
 		glEnableVertexAttribArray(5);
 		//Bone Weights
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, BoneWeights));
+		glVertexAttribPointer(6, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(sSkinnedMeshVertex), (void*)offsetof(sSkinnedMeshVertex, BoneWeights));
 		glEnableVertexAttribArray(6);
 
-		glBindVertexArray(0);
+		//Without a tangent frame the attribute stays disabled and reads as (0,0,0,1), the identity quaternion
+		if (TangentVBO != 0)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, TangentVBO);
+			glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, sizeof(glm::i16vec4), (void*)0);
+			glEnableVertexAttribArray(3);
+		}
 	}
-
 	else
 	{
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-		//Bind VAO
-		glBindVertexArray(VAO);
-		//Set vertex data
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(sVertex), &vertices[0], GL_STATIC_DRAW);
-		//Set index data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
 		//Set vertex attributes
 		//Position
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(sVertex), (void*)0);
@@ -112,8 +177,7 @@ void cMesh::setupMesh()
 		//Texture coordinates
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(sVertex), (void*)offsetof(sVertex, TexCoords));
 		glEnableVertexAttribArray(2);
-
-		glBindVertexArray(0);
 	}
 
-}
\ No newline at end of file
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
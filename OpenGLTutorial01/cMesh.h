@@ -7,8 +7,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 #include "cShaderProgram.h"
+#include "cMaterial.h"
+#include "cGLState.h"
 
 struct sVertex
 {
@@ -17,23 +20,16 @@ struct sVertex
 	glm::vec2 TexCoords;
 };
 
+//44 bytes. Bone indices are bytes read as integers, weights are unorm16 that sum to one.
+//Tangent frames live in their own stream so meshes without them don't pay for them.
 struct sSkinnedMeshVertex
 {
 	glm::vec3 Position;
 	glm::vec3 Normal;
 	glm::vec2 TexCoords;
-	glm::vec3 Tangent;
-	glm::vec3 BiTangent;
 
-	float BoneID[4];
-	float BoneWeights[4];
-};
-
-struct sTexture
-{
-	unsigned int ID;
-	std::string type;
-	std::string path;
+	unsigned char BoneID[4];
+	unsigned short BoneWeights[4];
 };
 
 class cMesh
@@ -42,17 +38,41 @@ public:
 	std::vector<sVertex> vertices;
 	std::vector<sSkinnedMeshVertex> skinnedVertices;
 	std::vector<unsigned int> indices;
-	std::vector<sTexture> textures;
+	//Shared with every other mesh made from the same aiMaterial, owned by the model
+	const cMaterial* material;
+	//Optional per vertex QTangents (snorm16 quaternions) for skinned meshes
+	std::vector<glm::i16vec4> tangentFrames;
+	//Skinned meshes index a compact palette of only the bones they use,
+	//boneRemap[local index] is the bone's index in the skeleton
+	std::vector<unsigned int> boneRemap;
+	//Box around the vertices in model space, the bind pose for skinned meshes
+	glm::vec3 boundsMin, boundsMax;
 
-	cMesh(std::vector<sVertex> theVertices, std::vector<unsigned int> theIndices, std::vector<sTexture> theTextures);
-	cMesh(std::vector<sSkinnedMeshVertex> theVertices, std::vector<unsigned int> theIndices, std::vector<sTexture> theTextures);
-	void Draw(cShaderProgram shader);
+	cMesh(std::vector<sVertex> theVertices, std::vector<unsigned int> theIndices, const cMaterial* theMaterial);
+	cMesh(std::vector<sSkinnedMeshVertex> theVertices, std::vector<unsigned int> theIndices, const cMaterial* theMaterial,
+		std::vector<glm::i16vec4> theTangentFrames = std::vector<glm::i16vec4>());
+	void Draw(cShaderProgram& shader);
+	//Draw without binding the material, for when the last mesh drawn already bound the same one
+	void DrawGeometry();
+	//vao is one made by createVAO with the instance attributes added, 0 draws from our own
+	void DrawInstanced(cShaderProgram& shader, unsigned int instanceCount, unsigned int vao = 0);
+	unsigned int getVAO();
+	//A new VAO reading our vertex and index buffers, for callers that add attributes of their
+	//own (per instance data) without touching the one everyone else draws with. The caller deletes it.
+	unsigned int createVAO();
+	unsigned int getEBO();
+	//Draws this mesh's triangles out of someone else's vertex buffer (bound to vao),
+	//starting at baseVertex. Used for vertices that were already skinned this frame.
+	void DrawBaseVertex(cShaderProgram& shader, unsigned int vao, int baseVertex);
 
 private:
-	unsigned int VAO, VBO, EBO;
+	unsigned int VAO, VBO, EBO, TangentVBO;
 	bool skinnedMesh;
 
 	void setupMesh();
+	void setupAttributes();
+	void computeBounds();
+	void bindMaterial(cShaderProgram& shader);
 };
 
 #endif
@@ -2,19 +2,64 @@
 #include "cModel.h"
 #include "src\stb_image.h"
 
+#include <algorithm>
+
 cModel::cModel(std::string path)
 {
+	//Stays empty if the file doesn't load
+	boundsMin = boundsMax = glm::vec3(0.0f);
 	loadModel(path);
 }
 
-void cModel::Draw(cShaderProgram shader)
+void cModel::Draw(cShaderProgram& shader)
 {
-	for (int index = 0; index < meshes.size(); index++)
+	const cMaterial* boundMaterial = NULL;
+	for (unsigned int index = 0; index < drawOrder.size(); index++)
 	{
-		meshes[index].Draw(shader);
+		cMesh& mesh = meshes[drawOrder[index]];
+		if (index == 0 || mesh.material != boundMaterial)
+		{
+			mesh.Draw(shader);
+			boundMaterial = mesh.material;
+		}
+		else
+			mesh.DrawGeometry();
 	}
 }
 
+unsigned int cModel::Submit(cRenderBucket& bucket, unsigned int pass, const sDrawPacket& packet, float depth,
+	const cFrustum* frustum)
+{
+	sDrawPacket meshPacket = packet;
+	meshPacket.mode = GL_TRIANGLES;
+	meshPacket.indexed = true;
+	meshPacket.first = 0;
+	unsigned int numSubmitted = 0;
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		//A model with a single mesh was already tested as a whole by whoever called us
+		if (frustum != NULL && meshes.size() > 1)
+		{
+			glm::vec3 worldMin, worldMax;
+			TransformAABB(packet.model, meshes[index].boundsMin, meshes[index].boundsMax, worldMin, worldMax);
+			if (!frustum->intersectsAABB(worldMin, worldMax))
+				continue;
+		}
+
+		meshPacket.VAO = meshes[index].getVAO();
+		meshPacket.count = meshes[index].indices.size();
+		meshPacket.material = meshes[index].material;
+		bucket.submit(pass, meshPacket, depth);
+		numSubmitted++;
+	}
+	return numSubmitted;
+}
+
+unsigned int cModel::getNumMeshes()
+{
+	return meshes.size();
+}
+
 void cModel::loadModel(std::string path)
 {
 	Assimp::Importer importer;
@@ -27,7 +72,40 @@ void cModel::loadModel(std::string path)
 	}
 	directory = path.substr(0, path.find_last_of('/'));
 
+	//Every material up front, meshes only point at them
+	materials.resize(scene->mNumMaterials);
+	for (unsigned int index = 0; index < scene->mNumMaterials; index++)
+		processMaterial(materials[index], scene->mMaterials[index]);
+
 	processNode(scene->mRootNode, scene);
+
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		boundsMin = index == 0 ? meshes[index].boundsMin : glm::min(boundsMin, meshes[index].boundsMin);
+		boundsMax = index == 0 ? meshes[index].boundsMax : glm::max(boundsMax, meshes[index].boundsMax);
+	}
+
+	drawOrder.resize(meshes.size());
+	for (unsigned int index = 0; index < meshes.size(); index++)
+		drawOrder[index] = index;
+	std::stable_sort(drawOrder.begin(), drawOrder.end(), [this](unsigned int a, unsigned int b)
+	{
+		return meshes[a].material < meshes[b].material;
+	});
+}
+
+void cModel::processMaterial(cMaterial& material, aiMaterial* aiMat)
+{
+	std::vector<sTexture> diffuseMaps = loadMaterialTextures(aiMat, aiTextureType_DIFFUSE, "texture_diffuse");
+	for (unsigned int index = 0; index < diffuseMaps.size(); index++)
+		material.addTexture(diffuseMaps[index]);
+	std::vector<sTexture> specularMaps = loadMaterialTextures(aiMat, aiTextureType_SPECULAR, "texture_specular");
+	for (unsigned int index = 0; index < specularMaps.size(); index++)
+		material.addTexture(specularMaps[index]);
+
+	float shininess;
+	if (aiMat->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess > 0.0f)
+		material.shininess = shininess;
 }
 
 void cModel::processNode(aiNode* node, const aiScene* scene)
@@ -49,7 +127,6 @@ cMesh cModel::processMesh(aiMesh* mesh, const aiScene* scene)
 {
 	std::vector<sVertex> theVertices;
 	std::vector<unsigned int> theIndices;
-	std::vector<sTexture> theTextures;
 
 	for (int index = 0; index < mesh->mNumVertices; index++)
 	{
@@ -85,16 +162,11 @@ cMesh cModel::processMesh(aiMesh* mesh, const aiScene* scene)
 		}
 	}
 
-	if (mesh->mMaterialIndex >= 0)
-	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<sTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		theTextures.insert(theTextures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<sTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		theTextures.insert(theTextures.end(), specularMaps.begin(), specularMaps.end());
-	}
+	const cMaterial* material = NULL;
+	if (mesh->mMaterialIndex < materials.size())
+		material = &materials[mesh->mMaterialIndex];
 
-	return cMesh(theVertices, theIndices, theTextures);
+	return cMesh(theVertices, theIndices, material);
 }
 
 std::vector<sTexture> cModel::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
@@ -147,7 +219,7 @@ unsigned int cModel::TextureFromFile(const char* path, const std::string &direct
 		else if (nrComponents == 4)
 			format = GL_RGBA;
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		cGLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
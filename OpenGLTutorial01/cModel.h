@@ -11,21 +11,39 @@
 
 #include "cShaderProgram.h"
 #include "cMesh.h"
+#include "cGLState.h"
+#include "cRenderQueue.h"
+#include "cFrustum.h"
 
 class cModel
 {
 public:
 	cModel(std::string path);
-	void Draw(cShaderProgram shader);
+	//Meshes go out grouped by material, so each material's textures are bound once per call
+	void Draw(cShaderProgram& shader);
+	//One packet per mesh, each a copy of packet with the mesh's geometry and material filled in.
+	//Given a frustum, meshes whose boxes (moved by packet.model) are outside it are left out.
+	//Returns how many went in.
+	unsigned int Submit(cRenderBucket& bucket, unsigned int pass, const sDrawPacket& packet, float depth,
+		const cFrustum* frustum = NULL);
+	unsigned int getNumMeshes();
+
+	//Box around every mesh, in model space
+	glm::vec3 boundsMin, boundsMax;
 
 private:
 	std::vector<sTexture> textures_loaded;
+	//One per aiMaterial, sized once while loading so the meshes' pointers into it hold
+	std::vector<cMaterial> materials;
 	std::vector<cMesh> meshes;
+	//Mesh indices sorted by material
+	std::vector<unsigned int> drawOrder;
 	std::string directory;
 
 	void loadModel(std::string path);
 	void processNode(aiNode* node, const aiScene* scene);
 	cMesh processMesh(aiMesh* mesh, const aiScene* scene);
+	void processMaterial(cMaterial& material, aiMaterial* aiMat);
 	std::vector<sTexture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
 	unsigned int TextureFromFile(const char* path, const std::string &directory, bool gamma = false);
 };
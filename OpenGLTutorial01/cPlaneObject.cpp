@@ -2,6 +2,9 @@
 
 cPlaneObject::cPlaneObject()
 {
+	boundsMin = glm::vec3(-0.5f, -0.5f, 0.0f);
+	boundsMax = glm::vec3(0.5f, 0.5f, 0.0f);
+
 	float planeVertices[] = {
 		// positions          // texture coords
 		0.5f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, // top right
@@ -18,7 +21,7 @@ cPlaneObject::cPlaneObject()
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &EBO);
 
-	glBindVertexArray(VAO);
+	cGLState::bindVertexArray(VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
@@ -5,12 +5,16 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "cGLState.h"
+
 class cPlaneObject
 {
 public:
 	cPlaneObject();
 
 	unsigned int VAO;
+	//A unit square in the xy plane
+	glm::vec3 boundsMin, boundsMax;
 
 private:
 	unsigned int VBO, EBO;
@@ -0,0 +1,125 @@
+#include "cPoseCache.h"
+#include "cSkinnedMesh.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+cPoseCache::cPoseCache()
+{
+	timeQuantum = 0.0f;
+	snapPhase = false;
+	maxIdleFrames = 60;
+
+	frameNumber = 0;
+	numRequests = 0;
+	numHits = 0;
+	numEvaluations = 0;
+}
+
+bool cPoseCache::sPoseKey::operator==(const sPoseKey& other) const
+{
+	return skeleton == other.skeleton && clip == other.clip && quantizedTime == other.quantizedTime;
+}
+
+size_t cPoseCache::sPoseKeyHash::operator()(const sPoseKey& key) const
+{
+	//The pointer's low bits are all alignment, so shift them off before mixing
+	unsigned long long hash = (unsigned long long)(size_t)key.skeleton >> 4;
+	hash = hash * 0x9E3779B97F4A7C15ull + (unsigned int)key.clip;
+	hash = hash * 0x9E3779B97F4A7C15ull + (unsigned long long)key.quantizedTime;
+	return (size_t)(hash ^ (hash >> 32));
+}
+
+void cPoseCache::beginFrame()
+{
+	frameNumber++;
+	numRequests = 0;
+	numHits = 0;
+	numEvaluations = 0;
+
+	//Keep recently used entries around so their vectors get reused instead of reallocated
+	std::unordered_map<sPoseKey, sPose, sPoseKeyHash>::iterator it = mapPoses.begin();
+	while (it != mapPoses.end())
+	{
+		if (frameNumber - it->second.lastFrame > maxIdleFrames)
+			it = mapPoses.erase(it);
+		else
+			it++;
+	}
+}
+
+long long cPoseCache::quantize(float time)
+{
+	if (timeQuantum <= 0.0f)
+	{
+		//Exact sharing: use the bit pattern of the time itself
+		int bits;
+		std::memcpy(&bits, &time, sizeof(bits));
+		return bits;
+	}
+	return (long long)std::floor(time / timeQuantum + 0.5f);
+}
+
+float cPoseCache::snapTime(float time)
+{
+	if (timeQuantum <= 0.0f)
+		return time;
+	return (float)quantize(time) * timeQuantum;
+}
+
+cPoseCache::sPose* cPoseCache::getPose(cSkinnedMesh* skeleton, int clip, float time)
+{
+	numRequests++;
+
+	sPoseKey key;
+	key.skeleton = skeleton;
+	key.clip = clip;
+	key.quantizedTime = quantize(time);
+
+	sPose& pose = mapPoses[key];
+	if (pose.lastFrame == frameNumber && !pose.finalTransformation.empty())
+	{
+		numHits++;
+	}
+	else
+	{
+		//Evaluate at the quantized time so every sharer gets exactly the same pose
+		skeleton->BoneTransform(snapTime(time), skeleton->VecClips[clip].Name, pose.finalTransformation, pose.globals, pose.offsets);
+		pose.lastFrame = frameNumber;
+		pose.paletteOffsets.clear();
+		numEvaluations++;
+	}
+
+	return &pose;
+}
+
+unsigned int cPoseCache::getRequests()
+{
+	return numRequests;
+}
+
+unsigned int cPoseCache::getHits()
+{
+	return numHits;
+}
+
+unsigned int cPoseCache::getEvaluations()
+{
+	return numEvaluations;
+}
+
+float cPoseCache::getHitRate()
+{
+	if (numRequests == 0)
+		return 0.0f;
+	return (float)numHits / (float)numRequests;
+}
+
+void cPoseCache::printStats()
+{
+	std::cout << "Pose cache: " << numRequests << " requests, "
+		<< numEvaluations << " evaluated, "
+		<< numHits << " saved ("
+		<< getHitRate() * 100.0f << "% hit rate)" << std::endl;
+}
@@ -0,0 +1,76 @@
+#ifndef _HG_cPoseCache_
+#define _HG_cPoseCache_
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+class cSkinnedMesh;
+
+//Shares evaluated bone palettes between characters that play the same clip
+//at the same (quantized) time during one frame.
+//A skeleton is its cSkinnedMesh, so characters only share if they were built on the same one.
+class cPoseCache
+{
+public:
+	cPoseCache();
+
+	//Poses are shared between requests that fall in the same quantum (seconds)
+	//0 means only exactly matching times are shared
+	float timeQuantum;
+	//When true, characters snap their animation clock onto the quantum so they land on shared entries
+	bool snapPhase;
+	//Entries not touched for this many frames are dropped
+	unsigned int maxIdleFrames;
+
+	struct sPose
+	{
+		sPose() : lastFrame(0) {};
+		std::vector<glm::mat4> finalTransformation;
+		std::vector<glm::mat4> globals;
+		std::vector<glm::mat4> offsets;
+		unsigned int lastFrame;
+		//Where each sub-mesh's slice of this pose lives in the frame's bone palette,
+		//empty until someone writes it there
+		std::vector<int> paletteOffsets;
+	};
+
+	void beginFrame();
+	float snapTime(float time);
+	//clip is the skeleton's cSkinnedMesh::FindClip index, looked up once by the caller
+	sPose* getPose(cSkinnedMesh* skeleton, int clip, float time);
+
+	unsigned int getRequests();
+	unsigned int getHits();
+	unsigned int getEvaluations();
+	float getHitRate();
+	void printStats();
+
+private:
+	struct sPoseKey
+	{
+		const cSkinnedMesh* skeleton;
+		int clip;
+		long long quantizedTime;
+
+		bool operator==(const sPoseKey& other) const;
+	};
+	struct sPoseKeyHash
+	{
+		size_t operator()(const sPoseKey& key) const;
+	};
+
+	//Nodes keep their address, so poses handed out stay put while others are added
+	std::unordered_map<sPoseKey, sPose, sPoseKeyHash> mapPoses;
+	unsigned int frameNumber;
+
+	//Per frame statistics
+	unsigned int numRequests;
+	unsigned int numHits;
+	unsigned int numEvaluations;
+
+	long long quantize(float time);
+};
+
+#endif
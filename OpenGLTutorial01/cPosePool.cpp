@@ -0,0 +1,102 @@
+#include "cPosePool.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POSE_BLEND_SSE
+#endif
+
+void AccumulateLocalPose(sLocalTransform* accumulated, const sLocalTransform* pose, unsigned int count, float weight)
+{
+#ifdef POSE_BLEND_SSE
+	__m128 w = _mm_set1_ps(weight);
+	__m128 signBit = _mm_set1_ps(-0.0f);
+	for (unsigned int index = 0; index < count; index++)
+	{
+		__m128 sum = _mm_loadu_ps(&accumulated[index].Rotation.x);
+		__m128 rotation = _mm_loadu_ps(&pose[index].Rotation.x);
+
+		//4 wide dot product, the result ends up in every lane
+		__m128 dot = _mm_mul_ps(sum, rotation);
+		dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2, 3, 0, 1)));
+		dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+		//q and -q are the same rotation, take whichever is closer to what we have so far
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+		rotation = _mm_xor_ps(rotation, flip);
+		_mm_storeu_ps(&accumulated[index].Rotation.x, _mm_add_ps(sum, _mm_mul_ps(rotation, w)));
+
+		__m128 translation = _mm_loadu_ps(&accumulated[index].Translation.x);
+		_mm_storeu_ps(&accumulated[index].Translation.x, _mm_add_ps(translation, _mm_mul_ps(_mm_loadu_ps(&pose[index].Translation.x), w)));
+
+		__m128 scale = _mm_loadu_ps(&accumulated[index].Scale.x);
+		_mm_storeu_ps(&accumulated[index].Scale.x, _mm_add_ps(scale, _mm_mul_ps(_mm_loadu_ps(&pose[index].Scale.x), w)));
+	}
+#else
+	for (unsigned int index = 0; index < count; index++)
+	{
+		glm::vec4 rotation = pose[index].Rotation;
+		if (glm::dot(accumulated[index].Rotation, rotation) < 0.0f)
+			rotation = -rotation;
+		accumulated[index].Rotation += rotation * weight;
+		accumulated[index].Translation += pose[index].Translation * weight;
+		accumulated[index].Scale += pose[index].Scale * weight;
+	}
+#endif
+}
+
+void NormalizeLocalPose(sLocalTransform* pose, unsigned int count)
+{
+	for (unsigned int index = 0; index < count; index++)
+	{
+		float length = std::sqrt(glm::dot(pose[index].Rotation, pose[index].Rotation));
+		if (length > 0.0f)
+			pose[index].Rotation /= length;
+		else
+			pose[index].Rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+cPosePool::cPosePool()
+{
+	this->localBuffersUsed = 0;
+	this->matrixBuffersUsed = 0;
+}
+
+void cPosePool::beginFrame()
+{
+	localBuffersUsed = 0;
+	matrixBuffersUsed = 0;
+}
+
+sLocalTransform* cPosePool::acquireLocal(unsigned int count)
+{
+	if (localBuffersUsed == vecLocalBuffers.size())
+		vecLocalBuffers.push_back(std::vector<sLocalTransform>());
+
+	std::vector<sLocalTransform>& buffer = vecLocalBuffers[localBuffersUsed++];
+	if (buffer.size() < count)
+		buffer.resize(count);
+	return &buffer[0];
+}
+
+glm::mat4* cPosePool::acquireMatrices(unsigned int count)
+{
+	if (matrixBuffersUsed == vecMatrixBuffers.size())
+		vecMatrixBuffers.push_back(std::vector<glm::mat4>());
+
+	std::vector<glm::mat4>& buffer = vecMatrixBuffers[matrixBuffersUsed++];
+	if (buffer.size() < count)
+		buffer.resize(count);
+	return &buffer[0];
+}
+
+unsigned int cPosePool::getLocalBuffersInUse()
+{
+	return localBuffersUsed;
+}
+
+unsigned int cPosePool::getMatrixBuffersInUse()
+{
+	return matrixBuffersUsed;
+}
@@ -0,0 +1,52 @@
+#ifndef _HG_cPosePool_
+#define _HG_cPosePool_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+//Local (parent relative) transform of one skeleton node. Kept as three vec4s
+//so poses can be blended four floats at a time.
+struct sLocalTransform
+{
+	glm::vec4 Rotation;		//Quaternion as x, y, z, w
+	glm::vec4 Translation;
+	glm::vec4 Scale;
+};
+
+//One clip taking part in a blend
+struct sBlendClip
+{
+	int clip;			//From cSkinnedMesh::FindClip
+	float time;			//Seconds
+	float weight;
+};
+
+//Adds weight * pose into accumulated, flipping rotations onto the same hemisphere first
+void AccumulateLocalPose(sLocalTransform* accumulated, const sLocalTransform* pose, unsigned int count, float weight);
+//Renormalizes the rotations after accumulating
+void NormalizeLocalPose(sLocalTransform* pose, unsigned int count);
+
+//Scratch pose buffers handed out during a frame and all given back at beginFrame.
+//Buffers are kept between frames, so once warmed up a blend never touches the heap.
+class cPosePool
+{
+public:
+	cPosePool();
+
+	void beginFrame();
+	sLocalTransform* acquireLocal(unsigned int count);
+	glm::mat4* acquireMatrices(unsigned int count);
+
+	unsigned int getLocalBuffersInUse();
+	unsigned int getMatrixBuffersInUse();
+
+private:
+	//Growing the outer vector moves the inner ones, which keeps their storage where it is
+	std::vector< std::vector<sLocalTransform> > vecLocalBuffers;
+	std::vector< std::vector<glm::mat4> > vecMatrixBuffers;
+	unsigned int localBuffersUsed;
+	unsigned int matrixBuffersUsed;
+};
+
+#endif
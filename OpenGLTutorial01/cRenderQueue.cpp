@@ -0,0 +1,268 @@
+#include "cRenderQueue.h"
+
+#include <cstring>
+#include <iostream>
+
+//Where each field sits in a key, see cRenderQueue.h
+static const unsigned int PASS_SHIFT = 60;
+static const unsigned int PROGRAM_SHIFT = 50;
+static const unsigned int MATERIAL_SHIFT = 36;
+static const unsigned int DEPTH_SHIFT = 12;
+static const unsigned long long PROGRAM_MASK = (1ull << 10) - 1;
+static const unsigned long long MATERIAL_MASK = (1ull << 14) - 1;
+static const unsigned long long DEPTH_MASK = (1ull << 24) - 1;
+static const unsigned long long VAO_MASK = (1ull << 12) - 1;
+
+//The key is sorted a byte at a time, least significant first
+static const unsigned int RADIX_BITS = 8;
+static const unsigned int RADIX_SIZE = 1 << RADIX_BITS;
+static const unsigned int RADIX_PASSES = 64 / RADIX_BITS;
+
+sDrawPacket::sDrawPacket()
+{
+	program = NULL;
+	material = NULL;
+	textureID = 0;
+	textureTarget = GL_TEXTURE_2D;
+	modelLocation = -1;
+	model = glm::mat4(1.0f);
+	intLocation = -1;
+	intValue = 0;
+	VAO = 0;
+	mode = GL_TRIANGLES;
+	indexed = false;
+	first = 0;
+	count = 0;
+	baseVertex = 0;
+	elementBuffer = 0;
+	instanceCount = 1;
+}
+
+void cRenderBucket::submit(unsigned int pass, const sDrawPacket& packet, float depth)
+{
+	packets.push_back(packet);
+	keys.push_back(cRenderQueue::makeKey(pass, packet, depth));
+}
+
+cRenderQueue::cRenderQueue(unsigned int numBuckets)
+{
+	buckets.resize(numBuckets > 0 ? numBuckets : 1);
+	numProgramChanges = 0;
+	numMaterialChanges = 0;
+}
+
+cRenderBucket& cRenderQueue::getBucket(unsigned int index)
+{
+	return buckets[index];
+}
+
+unsigned int cRenderQueue::getNumBuckets()
+{
+	return buckets.size();
+}
+
+void cRenderQueue::setPassBegin(unsigned int pass, std::function<void()> begin)
+{
+	if (pass >= MAX_RENDER_PASSES)
+	{
+		std::cout << "Render pass " << pass << " is past the last one (" << MAX_RENDER_PASSES - 1 << ")" << std::endl;
+		return;
+	}
+	passBegin[pass] = begin;
+}
+
+unsigned long long cRenderQueue::makeKey(unsigned int pass, const sDrawPacket& packet, float depth)
+{
+	//A positive float's bits count up as it does, so the top 24 of them order depths without
+	//needing to know the far plane. Behind the camera counts as right in front of it.
+	unsigned int depthBits = 0;
+	if (depth > 0.0f)
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	unsigned long long key = (unsigned long long)(pass & (MAX_RENDER_PASSES - 1)) << PASS_SHIFT;
+	key |= ((unsigned long long)(packet.program != NULL ? packet.program->ID : 0) & PROGRAM_MASK) << PROGRAM_SHIFT;
+	key |= ((unsigned long long)(packet.material != NULL ? packet.material->sortID : 0) & MATERIAL_MASK) << MATERIAL_SHIFT;
+	key |= ((unsigned long long)(depthBits >> 7) & DEPTH_MASK) << DEPTH_SHIFT;
+	key |= (unsigned long long)packet.VAO & VAO_MASK;
+	return key;
+}
+
+unsigned int cRenderQueue::getPass(unsigned long long key)
+{
+	return (unsigned int)(key >> PASS_SHIFT);
+}
+
+void cRenderQueue::sort()
+{
+	unsigned int numPackets = 0;
+	for (unsigned int index = 0; index < buckets.size(); index++)
+		numPackets += buckets[index].packets.size();
+
+	packets.clear();
+	packets.reserve(numPackets);
+	sorted.clear();
+	sorted.reserve(numPackets);
+	for (unsigned int bucket = 0; bucket < buckets.size(); bucket++)
+	{
+		for (unsigned int index = 0; index < buckets[bucket].packets.size(); index++)
+		{
+			sSortEntry entry;
+			entry.key = buckets[bucket].keys[index];
+			entry.packet = packets.size();
+			sorted.push_back(entry);
+			packets.push_back(buckets[bucket].packets[index]);
+		}
+	}
+
+	radixSort();
+}
+
+void cRenderQueue::radixSort()
+{
+	unsigned int numEntries = sorted.size();
+	if (numEntries < 2)
+		return;
+	scratch.resize(numEntries);
+
+	//Count every byte of every key in one go rather than once per pass
+	unsigned int counts[RADIX_PASSES][RADIX_SIZE];
+	std::memset(counts, 0, sizeof(counts));
+	for (unsigned int index = 0; index < numEntries; index++)
+	{
+		unsigned long long key = sorted[index].key;
+		for (unsigned int pass = 0; pass < RADIX_PASSES; pass++)
+			counts[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+	}
+
+	sSortEntry* from = &sorted[0];
+	sSortEntry* to = &scratch[0];
+	for (unsigned int pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		unsigned int shift = pass * RADIX_BITS;
+
+		//Every key has the same byte here (most do, the high bytes hold few passes and programs),
+		//so this pass wouldn't move anything
+		if (counts[pass][(from[0].key >> shift) & (RADIX_SIZE - 1)] == numEntries)
+			continue;
+
+		unsigned int offsets[RADIX_SIZE];
+		unsigned int total = 0;
+		for (unsigned int digit = 0; digit < RADIX_SIZE; digit++)
+		{
+			offsets[digit] = total;
+			total += counts[pass][digit];
+		}
+
+		//Front to back keeps it stable, which is what lets the next byte up sort on top of this one
+		for (unsigned int index = 0; index < numEntries; index++)
+			to[offsets[(from[index].key >> shift) & (RADIX_SIZE - 1)]++] = from[index];
+
+		sSortEntry* temp = from;
+		from = to;
+		to = temp;
+	}
+
+	if (from != &sorted[0])
+		sorted.swap(scratch);
+}
+
+void cRenderQueue::execute()
+{
+	numProgramChanges = 0;
+	numMaterialChanges = 0;
+
+	unsigned int next = 0;
+	for (unsigned int pass = 0; pass < MAX_RENDER_PASSES; pass++)
+	{
+		if (passBegin[pass])
+			passBegin[pass]();
+
+		//A pass's begin is free to switch programs, so nothing carries over from the last one
+		cShaderProgram* currentProgram = NULL;
+		const cMaterial* currentMaterial = NULL;
+		for (; next < sorted.size() && getPass(sorted[next].key) == pass; next++)
+		{
+			const sDrawPacket& packet = packets[sorted[next].packet];
+			//A stale shader handle resolves to NULL, leave the draw out rather than guess
+			if (packet.program == NULL)
+				continue;
+
+			if (packet.program != currentProgram)
+			{
+				packet.program->useProgram();
+				currentProgram = packet.program;
+				//The material's uniforms belong to the program, a new one needs them again
+				currentMaterial = NULL;
+				numProgramChanges++;
+			}
+
+			if (packet.textureID != 0)
+			{
+				cGLState::bindTexture(0, packet.textureTarget, packet.textureID);
+				//That's where the first diffuse texture goes too, so the material has to put it back
+				if (packet.textureTarget == GL_TEXTURE_2D)
+					currentMaterial = NULL;
+			}
+
+			if (packet.material != NULL && packet.material != currentMaterial)
+			{
+				packet.material->bind(*packet.program);
+				currentMaterial = packet.material;
+				numMaterialChanges++;
+			}
+
+			draw(packet);
+		}
+	}
+}
+
+void cRenderQueue::draw(const sDrawPacket& packet)
+{
+	if (packet.modelLocation != -1)
+		glUniformMatrix4fv(packet.modelLocation, 1, GL_FALSE, &packet.model[0][0]);
+	if (packet.intLocation != -1)
+		glUniform1i(packet.intLocation, packet.intValue);
+
+	cGLState::bindVertexArray(packet.VAO);
+	if (packet.indexed)
+	{
+		if (packet.elementBuffer != 0)
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, packet.elementBuffer);
+		if (packet.instanceCount != 1)
+			glDrawElementsInstancedBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(unsigned int)), packet.instanceCount, packet.baseVertex);
+		else if (packet.baseVertex != 0)
+			glDrawElementsBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(unsigned int)), packet.baseVertex);
+		else
+			glDrawElements(packet.mode, packet.count, GL_UNSIGNED_INT, (void*)(packet.first * sizeof(unsigned int)));
+	}
+	else if (packet.instanceCount != 1)
+		glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instanceCount);
+	else
+		glDrawArrays(packet.mode, packet.first, packet.count);
+}
+
+void cRenderQueue::clear()
+{
+	for (unsigned int index = 0; index < buckets.size(); index++)
+	{
+		buckets[index].packets.clear();
+		buckets[index].keys.clear();
+	}
+	packets.clear();
+	sorted.clear();
+}
+
+unsigned int cRenderQueue::getNumPackets()
+{
+	return packets.size();
+}
+
+unsigned int cRenderQueue::getNumProgramChanges()
+{
+	return numProgramChanges;
+}
+
+unsigned int cRenderQueue::getNumMaterialChanges()
+{
+	return numMaterialChanges;
+}
@@ -0,0 +1,122 @@
+#ifndef _HG_cRenderQueue_
+#define _HG_cRenderQueue_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cMaterial.h"
+#include "cGLState.h"
+
+//Passes run in order, the pass is the top 4 bits of a key
+const unsigned int MAX_RENDER_PASSES = 16;
+
+//Everything one draw call needs. Filled in by whoever submits it, read once by execute().
+struct sDrawPacket
+{
+	sDrawPacket();
+
+	cShaderProgram* program;
+	//NULL for draws that bring no material, like the skybox and screen quads
+	const cMaterial* material;
+	//Bound on unit 0 before the material, 0 for none. The main shaders read the skybox here.
+	unsigned int textureID;
+	GLenum textureTarget;
+	//Where the program keeps its model matrix (locations[MODEL] in cShaderUniforms.h), -1 for none
+	int modelLocation;
+	glm::mat4 model;
+	//One int uniform set just before the draw, like a skinned sub-mesh's paletteOffset. -1 for none.
+	int intLocation;
+	int intValue;
+
+	unsigned int VAO;
+	GLenum mode;
+	//Indexed draws read count unsigned ints from the VAO's element buffer starting at first
+	bool indexed;
+	unsigned int first;
+	unsigned int count;
+	//Added to every index, for meshes drawn out of a shared vertex buffer like cSkinnedVertexCache's
+	int baseVertex;
+	//Bound into the VAO before an indexed draw, 0 keeps the VAO's own. For VAOs shared by meshes
+	//that each bring their own indices.
+	unsigned int elementBuffer;
+	//More than 1 draws the packet instanced, for crowds whose per instance data lives in the VAO
+	unsigned int instanceCount;
+};
+
+class cRenderQueue;
+
+//Where one thread submits its packets. Nothing in here locks, so give every thread its own
+//and don't touch any of them while the queue sorts or executes.
+class cRenderBucket
+{
+public:
+	//depth is the distance in front of the camera, opaque draws within a state go nearest first
+	void submit(unsigned int pass, const sDrawPacket& packet, float depth);
+
+private:
+	friend class cRenderQueue;
+	std::vector<sDrawPacket> packets;
+	std::vector<unsigned long long> keys;
+};
+
+//Draws collected as packets, sorted by a 64 bit key and then issued in one go.
+//From the top bit down a key is
+//	pass (4) | program (10) | material (14) | depth (24) | vertex array (12)
+//so a frame changes program as few times as its passes allow, then material, and within one
+//material draws go front to back so early depth testing throws away as much as it can.
+//Program, material and VAO only go into the key to group equal ones together, so two that
+//share bits just sort next to each other, the packet still draws with its own.
+class cRenderQueue
+{
+public:
+	//One bucket per thread that will be submitting at the same time
+	cRenderQueue(unsigned int numBuckets = 1);
+
+	cRenderBucket& getBucket(unsigned int index);
+	unsigned int getNumBuckets();
+
+	//Runs at the start of the pass every execute(), packets or not, so it can also clear.
+	//Set all the state the pass relies on here, cGLState drops whatever is already set.
+	void setPassBegin(unsigned int pass, std::function<void()> begin);
+
+	//Merges the buckets (in bucket order, so equal keys draw in the order they came in) and sorts
+	void sort();
+	//Issues every packet in key order, skipping program and material binds the last one already made
+	void execute();
+	//Empties the buckets but keeps their memory for the next frame
+	void clear();
+
+	unsigned int getNumPackets();
+	//How many times the last execute() changed program and material
+	unsigned int getNumProgramChanges();
+	unsigned int getNumMaterialChanges();
+
+	static unsigned long long makeKey(unsigned int pass, const sDrawPacket& packet, float depth);
+	static unsigned int getPass(unsigned long long key);
+
+private:
+	struct sSortEntry
+	{
+		unsigned long long key;
+		unsigned int packet;
+	};
+
+	std::vector<cRenderBucket> buckets;
+	std::function<void()> passBegin[MAX_RENDER_PASSES];
+
+	//Every bucket's packets back to back, and their keys in draw order after sort()
+	std::vector<sDrawPacket> packets;
+	std::vector<sSortEntry> sorted;
+	std::vector<sSortEntry> scratch;
+
+	unsigned int numProgramChanges, numMaterialChanges;
+
+	void radixSort();
+	void draw(const sDrawPacket& packet);
+};
+
+#endif
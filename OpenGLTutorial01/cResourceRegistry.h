@@ -0,0 +1,172 @@
+#ifndef _HG_cResourceRegistry_
+#define _HG_cResourceRegistry_
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <type_traits>
+
+#include "cModel.h"
+#include "cShaderProgram.h"
+#include "cGLState.h"
+
+//Refers to one resource in a cResourcePool<T>. Just two numbers, so it copies freely (between
+//threads too) and costs nothing to hold on to. The generation is bumped whenever the slot is
+//freed, so a handle to something that has since been removed no longer resolves.
+//A default constructed handle is null, generations start at 1.
+template <typename T>
+struct sHandle
+{
+	sHandle() : index(0), generation(0) {}
+	sHandle(unsigned int index, unsigned int generation) : index(index), generation(generation) {}
+
+	bool isNull() const { return generation == 0; }
+	bool operator==(const sHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const sHandle& other) const { return !(*this == other); }
+
+	unsigned int index;
+	unsigned int generation;
+};
+
+//What a TextureHandle resolves to
+struct sTextureResource
+{
+	sTextureResource() : ID(0), target(GL_TEXTURE_2D) {}
+	sTextureResource(unsigned int ID, GLenum target) : ID(ID), target(target) {}
+
+	unsigned int ID;
+	GLenum target;
+};
+
+typedef sHandle<cModel*> ModelHandle;
+typedef sHandle<cShaderProgram*> ShaderHandle;
+typedef sHandle<sTextureResource> TextureHandle;
+
+static_assert(std::is_trivially_copyable<ModelHandle>::value, "Handles have to stay plain values");
+
+//Resources of one kind in a dense array, reached through handles.
+//Names are for load time: find() looks one up once and the handle is what gets kept.
+//Resolving a handle is an index and a generation compare, never a string.
+//The pool doesn't own what it holds, whoever created a model or program still deletes it.
+template <typename T>
+class cResourcePool
+{
+public:
+	typedef sHandle<T> tHandle;
+
+	tHandle add(const std::string& name, const T& resource)
+	{
+		//An empty name marks a free slot
+		if (name.empty() || mapNameToHandle.find(name) != mapNameToHandle.end())
+		{
+			std::cout << "Resource \"" << name << "\" is unnamed or was already added" << std::endl;
+			return tHandle();
+		}
+
+		unsigned int index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = (unsigned int)resources.size();
+			resources.push_back(T());
+			generations.push_back(1);
+			names.push_back(std::string());
+		}
+
+		resources[index] = resource;
+		names[index] = name;
+		tHandle handle(index, generations[index]);
+		mapNameToHandle[name] = handle;
+		return handle;
+	}
+
+	//Frees the slot, every handle to it stops resolving. False if it was already gone.
+	bool remove(tHandle handle)
+	{
+		if (!isValid(handle))
+			return false;
+
+		mapNameToHandle.erase(names[handle.index]);
+		resources[handle.index] = T();
+		names[handle.index].clear();
+		//Skip 0 on wrap around, that's what null handles hold
+		if (++generations[handle.index] == 0)
+			generations[handle.index] = 1;
+		freeSlots.push_back(handle.index);
+		return true;
+	}
+
+	//Load time only, a null handle if there's nothing by that name
+	tHandle find(const std::string& name) const
+	{
+		typename std::map<std::string, tHandle>::const_iterator it = mapNameToHandle.find(name);
+		if (it == mapNameToHandle.end())
+		{
+			std::cout << "No resource named " << name << std::endl;
+			return tHandle();
+		}
+		return it->second;
+	}
+
+	bool isValid(tHandle handle) const
+	{
+		return !handle.isNull() && handle.index < generations.size() && generations[handle.index] == handle.generation;
+	}
+
+	//The resource, or T() (NULL for pointers) for a stale or null handle
+	T get(tHandle handle) const
+	{
+		if (!isValid(handle))
+			return T();
+		return resources[handle.index];
+	}
+
+	const std::string& getName(tHandle handle) const
+	{
+		static const std::string noName;
+		return isValid(handle) ? names[handle.index] : noName;
+	}
+
+	//Every live handle, for the odd pass over the lot
+	std::vector<tHandle> getHandles() const
+	{
+		std::vector<tHandle> handles;
+		for (unsigned int index = 0; index < generations.size(); index++)
+		{
+			if (!names[index].empty())
+				handles.push_back(tHandle(index, generations[index]));
+		}
+		return handles;
+	}
+
+private:
+	std::vector<T> resources;
+	std::vector<unsigned int> generations;
+	std::vector<std::string> names;
+	std::vector<unsigned int> freeSlots;
+	std::map<std::string, tHandle> mapNameToHandle;
+};
+
+//Every model, shader program and texture the scene draws with
+class cResourceRegistry
+{
+public:
+	cResourcePool<cModel*> models;
+	cResourcePool<cShaderProgram*> shaders;
+	cResourcePool<sTextureResource> textures;
+
+	//Binds the texture through cGLState, or 0 for a stale handle so nothing samples freed memory
+	void bindTexture(unsigned int unit, TextureHandle handle) const
+	{
+		sTextureResource texture = textures.get(handle);
+		cGLState::bindTexture(unit, texture.target, texture.ID);
+	}
+};
+
+#endif
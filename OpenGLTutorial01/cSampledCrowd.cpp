@@ -0,0 +1,158 @@
+#include "cSampledCrowd.h"
+#include "cBonePalette.h"
+
+#include <cstddef>
+
+//Vertex attribute slots after the skinned vertex layout, same as cInstancedCrowd
+const unsigned int INSTANCE_MODEL_LOCATION = 7;		//Takes 7 to 10
+
+cSampledCrowd::cSampledCrowd(cSkinnedMesh* mesh, cClipCurves* curves)
+{
+	this->mesh = mesh;
+	this->curves = curves;
+	this->numUploaded = 0;
+	this->paletteInstances = 0;
+
+	glGenBuffers(1, &instanceVBO);
+	glGenBuffers(1, &paletteBuffer);
+	glGenTextures(1, &paletteTextureID);
+
+	//The sampling pass has no vertices of its own, gl_VertexID picks the bone
+	glGenVertexArrays(1, &sampleVAO);
+	cGLState::bindVertexArray(sampleVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glVertexAttribIPointer(0, 2, GL_INT, sizeof(sSampledCrowdInstance), (void*)offsetof(sSampledCrowdInstance, Clip));
+	glEnableVertexAttribArray(0);
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(sSampledCrowdInstance), (void*)offsetof(sSampledCrowdInstance, TimeOffset));
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(sSampledCrowdInstance), (void*)offsetof(sSampledCrowdInstance, Blend));
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+
+	//And one per sub-mesh on the mesh's own buffers, for drawing
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		unsigned int vao = meshes[index].createVAO();
+		vecDrawVAOs.push_back(vao);
+		cGLState::bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(sSampledCrowdInstance),
+				(void*)(offsetof(sSampledCrowdInstance, Model) + column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + column);
+			glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + column, 1);
+		}
+	}
+
+	cGLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+cSampledCrowd::~cSampledCrowd()
+{
+	glDeleteVertexArrays(1, &sampleVAO);
+	cGLState::forgetVertexArray(sampleVAO);
+	for (unsigned int index = 0; index < vecDrawVAOs.size(); index++)
+	{
+		glDeleteVertexArrays(1, &vecDrawVAOs[index]);
+		cGLState::forgetVertexArray(vecDrawVAOs[index]);
+	}
+	glDeleteBuffers(1, &instanceVBO);
+	glDeleteBuffers(1, &paletteBuffer);
+	glDeleteTextures(1, &paletteTextureID);
+	cGLState::forgetTexture(paletteTextureID);
+}
+
+void cSampledCrowd::updateInstances()
+{
+	numUploaded = (unsigned int)instances.size();
+	if (numUploaded == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(sSampledCrowdInstance), &instances[0], GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Room for everyone's palette, only ever written and read by the GPU
+	if (numUploaded > paletteInstances)
+	{
+		paletteInstances = numUploaded;
+		glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, paletteInstances * curves->numBones * TEXELS_PER_BONE * sizeof(glm::vec4), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		cGLState::bindTexture(0, GL_TEXTURE_BUFFER, paletteTextureID);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBuffer);
+		cGLState::bindTexture(0, GL_TEXTURE_BUFFER, 0);
+	}
+}
+
+void cSampledCrowd::Sample(cShaderProgram& sampleShader, float time)
+{
+	if (numUploaded == 0 || curves->numBones == 0 || curves->vecClips.empty())
+		return;
+
+	sampleShader.useProgram();
+	curves->bind(sampleShader);
+	sampleShader.setFloat("time", time);
+
+	//Instances are captured one after another, so instance i's bones land at i * numBones
+	cGLState::enable(GL_RASTERIZER_DISCARD);
+	glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, paletteBuffer, 0, numUploaded * curves->numBones * TEXELS_PER_BONE * sizeof(glm::vec4));
+	cGLState::bindVertexArray(sampleVAO);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArraysInstanced(GL_POINTS, 0, curves->numBones, numUploaded);
+	glEndTransformFeedback();
+	cGLState::bindVertexArray(0);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	cGLState::disable(GL_RASTERIZER_DISCARD);
+}
+
+void cSampledCrowd::Draw(cShaderProgram& shader)
+{
+	if (numUploaded == 0)
+		return;
+
+	shader.useProgram();
+	bind(shader);
+
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		curves->bindMesh(shader, index);
+		meshes[index].DrawInstanced(shader, numUploaded, vecDrawVAOs[index]);
+	}
+}
+
+void cSampledCrowd::bind(cShaderProgram& shader)
+{
+	cGLState::bindTexture(SAMPLED_PALETTE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, paletteTextureID);
+	shader.setInt("sampledPalette", SAMPLED_PALETTE_TEXTURE_UNIT);
+	shader.setInt("numBones", curves->numBones);
+}
+
+void cSampledCrowd::Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sSampledSkinUniforms& uniforms, float depth)
+{
+	if (numUploaded == 0)
+		return;
+
+	sDrawPacket packet;
+	packet.program = program;
+	packet.intLocation = uniforms.locations[sSampledSkinUniforms::MESH_BONE_OFFSET];
+	packet.indexed = true;
+	packet.instanceCount = numUploaded;
+
+	std::vector<cMesh>& meshes = mesh->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size() && index < curves->meshBoneOffsets.size(); index++)
+	{
+		packet.material = meshes[index].material;
+		packet.VAO = vecDrawVAOs[index];
+		packet.count = (unsigned int)meshes[index].indices.size();
+		packet.intValue = curves->meshBoneOffsets[index];
+		bucket.submit(pass, packet, depth);
+	}
+}
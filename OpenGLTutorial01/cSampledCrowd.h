@@ -0,0 +1,67 @@
+#ifndef _HG_cSampledCrowd_
+#define _HG_cSampledCrowd_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "cShaderProgram.h"
+#include "cSkinnedMesh.h"
+#include "cClipCurves.h"
+#include "cGLState.h"
+#include "cRenderQueue.h"
+#include "cShaderUniforms.h"
+
+//Texture unit the sampled palettes are bound to, the shared bone palette keeps 15
+const unsigned int SAMPLED_PALETTE_TEXTURE_UNIT = 13;
+
+struct sSampledCrowdInstance
+{
+	glm::mat4 Model;
+	//Indices into the cClipCurves, the second is only sampled while Blend is above 0
+	int Clip[2];
+	//Seconds added to the crowd clock for each clip
+	float TimeOffset[2];
+	//0 plays Clip[0], 1 plays Clip[1]
+	float Blend;
+};
+
+//The other crowd mode next to cInstancedCrowd: instead of a baked clip, every instance's
+//palette is sampled from clip curves on the GPU each frame (one transform feedback draw),
+//so instances can play and blend any loaded clip and the CPU does nothing per instance.
+class cSampledCrowd
+{
+public:
+	cSampledCrowd(cSkinnedMesh* mesh, cClipCurves* curves);
+	~cSampledCrowd();
+	//Owns the palette buffer, its texture and the VAOs
+	cSampledCrowd(const cSampledCrowd&) = delete;
+	cSampledCrowd& operator=(const cSampledCrowd&) = delete;
+
+	std::vector<sSampledCrowdInstance> instances;
+
+	//Call after changing the instances
+	void updateInstances();
+	//Builds every instance's palette for this time, once a frame before any Draw
+	void Sample(cShaderProgram& sampleShader, float time);
+	void Draw(cShaderProgram& shader);
+	//Points the drawing shader at the sampled palettes, once a frame before the packets from Submit execute
+	void bind(cShaderProgram& shader);
+	//Queues one instanced packet per sub-mesh, the caller sets the camera on the program
+	void Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sSampledSkinUniforms& uniforms, float depth);
+
+private:
+	cSkinnedMesh* mesh;
+	cClipCurves* curves;
+	unsigned int instanceVBO;
+	//Only the per instance attributes, for the sampling pass
+	unsigned int sampleVAO;
+	//Each sub-mesh's buffers plus the instance matrices, made once
+	std::vector<unsigned int> vecDrawVAOs;
+	unsigned int paletteBuffer, paletteTextureID;
+	unsigned int numUploaded;
+	unsigned int paletteInstances;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "cScene.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SCENE_SSE
+#endif
+
+cScene::cScene()
+{
+	this->numNodes = 0;
+	this->numUpdated = 0;
+}
+
+int cScene::addNode(glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int parent)
+{
+	//Keeps every parent in front of its children, which updateWorldMatrices relies on
+	if (parent >= (int)this->numNodes)
+		parent = -1;
+
+	this->translationX.push_back(translation.x);
+	this->translationY.push_back(translation.y);
+	this->translationZ.push_back(translation.z);
+	this->rotationX.push_back(rotation.x);
+	this->rotationY.push_back(rotation.y);
+	this->rotationZ.push_back(rotation.z);
+	this->rotationW.push_back(rotation.w);
+	this->scaleX.push_back(scale.x);
+	this->scaleY.push_back(scale.y);
+	this->scaleZ.push_back(scale.z);
+	this->parent.push_back(parent);
+	this->dirty.push_back(1);
+	this->worldMatrices.push_back(glm::mat4(1.0f));
+
+	return this->numNodes++;
+}
+
+unsigned int cScene::getNumNodes()
+{
+	return this->numNodes;
+}
+
+void cScene::setTranslation(int node, glm::vec3 translation)
+{
+	if (this->translationX[node] == translation.x && this->translationY[node] == translation.y && this->translationZ[node] == translation.z)
+		return;
+
+	this->translationX[node] = translation.x;
+	this->translationY[node] = translation.y;
+	this->translationZ[node] = translation.z;
+	this->dirty[node] = 1;
+}
+
+void cScene::setRotation(int node, glm::quat rotation)
+{
+	if (this->rotationX[node] == rotation.x && this->rotationY[node] == rotation.y && this->rotationZ[node] == rotation.z
+		&& this->rotationW[node] == rotation.w)
+		return;
+
+	this->rotationX[node] = rotation.x;
+	this->rotationY[node] = rotation.y;
+	this->rotationZ[node] = rotation.z;
+	this->rotationW[node] = rotation.w;
+	this->dirty[node] = 1;
+}
+
+void cScene::setScale(int node, glm::vec3 scale)
+{
+	if (this->scaleX[node] == scale.x && this->scaleY[node] == scale.y && this->scaleZ[node] == scale.z)
+		return;
+
+	this->scaleX[node] = scale.x;
+	this->scaleY[node] = scale.y;
+	this->scaleZ[node] = scale.z;
+	this->dirty[node] = 1;
+}
+
+glm::vec3 cScene::getTranslation(int node)
+{
+	return glm::vec3(this->translationX[node], this->translationY[node], this->translationZ[node]);
+}
+
+glm::quat cScene::getRotation(int node)
+{
+	return glm::quat(this->rotationW[node], this->rotationX[node], this->rotationY[node], this->rotationZ[node]);
+}
+
+glm::vec3 cScene::getScale(int node)
+{
+	return glm::vec3(this->scaleX[node], this->scaleY[node], this->scaleZ[node]);
+}
+
+int cScene::getParent(int node)
+{
+	return this->parent[node];
+}
+
+void cScene::updateWorldMatrices()
+{
+	//Parents come before their children, so one sweep carries a change all the way down
+	this->changed.clear();
+	for (unsigned int node = 0; node < this->numNodes; node++)
+	{
+		int nodeParent = this->parent[node];
+		if (!this->dirty[node] && (nodeParent < 0 || !this->dirty[nodeParent]))
+			continue;
+
+		this->dirty[node] = 1;
+		this->changed.push_back(node);
+	}
+
+	this->buildLocalMatrices();
+	this->applyParents();
+
+	for (unsigned int index = 0; index < this->changed.size(); index++)
+		this->dirty[this->changed[index]] = 0;
+	this->numUpdated = this->changed.size();
+}
+
+void cScene::buildLocalMatrices()
+{
+	unsigned int numChanged = this->changed.size();
+	unsigned int index = 0;
+
+#ifdef SCENE_SSE
+	for (; index + 4 <= numChanged; index += 4)
+	{
+		const unsigned int* nodes = &this->changed[index];
+
+		//Gather four nodes into the lanes, _mm_set_ps takes its arguments last lane first
+#define SCENE_GATHER(stream) _mm_set_ps(stream[nodes[3]], stream[nodes[2]], stream[nodes[1]], stream[nodes[0]])
+		__m128 x = SCENE_GATHER(this->rotationX);
+		__m128 y = SCENE_GATHER(this->rotationY);
+		__m128 z = SCENE_GATHER(this->rotationZ);
+		__m128 w = SCENE_GATHER(this->rotationW);
+		__m128 sx = SCENE_GATHER(this->scaleX);
+		__m128 sy = SCENE_GATHER(this->scaleY);
+		__m128 sz = SCENE_GATHER(this->scaleZ);
+		__m128 tx = SCENE_GATHER(this->translationX);
+		__m128 ty = SCENE_GATHER(this->translationY);
+		__m128 tz = SCENE_GATHER(this->translationZ);
+#undef SCENE_GATHER
+
+		//The rotation matrix of a unit quaternion, the same terms glm::mat4_cast uses
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		//Column by column, each scaled by its axis
+		__m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		__m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		__m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		__m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		__m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		__m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		__m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		__m128 zero = _mm_setzero_ps();
+
+		//Each of those holds one element for all four nodes, a transpose turns them into each node's columns
+		_MM_TRANSPOSE4_PS(m00, m01, m02, zero);
+		__m128 column0[4] = { m00, m01, m02, zero };
+		zero = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(m10, m11, m12, zero);
+		__m128 column1[4] = { m10, m11, m12, zero };
+		zero = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(m20, m21, m22, zero);
+		__m128 column2[4] = { m20, m21, m22, zero };
+		__m128 w3 = one;
+		_MM_TRANSPOSE4_PS(tx, ty, tz, w3);
+		__m128 column3[4] = { tx, ty, tz, w3 };
+
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			float* matrix = &this->worldMatrices[nodes[lane]][0][0];
+			_mm_storeu_ps(matrix, column0[lane]);
+			_mm_storeu_ps(matrix + 4, column1[lane]);
+			_mm_storeu_ps(matrix + 8, column2[lane]);
+			_mm_storeu_ps(matrix + 12, column3[lane]);
+		}
+	}
+#endif
+
+	//Whatever is left over, or everything without SSE
+	for (; index < numChanged; index++)
+	{
+		unsigned int node = this->changed[index];
+		glm::mat4& matrix = this->worldMatrices[node];
+		matrix = glm::mat4_cast(this->getRotation(node));
+		matrix[0] *= this->scaleX[node];
+		matrix[1] *= this->scaleY[node];
+		matrix[2] *= this->scaleZ[node];
+		matrix[3] = glm::vec4(this->getTranslation(node), 1.0f);
+	}
+}
+
+void cScene::applyParents()
+{
+	for (unsigned int index = 0; index < this->changed.size(); index++)
+	{
+		unsigned int node = this->changed[index];
+		if (this->parent[node] < 0)
+			continue;
+
+		//The parent either changed and came earlier in the list, or didn't change at all,
+		//so its world matrix is final by now
+		const glm::mat4& parentMatrix = this->worldMatrices[this->parent[node]];
+		glm::mat4& matrix = this->worldMatrices[node];
+#ifdef SCENE_SSE
+		__m128 parentColumn0 = _mm_loadu_ps(&parentMatrix[0][0]);
+		__m128 parentColumn1 = _mm_loadu_ps(&parentMatrix[1][0]);
+		__m128 parentColumn2 = _mm_loadu_ps(&parentMatrix[2][0]);
+		__m128 parentColumn3 = _mm_loadu_ps(&parentMatrix[3][0]);
+		__m128 result[4];
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			const float* local = &matrix[column][0];
+			result[column] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(parentColumn0, _mm_set1_ps(local[0])), _mm_mul_ps(parentColumn1, _mm_set1_ps(local[1]))),
+				_mm_add_ps(_mm_mul_ps(parentColumn2, _mm_set1_ps(local[2])), _mm_mul_ps(parentColumn3, _mm_set1_ps(local[3]))));
+		}
+		for (unsigned int column = 0; column < 4; column++)
+			_mm_storeu_ps(&matrix[column][0], result[column]);
+#else
+		matrix = parentMatrix * matrix;
+#endif
+	}
+}
+
+const glm::mat4& cScene::getWorldMatrix(int node)
+{
+	return this->worldMatrices[node];
+}
+
+const glm::mat4* cScene::getWorldMatrices()
+{
+	return this->worldMatrices.empty() ? NULL : &this->worldMatrices[0];
+}
+
+unsigned int cScene::getNumUpdated()
+{
+	return this->numUpdated;
+}
+
+const std::vector<unsigned int>& cScene::getUpdatedNodes()
+{
+	return this->changed;
+}
@@ -0,0 +1,61 @@
+#ifndef _HG_cScene_
+#define _HG_cScene_
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+//Where everything in the scene stands. Translation, rotation and scale live in SoA streams
+//next to each node's parent, and world matrices are only rebuilt for nodes that changed
+//since the last updateWorldMatrices (and everything under them), four at a time with SSE.
+//Renderers read the world matrices straight out of here instead of building their own.
+class cScene
+{
+public:
+	cScene();
+
+	//Returns the node's slot. A parent has to be added before its children, -1 for none.
+	//World matrices are ready after the next updateWorldMatrices.
+	int addNode(glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int parent = -1);
+	unsigned int getNumNodes();
+
+	//Each of these only marks the node changed if the value really is different
+	void setTranslation(int node, glm::vec3 translation);
+	void setRotation(int node, glm::quat rotation);
+	void setScale(int node, glm::vec3 scale);
+	glm::vec3 getTranslation(int node);
+	glm::quat getRotation(int node);
+	glm::vec3 getScale(int node);
+	int getParent(int node);
+
+	//Rebuilds the world matrix of every node that changed, and of their children
+	void updateWorldMatrices();
+	//As of the last updateWorldMatrices
+	const glm::mat4& getWorldMatrix(int node);
+	//All of them, indexed by node
+	const glm::mat4* getWorldMatrices();
+	//How many the last updateWorldMatrices rebuilt, and which, parents first
+	unsigned int getNumUpdated();
+	const std::vector<unsigned int>& getUpdatedNodes();
+
+private:
+	unsigned int numNodes;
+	std::vector<float> translationX, translationY, translationZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<int> parent;
+	std::vector<unsigned char> dirty;
+	std::vector<glm::mat4> worldMatrices;
+
+	//The nodes being rebuilt, in order, so a parent is always finished before its children
+	std::vector<unsigned int> changed;
+	unsigned int numUpdated;
+
+	//Writes each changed node's own translation * rotation * scale into its world matrix slot
+	void buildLocalMatrices();
+	//Then multiplies in the parent's world matrix, for the ones that have a parent
+	void applyParents();
+};
+
+#endif
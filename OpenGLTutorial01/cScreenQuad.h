@@ -5,6 +5,8 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "cGLState.h"
+
 class cScreenQuad
 {
 public:
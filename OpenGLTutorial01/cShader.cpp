@@ -1,12 +1,15 @@
 #include "cShaderProgram.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
-#include <sstream>
+
+std::map<std::string, cShader::sSourceFile> cShader::mapNameToSourceFile;
 
 cShader::cShader()
 {
 	ID = -1;
-	numberOfLines = 0;
+	sourceHash = SHADER_HASH_SEED;
 }
 
 cShader::~cShader()
@@ -19,51 +22,128 @@ void cShader::setPath(std::string setPath)
 	this->path = setPath;
 }
 
-bool cShader::readFile(std::string name)
+void cShader::clearSourceCache()
 {
-	std::string fileName = path + name;
-	std::ifstream file(fileName.c_str());
-	if (!file.is_open())
-	{
-		return false;
-	}
+	mapNameToSourceFile.clear();
+}
 
-	this->shaderSource.clear();
+const cShader::sSourceFile* cShader::loadSourceFile(const std::string& fileName)
+{
+	std::map<std::string, sSourceFile>::iterator it = mapNameToSourceFile.find(fileName);
+	if (it != mapNameToSourceFile.end())
+		return &it->second;
 
-	char pLineTemp[65536] = { 0 };
-	while (file.getline(pLineTemp, 65536))
-	{
-		std::string thisLine(pLineTemp);
-		shaderSource.push_back(thisLine);
-	}
+	//The whole file in one read, straight into the string that keeps it
+	std::ifstream file(fileName.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return NULL;
+
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	if (size < 0)
+		return NULL;
+
+	sSourceFile sourceFile;
+	sourceFile.text.resize((size_t)size);
+	if (size > 0 && !file.read(&sourceFile.text[0], size))
+		return NULL;
+
+	sourceFile.hash = SHADER_HASH_SEED;
+	HashShaderBytes(sourceFile.hash, sourceFile.text.data(), sourceFile.text.size());
+
+	sSourceFile& cached = mapNameToSourceFile[fileName];
+	cached.text.swap(sourceFile.text);
+	cached.hash = sourceFile.hash;
+	return &cached;
+}
 
-	numberOfLines = shaderSource.size();
+bool cShader::readFile(std::string name, const std::vector<std::string>& defines)
+{
+	source.clear();
+	sourceFiles.clear();
+	sourceHash = SHADER_HASH_SEED;
 
-	setArray();
+	for (unsigned int index = 0; index < defines.size(); index++)
+		HashShaderBytes(sourceHash, defines[index].c_str(), defines[index].size() + 1);
 
-	return true;
+	return appendFile(name, &defines);
 }
 
-void cShader::setArray()
+bool cShader::appendFile(const std::string& name, const std::vector<std::string>* defines)
 {
-	arraySource = new char*[numberOfLines];
+	const sSourceFile* file = loadSourceFile(path + name);
+	if (file == NULL)
+	{
+		std::cout << "Couldn't read shader source " << path << name << std::endl;
+		return false;
+	}
+
+	unsigned int fileIndex = (unsigned int)sourceFiles.size();
+	sourceFiles.push_back(name);
+	HashShaderBytes(sourceHash, &file->hash, sizeof(file->hash));
 
-	memset(arraySource, 0, numberOfLines);
+	const std::string& text = file->text;
+	source.reserve(source.size() + text.size() + 64);
 
-	for (int index = 0; index < shaderSource.size(); index++)
+	char lineDirective[32];
+	if (fileIndex > 0)
 	{
-		unsigned int lineLength = shaderSource[index].size();
+		snprintf(lineDirective, sizeof(lineDirective), "#line 1 %u\n", fileIndex);
+		source += lineDirective;
+	}
 
-		arraySource[index] = new char[lineLength + 2];
-		memset(arraySource[index], 0, lineLength + 2);
+	unsigned int lineNumber = 0;
+	size_t lineStart = 0;
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = text.size();
+		lineNumber++;
 
-		for (int charIndex = 0; charIndex < shaderSource[index].size(); charIndex++)
+		size_t first = text.find_first_not_of(" \t", lineStart);
+		if (first < lineEnd && text.compare(first, 8, "#include") == 0)
+		{
+			size_t open = text.find('"', first + 8);
+			size_t close = (open < lineEnd) ? text.find('"', open + 1) : std::string::npos;
+			if (close >= lineEnd)
+			{
+				std::cout << path << name << "(" << lineNumber << "): expected #include \"file\"" << std::endl;
+				return false;
+			}
+
+			std::string includeName = text.substr(open + 1, close - open - 1);
+			if (std::find(sourceFiles.begin(), sourceFiles.end(), includeName) == sourceFiles.end())
+			{
+				if (!appendFile(includeName, NULL))
+					return false;
+			}
+
+			//Back to where we were, so errors after the include still point at the right line
+			snprintf(lineDirective, sizeof(lineDirective), "#line %u %u\n", lineNumber + 1, fileIndex);
+			source += lineDirective;
+		}
+		else
 		{
-			arraySource[index][charIndex] = shaderSource[index][charIndex];
+			source.append(text, lineStart, lineEnd - lineStart);
+			source += '\n';
+
+			//#version has to stay first, so the defines go after it and #line puts the numbering back
+			if (lineNumber == 1 && defines != NULL && !defines->empty() && first < lineEnd && text.compare(first, 8, "#version") == 0)
+			{
+				for (unsigned int index = 0; index < defines->size(); index++)
+				{
+					source += "#define ";
+					source += (*defines)[index];
+					source += '\n';
+				}
+				source += "#line 2\n";
+			}
 		}
 
-		arraySource[index][lineLength + 0] = '\n';
-		arraySource[index][lineLength + 1] = '\0';
+		lineStart = lineEnd + 1;
 	}
-	return;
-}
\ No newline at end of file
+
+	return true;
+}
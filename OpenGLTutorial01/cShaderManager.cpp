@@ -0,0 +1,96 @@
+#include "cShaderManager.h"
+
+cShaderManager::cShaderManager(std::string path)
+{
+	this->path = path;
+
+	//Needed the moment anything draws, so this one is compiled up front
+	fallbackProgram.compileProgram(path, "fallbackVert.glsl", "fallbackFrag.glsl");
+}
+
+cShaderManager::~cShaderManager()
+{
+	for (std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.begin(); it != mapNameToProgram.end(); it++)
+	{
+		glDeleteProgram(it->second.program->ID);
+		cGLState::forgetProgram(it->second.program->ID);
+		delete it->second.program;
+	}
+}
+
+void cShaderManager::add(std::string name, std::string vertFile, std::string fragFile,
+	const std::vector<std::string>& defines, std::function<void(cShaderProgram&)> onReady)
+{
+	if (mapNameToProgram.find(name) != mapNameToProgram.end())
+	{
+		std::cout << "Shader program " << name << " was already added" << std::endl;
+		return;
+	}
+
+	sProgramEntry entry;
+	entry.program = new cShaderProgram();
+	entry.onReady = onReady;
+	entry.ready = false;
+	entry.program->beginProgram(path, vertFile, fragFile, defines);
+
+	//Straight out of the binary cache, there is nothing left to wait for
+	if (!entry.program->isPending())
+		finish(entry);
+
+	mapNameToProgram[name] = entry;
+}
+
+void cShaderManager::finish(sProgramEntry& entry)
+{
+	entry.program->finishProgram();
+	entry.ready = true;
+	if (entry.onReady)
+		entry.onReady(*entry.program);
+}
+
+void cShaderManager::update()
+{
+	if (!cShaderProgram::hasParallelCompile())
+		return;
+
+	for (std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.begin(); it != mapNameToProgram.end(); it++)
+	{
+		if (!it->second.ready && it->second.program->isReady())
+			finish(it->second);
+	}
+}
+
+void cShaderManager::finishAll()
+{
+	for (std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.begin(); it != mapNameToProgram.end(); it++)
+	{
+		if (!it->second.ready)
+			finish(it->second);
+	}
+}
+
+cShaderProgram* cShaderManager::get(const std::string& name)
+{
+	std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.find(name);
+	if (it == mapNameToProgram.end() || !it->second.ready)
+		return &fallbackProgram;
+
+	return it->second.program;
+}
+
+bool cShaderManager::isReady(const std::string& name)
+{
+	std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.find(name);
+	return it != mapNameToProgram.end() && it->second.ready;
+}
+
+unsigned int cShaderManager::getNumPending()
+{
+	unsigned int numPending = 0;
+	for (std::map<std::string, sProgramEntry>::iterator it = mapNameToProgram.begin(); it != mapNameToProgram.end(); it++)
+	{
+		if (!it->second.ready)
+			numPending++;
+	}
+	return numPending;
+}
@@ -0,0 +1,55 @@
+#ifndef _HG_cShaderManager_
+#define _HG_cShaderManager_
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+#include "cShaderProgram.h"
+
+//Owns the named programs and compiles them in the background.
+//add() only submits the work, so a whole batch can be handed to the driver up front and the
+//time spent loading models and textures hides the compile. Until a program has linked, get()
+//hands out a plain fallback program instead, so nothing has to wait on the driver to draw.
+class cShaderManager
+{
+public:
+	cShaderManager(std::string path);
+	~cShaderManager();
+
+	//Starts compiling, onReady is called once it has linked (for samplers, uniform blocks, ...)
+	void add(std::string name, std::string vertFile, std::string fragFile,
+		const std::vector<std::string>& defines = std::vector<std::string>(),
+		std::function<void(cShaderProgram&)> onReady = std::function<void(cShaderProgram&)>());
+
+	//Finishes any programs the driver is done with, never waits on one that isn't.
+	//Without GL_KHR_parallel_shader_compile that can't be told, so this leaves them all for finishAll.
+	void update();
+	//Waits for everything still compiling
+	void finishAll();
+
+	//The named program once it's ready, the fallback before that (or if it was never added)
+	cShaderProgram* get(const std::string& name);
+	bool isReady(const std::string& name);
+	unsigned int getNumPending();
+
+	//Flat shaded, only needs a position at location 0 and model/view/projection
+	cShaderProgram fallbackProgram;
+
+private:
+	struct sProgramEntry
+	{
+		cShaderProgram* program;
+		std::function<void(cShaderProgram&)> onReady;
+		bool ready;
+	};
+	std::map<std::string, sProgramEntry> mapNameToProgram;
+	std::string path;
+
+	void finish(sProgramEntry& entry);
+};
+
+#endif
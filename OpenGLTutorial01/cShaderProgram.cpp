@@ -1,8 +1,38 @@
 #include "cShaderProgram.h"
 
-cShaderProgram::cShaderProgram()
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+std::string cShaderProgram::binaryCacheDirectory = "assets/shaders/cache/";
+
+//Written at the front of every cached binary
+struct sProgramBinaryHeader
 {
+	unsigned long long key;
+	unsigned int magic;
+	unsigned int format;
+	unsigned int length;
+};
+static const unsigned int PROGRAM_BINARY_MAGIC = 0x42505347;	//"GSPB"
+//Far beyond any real driver binary, guards against a corrupt header asking for gigabytes
+static const unsigned int MAX_PROGRAM_BINARY_LENGTH = 64 * 1024 * 1024;
 
+//Errors come back as "string:line", this says which file each string number is
+static void PrintSourceFiles(const cShader& shader)
+{
+	for (unsigned int index = 0; index < shader.sourceFiles.size(); index++)
+		std::cout << "  " << index << ": " << shader.path << shader.sourceFiles[index] << std::endl;
+}
+
+cShaderProgram::cShaderProgram()
+{
+	ID = -1;
+	loadedFromBinary = false;
+	materialSamplersSet = false;
+	pending = false;
+	pendingCacheKey = 0;
 }
 
 cShaderProgram::~cShaderProgram()
@@ -10,85 +40,538 @@ cShaderProgram::~cShaderProgram()
 
 }
 
-void cShaderProgram::compileProgram(std::string path, std::string vertFile, std::string fragFile)
+void cShaderProgram::compileProgram(std::string path, std::string vertFile, std::string fragFile, const std::vector<std::string>& defines)
+{
+	beginProgram(path, vertFile, fragFile, defines);
+	finishProgram();
+}
+
+void cShaderProgram::beginProgram(std::string path, std::string vertFile, std::string fragFile, const std::vector<std::string>& defines)
 {
+	//The defines end up in the sources, so each variant gets its own binary cache entry too
 	vertexShader.setPath(path);
-	vertexShader.readFile(vertFile);
+	vertexShader.readFile(vertFile, defines);
+	fragmentShader.setPath(path);
+	fragmentShader.readFile(fragFile, defines);
 
+	std::vector<const cShader*> shaders;
+	shaders.push_back(&vertexShader);
+	shaders.push_back(&fragmentShader);
+	pendingCacheKey = binaryCacheKey(shaders, std::vector<std::string>());
+
+	this->ID = glCreateProgram();
+	if (loadBinary(pendingCacheKey))
+	{
+		reflectUniforms();
+		pending = false;
+		return;
+	}
+
+	//Nothing here asks for a status, so the driver is free to carry on in the background
 	vertexShader.ID = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader.ID, vertexShader.numberOfLines, vertexShader.arraySource, NULL);
+	const char* vertexSource = vertexShader.source.c_str();
+	glShaderSource(vertexShader.ID, 1, &vertexSource, NULL);
 	glCompileShader(vertexShader.ID);
 
-	int success;
-	glGetShaderiv(vertexShader.ID, GL_COMPILE_STATUS, &success);
+	fragmentShader.ID = glCreateShader(GL_FRAGMENT_SHADER);
+	const char* fragmentSource = fragmentShader.source.c_str();
+	glShaderSource(fragmentShader.ID, 1, &fragmentSource, NULL);
+	glCompileShader(fragmentShader.ID);
 
+	glAttachShader(this->ID, vertexShader.ID);
+	glAttachShader(this->ID, fragmentShader.ID);
+	if (glProgramParameteri != NULL)
+		glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(this->ID);
+	pending = true;
+}
+
+bool cShaderProgram::hasParallelCompile()
+{
+	static int supported = -1;
+	if (supported < 0)
+	{
+		supported = 0;
+		int numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (int index = 0; index < numExtensions; index++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, index);
+			if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+				supported = 1;
+		}
+	}
+	return supported != 0;
+}
+
+bool cShaderProgram::isPending()
+{
+	return pending;
+}
+
+bool cShaderProgram::isReady()
+{
+	if (!pending || !hasParallelCompile())
+		return true;
+
+	int complete = 0;
+	glGetProgramiv(this->ID, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != 0;
+}
+
+void cShaderProgram::finishProgram()
+{
+	if (!pending)
+		return;
+	pending = false;
+
+	int success;
 	char infoLog[512];
+	glGetShaderiv(vertexShader.ID, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
 		glGetShaderInfoLog(vertexShader.ID, 512, NULL, infoLog);
 		std::cout << "Vertex Shader compilation failed:\n" << infoLog << std::endl;
+		PrintSourceFiles(vertexShader);
 	}
 
-	fragmentShader.setPath(path);
-	fragmentShader.readFile(fragFile);
-
-	fragmentShader.ID = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader.ID, fragmentShader.numberOfLines, fragmentShader.arraySource, NULL);
-	glCompileShader(fragmentShader.ID);
-
 	glGetShaderiv(fragmentShader.ID, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
 		glGetShaderInfoLog(fragmentShader.ID, 512, NULL, infoLog);
 		std::cout << "Fragment Shader compilation failed:\n" << infoLog << std::endl;
+		PrintSourceFiles(fragmentShader);
 	}
 
+	glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(this->ID, 512, NULL, infoLog);
+		std::cout << "Program link failed:\n" << infoLog << std::endl;
+	}
+
+	reflectUniforms();
+	saveBinary(pendingCacheKey);
+
+	glDeleteShader(vertexShader.ID);
+	glDeleteShader(fragmentShader.ID);
+}
+
+void cShaderProgram::compileFeedbackProgram(std::string path, std::string vertFile, std::vector<std::string> varyings)
+{
+	vertexShader.setPath(path);
+	vertexShader.readFile(vertFile);
+
+	//The captured varyings are part of the linked binary, so they are part of its key too
+	std::vector<const cShader*> shaders;
+	shaders.push_back(&vertexShader);
+	unsigned long long cacheKey = binaryCacheKey(shaders, varyings);
+
 	this->ID = glCreateProgram();
+	if (loadBinary(cacheKey))
+	{
+		reflectUniforms();
+		return;
+	}
+
+	vertexShader.ID = glCreateShader(GL_VERTEX_SHADER);
+	const char* vertexSource = vertexShader.source.c_str();
+	glShaderSource(vertexShader.ID, 1, &vertexSource, NULL);
+	glCompileShader(vertexShader.ID);
+
+	int success;
+	glGetShaderiv(vertexShader.ID, GL_COMPILE_STATUS, &success);
+
+	char infoLog[512];
+	if (!success)
+	{
+		glGetShaderInfoLog(vertexShader.ID, 512, NULL, infoLog);
+		std::cout << "Vertex Shader compilation failed:\n" << infoLog << std::endl;
+		PrintSourceFiles(vertexShader);
+	}
 
 	glAttachShader(this->ID, vertexShader.ID);
-	glAttachShader(this->ID, fragmentShader.ID);
+
+	//Varyings have to be named before linking
+	std::vector<const char*> names;
+	for (unsigned int index = 0; index < varyings.size(); index++)
+		names.push_back(varyings[index].c_str());
+	glTransformFeedbackVaryings(this->ID, (GLsizei)names.size(), &names[0], GL_INTERLEAVED_ATTRIBS);
+	if (glProgramParameteri != NULL)
+		glProgramParameteri(this->ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(this->ID);
 
+	glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(this->ID, 512, NULL, infoLog);
+		std::cout << "Feedback program link failed:\n" << infoLog << std::endl;
+	}
+	reflectUniforms();
+	saveBinary(cacheKey);
+
 	glDeleteShader(vertexShader.ID);
-	glDeleteShader(fragmentShader.ID);
 }
 
 void cShaderProgram::useProgram()
 {
-	glUseProgram(this->ID);
+	cGLState::useProgram(this->ID);
+}
+
+void cShaderProgram::bindUniformBlock(const char* blockName, unsigned int binding)
+{
+	unsigned int blockIndex = glGetUniformBlockIndex(this->ID, blockName);
+	if (blockIndex == GL_INVALID_INDEX)
+		return;
+
+	glUniformBlockBinding(this->ID, blockIndex, binding);
+}
+
+void HashShaderBytes(unsigned long long& hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t index = 0; index < size; index++)
+	{
+		hash ^= bytes[index];
+		hash *= 1099511628211ull;
+	}
+}
+
+static void HashString(unsigned long long& hash, const char* text)
+{
+	//The terminator goes in too, so "ab","c" and "a","bc" don't collide
+	if (text == NULL)
+		text = "";
+	HashShaderBytes(hash, text, strlen(text) + 1);
+}
+
+unsigned long long cShaderProgram::binaryCacheKey(const std::vector<const cShader*>& shaders, const std::vector<std::string>& extra)
+{
+	unsigned long long key = SHADER_HASH_SEED;
+	//A driver update can change what a binary means, so it invalidates the whole cache
+	HashString(key, (const char*)glGetString(GL_VENDOR));
+	HashString(key, (const char*)glGetString(GL_RENDERER));
+	HashString(key, (const char*)glGetString(GL_VERSION));
+
+	//Already worked out from the cached file hashes, no need to go over the text again
+	for (unsigned int index = 0; index < shaders.size(); index++)
+		HashShaderBytes(key, &shaders[index]->sourceHash, sizeof(shaders[index]->sourceHash));
+	for (unsigned int index = 0; index < extra.size(); index++)
+		HashString(key, extra[index].c_str());
+
+	return key;
+}
+
+std::string cShaderProgram::binaryCacheFile(unsigned long long key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", key);
+	return binaryCacheDirectory + name;
+}
+
+bool cShaderProgram::loadBinary(unsigned long long key)
+{
+	loadedFromBinary = false;
+	//Program binaries are core in 4.1, glad leaves these NULL on older contexts
+	if (binaryCacheDirectory.empty() || glProgramBinary == NULL)
+		return false;
+
+	std::ifstream file(binaryCacheFile(key).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	sProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC || header.key != key || header.length == 0)
+		return false;
+
+	//The header is only as trustworthy as the file, so check the length against what is
+	//actually left before allocating for it
+	std::streamoff headerEnd = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - headerEnd;
+	file.seekg(headerEnd);
+	if (remaining < 0 || (unsigned long long)header.length > (unsigned long long)remaining || header.length > MAX_PROGRAM_BINARY_LENGTH)
+		return false;
+
+	std::vector<char> binary(header.length);
+	if (!file.read(&binary[0], binary.size()))
+		return false;
+
+	glProgramBinary(this->ID, header.format, &binary[0], (GLsizei)binary.size());
+
+	//The driver is free to turn down its own binaries, e.g. after an update it didn't report
+	int success = 0;
+	glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(this->ID);
+		cGLState::forgetProgram(this->ID);
+		this->ID = glCreateProgram();
+		return false;
+	}
+
+	loadedFromBinary = true;
+	return true;
+}
+
+void cShaderProgram::saveBinary(unsigned long long key)
+{
+	if (binaryCacheDirectory.empty() || glGetProgramBinary == NULL)
+		return;
+
+	int success = 0;
+	int length = 0;
+	glGetProgramiv(this->ID, GL_LINK_STATUS, &success);
+	glGetProgramiv(this->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!success || length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(this->ID, length, &length, &format, &binary[0]);
+	if (length <= 0)
+		return;
+
+	sProgramBinaryHeader header;
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.key = key;
+	header.format = format;
+	header.length = (unsigned int)length;
+
+	std::ofstream file(binaryCacheFile(key).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return;
+	file.write((const char*)&header, sizeof(header));
+	file.write(&binary[0], length);
+}
+
+void cShaderProgram::reflectUniforms()
+{
+	vecUniforms.clear();
+	materialSamplersSet = false;
+
+	int numUniforms = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &numUniforms);
+	glGetProgramiv(this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	std::vector<char> nameBuffer(maxNameLength + 1);
+
+	for (int index = 0; index < numUniforms; index++)
+	{
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(this->ID, index, (GLsizei)nameBuffer.size(), NULL, &size, &type, &nameBuffer[0]);
+
+		sUniformInfo info;
+		info.name = &nameBuffer[0];
+		info.type = type;
+		info.location = glGetUniformLocation(this->ID, info.name.c_str());
+		//Uniforms living in a block have no location of their own
+		if (info.location < 0)
+			continue;
+
+		//Arrays come back as "name[0]", give every element (and the bare name) an entry
+		std::string::size_type bracket = info.name.rfind("[0]");
+		if (size > 1 || (bracket != std::string::npos && bracket + 3 == info.name.size()))
+		{
+			std::string baseName = info.name.substr(0, bracket);
+			sUniformInfo bare = info;
+			bare.name = baseName;
+			vecUniforms.push_back(bare);
+			for (int element = 0; element < size; element++)
+			{
+				sUniformInfo elementInfo = info;
+				elementInfo.name = baseName + "[" + std::to_string(element) + "]";
+				elementInfo.location = glGetUniformLocation(this->ID, elementInfo.name.c_str());
+				vecUniforms.push_back(elementInfo);
+			}
+			continue;
+		}
+
+		vecUniforms.push_back(info);
+	}
+
+	//At most half full, so lookups rarely probe more than a slot or two
+	unsigned int tableSize = 16;
+	while (tableSize < vecUniforms.size() * 2)
+		tableSize <<= 1;
+	uniformTable.assign(tableSize, -1);
+	for (unsigned int index = 0; index < vecUniforms.size(); index++)
+	{
+		unsigned int slot = UniformNameHash(vecUniforms[index].name.c_str()) & (tableSize - 1);
+		while (uniformTable[slot] >= 0)
+			slot = (slot + 1) & (tableSize - 1);
+		uniformTable[slot] = (int)index;
+	}
+}
+
+int cShaderProgram::getUniformLocation(const char* name) const
+{
+	return getUniformLocation(name, UniformNameHash(name));
+}
+
+int cShaderProgram::getUniformLocation(const char* name, unsigned int hash) const
+{
+	if (uniformTable.empty())
+		return -1;
+
+	unsigned int mask = (unsigned int)uniformTable.size() - 1;
+	for (unsigned int slot = hash & mask; uniformTable[slot] >= 0; slot = (slot + 1) & mask)
+	{
+		const sUniformInfo& info = vecUniforms[uniformTable[slot]];
+		if (strcmp(info.name.c_str(), name) == 0)
+			return info.location;
+	}
+	return -1;
+}
+
+void cShaderProgram::setBool(const char* name, bool value)
+{
+	glUniform1i(getUniformLocation(name), value);
+}
+
+void cShaderProgram::setInt(const char* name, int value)
+{
+	glUniform1i(getUniformLocation(name), value);
 }
 
-void cShaderProgram::setBool(std::string name, bool value)
+void cShaderProgram::setIVec2(const char* name, int x, int y)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform2i(getUniformLocation(name), x, y);
 }
 
-void cShaderProgram::setInt(std::string name, int value)
+void cShaderProgram::setFloat(const char* name, float value)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(getUniformLocation(name), value);
 }
 
-void cShaderProgram::setFloat(std::string name, float value)
+void cShaderProgram::setVec3(const char* name, const glm::vec3& value)
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform3f(getUniformLocation(name), value.x, value.y, value.z);
 }
 
-void cShaderProgram::setVec3(std::string name, glm::vec3 value)
+void cShaderProgram::setVec3(const char* name, float x, float y, float z)
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+	glUniform3f(getUniformLocation(name), x, y, z);
 }
 
-void cShaderProgram::setVec3(std::string name, float x, float y, float z)
+void cShaderProgram::setMat3(const char* name, const glm::mat3& value)
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void cShaderProgram::setMat4(std::string name, glm::mat4 value)
+void cShaderProgram::setMat4(const char* name, const glm::mat4& value)
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void cShaderProgram::setMat4(std::string name, int count, glm::mat4 value)
+void cShaderProgram::setMat4(const char* name, int count, const glm::mat4& value)
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), count, GL_FALSE, glm::value_ptr(value));
-}
\ No newline at end of file
+	glUniformMatrix4fv(getUniformLocation(name), count, GL_FALSE, glm::value_ptr(value));
+}
+
+void cShaderProgram::set(sUniform<bool> uniform, bool value)
+{
+	glUniform1i(uniform.location, value);
+}
+
+void cShaderProgram::set(sUniform<int> uniform, int value)
+{
+	glUniform1i(uniform.location, value);
+}
+
+void cShaderProgram::set(sUniform<float> uniform, float value)
+{
+	glUniform1f(uniform.location, value);
+}
+
+void cShaderProgram::set(sUniform<glm::vec3> uniform, const glm::vec3& value)
+{
+	glUniform3f(uniform.location, value.x, value.y, value.z);
+}
+
+void cShaderProgram::set(sUniform<glm::mat3> uniform, const glm::mat3& value)
+{
+	glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void cShaderProgram::set(sUniform<glm::mat4> uniform, const glm::mat4& value)
+{
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+cShaderPermutations::cShaderPermutations(std::string path, std::string vertFile, std::string fragFile)
+{
+	this->path = path;
+	this->vertFile = vertFile;
+	this->fragFile = fragFile;
+}
+
+cShaderPermutations::~cShaderPermutations()
+{
+	for (std::map<std::string, cShaderProgram*>::iterator it = mapKeyToProgram.begin(); it != mapKeyToProgram.end(); it++)
+	{
+		glDeleteProgram(it->second->ID);
+		cGLState::forgetProgram(it->second->ID);
+		delete it->second;
+	}
+}
+
+cShaderProgram* cShaderPermutations::findProgram(const std::vector<std::string>& defines)
+{
+	std::vector<std::string> sorted = defines;
+	std::sort(sorted.begin(), sorted.end());
+	std::string key;
+	for (unsigned int index = 0; index < sorted.size(); index++)
+		key += sorted[index] + "\n";
+
+	std::map<std::string, cShaderProgram*>::iterator it = mapKeyToProgram.find(key);
+	if (it != mapKeyToProgram.end())
+		return it->second;
+
+	cShaderProgram* program = new cShaderProgram();
+	program->beginProgram(path, vertFile, fragFile, sorted);
+	//Straight out of the binary cache, there is nothing left to wait for
+	if (!program->isPending() && onCompile)
+		onCompile(*program);
+	mapKeyToProgram[key] = program;
+
+	return program;
+}
+
+void cShaderPermutations::finishProgram(cShaderProgram* program)
+{
+	if (!program->isPending())
+		return;
+
+	program->finishProgram();
+	if (onCompile)
+		onCompile(*program);
+}
+
+cShaderProgram* cShaderPermutations::getProgram(const std::vector<std::string>& defines)
+{
+	cShaderProgram* program = findProgram(defines);
+	finishProgram(program);
+	return program;
+}
+
+void cShaderPermutations::prepare(const std::vector<std::string>& defines)
+{
+	findProgram(defines);
+}
+
+cShaderProgram* cShaderPermutations::getProgramIfReady(const std::vector<std::string>& defines)
+{
+	cShaderProgram* program = findProgram(defines);
+	if (!program->isReady())
+		return NULL;
+
+	finishProgram(program);
+	return program;
+}
+
+unsigned int cShaderPermutations::getNumPrograms()
+{
+	return (unsigned int)mapKeyToProgram.size();
+}
@@ -8,8 +8,21 @@
 
 #include <vector>
 #include <string>
+#include <map>
+#include <functional>
 #include <iostream>
 
+#include "cGLState.h"
+
+//From GL_KHR_parallel_shader_compile, which glad wasn't generated with
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+//64 bit FNV-1a, carrying on from whatever hash already holds
+const unsigned long long SHADER_HASH_SEED = 14695981039346656037ull;
+void HashShaderBytes(unsigned long long& hash, const void* data, size_t size);
+
 class cShader
 {
 public:
@@ -17,16 +30,60 @@ public:
 	~cShader();
 
 	void setPath(std::string);
-	bool readFile(std::string);
+	//Reads the file into source with every #include "file" (looked up in path) expanded in place.
+	//A file is only ever expanded once per shader, so includes need no guards.
+	//Defines are "NAME" or "NAME VALUE", written in just after the #version line.
+	bool readFile(std::string name, const std::vector<std::string>& defines = std::vector<std::string>());
 
 	int ID;
 	std::string path;
-	std::vector<std::string> shaderSource;
-	unsigned int numberOfLines;
-	char** arraySource;
+	//The whole expanded source as one buffer, ready for glShaderSource
+	std::string source;
+	//Each file's #line source string number is its index in here, to make sense of compile errors
+	std::vector<std::string> sourceFiles;
+	//Covers the defines and every file that went into source, built from the cached file hashes
+	unsigned long long sourceHash;
+
+	//Files are read and hashed once, then shared by every shader (and permutation) that uses them.
+	//Clear it to pick up edits on disk.
+	static void clearSourceCache();
 
 private:
-	void setArray();
+	struct sSourceFile
+	{
+		std::string text;
+		unsigned long long hash;
+	};
+	static std::map<std::string, sSourceFile> mapNameToSourceFile;
+	//NULL if the file can't be read
+	static const sSourceFile* loadSourceFile(const std::string& fileName);
+
+	//Defines only go into the top level file, includes pass NULL
+	bool appendFile(const std::string& name, const std::vector<std::string>* defines);
+};
+
+//FNV-1a over a uniform's name, what cShaderProgram's uniform table is keyed on.
+//constexpr so the names in cShaderUniforms.h are hashed by the compiler.
+constexpr unsigned int UniformNameHash(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	for (; *name; name++)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+//A uniform's location, looked up once with cShaderProgram::getUniform and then set every frame
+//without touching its name. The type picks the matching set overload, so a mismatch won't compile.
+//Only valid for the program it came from.
+template <typename T>
+struct sUniform
+{
+	sUniform() : location(-1) {}
+	explicit sUniform(int location) : location(location) {}
+	int location;
 };
 
 class cShaderProgram
@@ -35,19 +92,119 @@ public:
 	cShaderProgram();
 	~cShaderProgram();
 
-	void compileProgram(std::string path, std::string vertFile, std::string fragFile);
+	void compileProgram(std::string path, std::string vertFile, std::string fragFile, const std::vector<std::string>& defines = std::vector<std::string>());
+	//compileProgram in two halves. beginProgram hands the sources to the driver without asking
+	//how it went, finishProgram collects the logs and reflects the uniforms (waiting if it has to).
+	//Anything else can happen in between, which is how cShaderManager overlaps compiles with loading.
+	void beginProgram(std::string path, std::string vertFile, std::string fragFile, const std::vector<std::string>& defines = std::vector<std::string>());
+	void finishProgram();
+	//Begun but not finished
+	bool isPending();
+	//Whether finishProgram would return straight away. Without GL_KHR_parallel_shader_compile
+	//there's no way to ask, so this always says yes.
+	bool isReady();
+	static bool hasParallelCompile();
+	//Vertex shader only program whose outputs are captured with transform feedback,
+	//interleaved in the order the varyings are given
+	void compileFeedbackProgram(std::string path, std::string vertFile, std::vector<std::string> varyings);
 	void useProgram();
-	void setBool(std::string name, bool value);
-	void setInt(std::string name, int value);
-	void setFloat(std::string name, float value);
-	void setVec3(std::string name, glm::vec3 value);
-	void setVec3(std::string name, float x, float y, float z);
-	void setMat4(std::string name, glm::mat4 value);
-	void setMat4(std::string name, int count, glm::mat4 value);
+	//Points a named uniform block at a binding point, skipped if the program has no such block
+	void bindUniformBlock(const char* blockName, unsigned int binding);
+
+	//Every active uniform, read back from the program after it links.
+	//Array elements get an entry each ("lights[2]"), and the bare array name finds element 0.
+	struct sUniformInfo
+	{
+		std::string name;
+		int location;
+		GLenum type;
+	};
+	std::vector<sUniformInfo> vecUniforms;
+	//-1 for names the program doesn't use, which the GL quietly ignores when setting
+	int getUniformLocation(const char* name) const;
+	//Same, with the name's UniformNameHash already worked out
+	int getUniformLocation(const char* name, unsigned int hash) const;
+	template <typename T>
+	sUniform<T> getUniform(const char* name) const
+	{
+		return sUniform<T>(getUniformLocation(name));
+	}
+
+	//By name, looked up in the program's own table (no GL query, no string built)
+	void setBool(const char* name, bool value);
+	void setInt(const char* name, int value);
+	void setIVec2(const char* name, int x, int y);
+	void setFloat(const char* name, float value);
+	void setVec3(const char* name, const glm::vec3& value);
+	void setVec3(const char* name, float x, float y, float z);
+	void setMat3(const char* name, const glm::mat3& value);
+	void setMat4(const char* name, const glm::mat4& value);
+	void setMat4(const char* name, int count, const glm::mat4& value);
+
+	//By handle, for uniforms set often enough to keep one around
+	void set(sUniform<bool> uniform, bool value);
+	void set(sUniform<int> uniform, int value);
+	void set(sUniform<float> uniform, float value);
+	void set(sUniform<glm::vec3> uniform, const glm::vec3& value);
+	void set(sUniform<glm::mat3> uniform, const glm::mat3& value);
+	void set(sUniform<glm::mat4> uniform, const glm::mat4& value);
 
 	int ID;
 	cShader vertexShader;
 	cShader fragmentShader;
+
+	//Linked programs are saved here with glGetProgramBinary and loaded back on the next run
+	//instead of compiling, as long as the sources and driver haven't changed. Empty turns it off.
+	static std::string binaryCacheDirectory;
+	//Whether the last compile came out of the binary cache
+	bool loadedFromBinary;
+	//Set by cMaterial once the material samplers point at their units, cleared on every link
+	bool materialSamplersSet;
+
+private:
+	bool pending;
+	unsigned long long pendingCacheKey;
+
+	//Open addressed hash table over vecUniforms, -1 marks an empty slot
+	std::vector<int> uniformTable;
+	void reflectUniforms();
+
+	//Key covering the sources (and anything else given) plus the driver's vendor, renderer and version
+	unsigned long long binaryCacheKey(const std::vector<const cShader*>& shaders, const std::vector<std::string>& extra);
+	std::string binaryCacheFile(unsigned long long key);
+	//Replaces ID with the cached program, false (with a fresh, empty ID) if there isn't a usable one
+	bool loadBinary(unsigned long long key);
+	void saveBinary(unsigned long long key);
+};
+
+//Every #define variant of one vertex/fragment pair, compiled the first time it's asked for.
+//Lets a shader #ifdef away what a draw doesn't need (see vertShader.glsl) instead of branching
+//on a uniform for every vertex or pixel. Ask once and keep the pointer for per-draw use.
+class cShaderPermutations
+{
+public:
+	cShaderPermutations(std::string path, std::string vertFile, std::string fragFile);
+	~cShaderPermutations();
+
+	//The order of the defines doesn't matter, {"A", "B"} and {"B", "A"} are the same variant
+	cShaderProgram* getProgram(const std::vector<std::string>& defines);
+	//Starts a variant compiling without waiting for it, for ones that will be wanted soon
+	void prepare(const std::vector<std::string>& defines);
+	//NULL until the variant is ready, so a draw can use something else rather than stall on it
+	cShaderProgram* getProgramIfReady(const std::vector<std::string>& defines);
+	unsigned int getNumPrograms();
+
+	//Run on each variant right after it compiles, for samplers and uniform blocks that never change
+	std::function<void(cShaderProgram&)> onCompile;
+
+private:
+	std::string path, vertFile, fragFile;
+	//Keyed by the sorted defines, one per line
+	std::map<std::string, cShaderProgram*> mapKeyToProgram;
+
+	//Finds the variant, beginning its compile if it's new
+	cShaderProgram* findProgram(const std::vector<std::string>& defines);
+	void finishProgram(cShaderProgram* program);
 };
 
 #endif
\ No newline at end of file
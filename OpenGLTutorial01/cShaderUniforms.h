@@ -0,0 +1,801 @@
+//Generated by tools/generateUniforms.py from assets/shaders, don't edit by hand.
+//The project runs it before every build that can find Python, the rest build with the checked-in copy.
+#ifndef _HG_cShaderUniforms_
+#define _HG_cShaderUniforms_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "cShaderProgram.h"
+
+//One struct per program, bind() it to a linked program once and then set uniforms through it.
+//Setting goes straight to a location in an array, and a misspelt uniform doesn't compile.
+//Uniforms a permutation compiled out keep location -1, which the GL quietly ignores.
+
+//vertShader.glsl, fragShader.glsl
+struct sMainUniforms
+{
+	enum eUniform
+	{
+		MODEL,
+		VIEW,
+		PROJECTION,
+		CAMERA_POS,
+		SKYBOX,
+		OBJECT_COLOR,
+		LIGHT_COLOR,
+		LIGHT_POS,
+		MATERIAL_TEXTURE_DIFFUSE1,
+		MATERIAL_TEXTURE_DIFFUSE2,
+		MATERIAL_TEXTURE_DIFFUSE3,
+		MATERIAL_TEXTURE_DIFFUSE4,
+		MATERIAL_TEXTURE_DIFFUSE5,
+		MATERIAL_TEXTURE_SPECULAR1,
+		MATERIAL_TEXTURE_SPECULAR2,
+		MATERIAL_TEXTURE_SPECULAR3,
+		MATERIAL_TEXTURE_SPECULAR4,
+		MATERIAL_TEXTURE_SPECULAR5,
+		MATERIAL_SHININESS,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sMainUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"model",
+			"view",
+			"projection",
+			"cameraPos",
+			"skybox",
+			"objectColor",
+			"lightColor",
+			"lightPos",
+			"material.texture_diffuse1",
+			"material.texture_diffuse2",
+			"material.texture_diffuse3",
+			"material.texture_diffuse4",
+			"material.texture_diffuse5",
+			"material.texture_specular1",
+			"material.texture_specular2",
+			"material.texture_specular3",
+			"material.texture_specular4",
+			"material.texture_specular5",
+			"material.shininess",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("model"),
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+			UniformNameHash("cameraPos"),
+			UniformNameHash("skybox"),
+			UniformNameHash("objectColor"),
+			UniformNameHash("lightColor"),
+			UniformNameHash("lightPos"),
+			UniformNameHash("material.texture_diffuse1"),
+			UniformNameHash("material.texture_diffuse2"),
+			UniformNameHash("material.texture_diffuse3"),
+			UniformNameHash("material.texture_diffuse4"),
+			UniformNameHash("material.texture_diffuse5"),
+			UniformNameHash("material.texture_specular1"),
+			UniformNameHash("material.texture_specular2"),
+			UniformNameHash("material.texture_specular3"),
+			UniformNameHash("material.texture_specular4"),
+			UniformNameHash("material.texture_specular5"),
+			UniformNameHash("material.shininess"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setModel(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[MODEL], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setCameraPos(const glm::vec3& value) const
+	{
+		glUniform3fv(locations[CAMERA_POS], 1, glm::value_ptr(value));
+	}
+
+	void setSkybox(int value) const
+	{
+		glUniform1i(locations[SKYBOX], value);
+	}
+
+	void setObjectColor(const glm::vec3& value) const
+	{
+		glUniform3fv(locations[OBJECT_COLOR], 1, glm::value_ptr(value));
+	}
+
+	void setLightColor(const glm::vec3& value) const
+	{
+		glUniform3fv(locations[LIGHT_COLOR], 1, glm::value_ptr(value));
+	}
+
+	void setLightPos(const glm::vec3& value) const
+	{
+		glUniform3fv(locations[LIGHT_POS], 1, glm::value_ptr(value));
+	}
+
+	void setMaterialTextureDiffuse1(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_DIFFUSE1], value);
+	}
+
+	void setMaterialTextureDiffuse2(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_DIFFUSE2], value);
+	}
+
+	void setMaterialTextureDiffuse3(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_DIFFUSE3], value);
+	}
+
+	void setMaterialTextureDiffuse4(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_DIFFUSE4], value);
+	}
+
+	void setMaterialTextureDiffuse5(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_DIFFUSE5], value);
+	}
+
+	void setMaterialTextureSpecular1(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_SPECULAR1], value);
+	}
+
+	void setMaterialTextureSpecular2(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_SPECULAR2], value);
+	}
+
+	void setMaterialTextureSpecular3(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_SPECULAR3], value);
+	}
+
+	void setMaterialTextureSpecular4(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_SPECULAR4], value);
+	}
+
+	void setMaterialTextureSpecular5(int value) const
+	{
+		glUniform1i(locations[MATERIAL_TEXTURE_SPECULAR5], value);
+	}
+
+	void setMaterialShininess(float value) const
+	{
+		glUniform1f(locations[MATERIAL_SHININESS], value);
+	}
+};
+
+//animVert.glsl, animFrag.glsl
+struct sSkinUniforms
+{
+	enum eUniform
+	{
+		MODEL,
+		NORMAL_MATRIX,
+		VIEW,
+		PROJECTION,
+		BONE_PALETTE,
+		PALETTE_OFFSET,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sSkinUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"model",
+			"normalMatrix",
+			"view",
+			"projection",
+			"bonePalette",
+			"paletteOffset",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("model"),
+			UniformNameHash("normalMatrix"),
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+			UniformNameHash("bonePalette"),
+			UniformNameHash("paletteOffset"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setModel(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[MODEL], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setNormalMatrix(const glm::mat3& value) const
+	{
+		glUniformMatrix3fv(locations[NORMAL_MATRIX], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setBonePalette(int value) const
+	{
+		glUniform1i(locations[BONE_PALETTE], value);
+	}
+
+	void setPaletteOffset(int value) const
+	{
+		glUniform1i(locations[PALETTE_OFFSET], value);
+	}
+};
+
+//animInstancedVert.glsl, animFrag.glsl
+struct sInstancedSkinUniforms
+{
+	enum eUniform
+	{
+		VIEW,
+		PROJECTION,
+		BAKED_BONES,
+		NUM_FRAMES,
+		FRAMES_PER_SECOND,
+		LOOPING,
+		TIME,
+		MESH_BONE_OFFSET,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sInstancedSkinUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"view",
+			"projection",
+			"bakedBones",
+			"numFrames",
+			"framesPerSecond",
+			"looping",
+			"time",
+			"meshBoneOffset",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+			UniformNameHash("bakedBones"),
+			UniformNameHash("numFrames"),
+			UniformNameHash("framesPerSecond"),
+			UniformNameHash("looping"),
+			UniformNameHash("time"),
+			UniformNameHash("meshBoneOffset"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setBakedBones(int value) const
+	{
+		glUniform1i(locations[BAKED_BONES], value);
+	}
+
+	void setNumFrames(int value) const
+	{
+		glUniform1i(locations[NUM_FRAMES], value);
+	}
+
+	void setFramesPerSecond(float value) const
+	{
+		glUniform1f(locations[FRAMES_PER_SECOND], value);
+	}
+
+	void setLooping(int value) const
+	{
+		glUniform1i(locations[LOOPING], value);
+	}
+
+	void setTime(float value) const
+	{
+		glUniform1f(locations[TIME], value);
+	}
+
+	void setMeshBoneOffset(int value) const
+	{
+		glUniform1i(locations[MESH_BONE_OFFSET], value);
+	}
+};
+
+//animSampledVert.glsl, animFrag.glsl
+struct sSampledSkinUniforms
+{
+	enum eUniform
+	{
+		VIEW,
+		PROJECTION,
+		SAMPLED_PALETTE,
+		NUM_BONES,
+		MESH_BONE_OFFSET,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sSampledSkinUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"view",
+			"projection",
+			"sampledPalette",
+			"numBones",
+			"meshBoneOffset",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+			UniformNameHash("sampledPalette"),
+			UniformNameHash("numBones"),
+			UniformNameHash("meshBoneOffset"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setSampledPalette(int value) const
+	{
+		glUniform1i(locations[SAMPLED_PALETTE], value);
+	}
+
+	void setNumBones(int value) const
+	{
+		glUniform1i(locations[NUM_BONES], value);
+	}
+
+	void setMeshBoneOffset(int value) const
+	{
+		glUniform1i(locations[MESH_BONE_OFFSET], value);
+	}
+};
+
+//skinVert.glsl
+struct sSkinFeedbackUniforms
+{
+	enum eUniform
+	{
+		BONE_PALETTE,
+		PALETTE_OFFSET,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sSkinFeedbackUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"bonePalette",
+			"paletteOffset",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("bonePalette"),
+			UniformNameHash("paletteOffset"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setBonePalette(int value) const
+	{
+		glUniform1i(locations[BONE_PALETTE], value);
+	}
+
+	void setPaletteOffset(int value) const
+	{
+		glUniform1i(locations[PALETTE_OFFSET], value);
+	}
+};
+
+//clipSampleVert.glsl
+struct sClipSampleUniforms
+{
+	enum eUniform
+	{
+		CLIP_SKELETON,
+		CLIP_ROTATIONS,
+		CLIP_TRANSLATIONS,
+		CLIP_FRAMES,
+		FRAMES_PER_SECOND,
+		TIME,
+		GLOBAL_INVERSE,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sClipSampleUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"clipSkeleton",
+			"clipRotations",
+			"clipTranslations",
+			"clipFrames",
+			"framesPerSecond",
+			"time",
+			"globalInverse",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("clipSkeleton"),
+			UniformNameHash("clipRotations"),
+			UniformNameHash("clipTranslations"),
+			UniformNameHash("clipFrames"),
+			UniformNameHash("framesPerSecond"),
+			UniformNameHash("time"),
+			UniformNameHash("globalInverse"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setClipSkeleton(int value) const
+	{
+		glUniform1i(locations[CLIP_SKELETON], value);
+	}
+
+	void setClipRotations(int value) const
+	{
+		glUniform1i(locations[CLIP_ROTATIONS], value);
+	}
+
+	void setClipTranslations(int value) const
+	{
+		glUniform1i(locations[CLIP_TRANSLATIONS], value);
+	}
+
+	void setClipFrames(const glm::ivec2* values, int count) const
+	{
+		glUniform2iv(locations[CLIP_FRAMES], count, &values[0].x);
+	}
+
+	void setFramesPerSecond(float value) const
+	{
+		glUniform1f(locations[FRAMES_PER_SECOND], value);
+	}
+
+	void setTime(float value) const
+	{
+		glUniform1f(locations[TIME], value);
+	}
+
+	void setGlobalInverse(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[GLOBAL_INVERSE], 1, GL_FALSE, glm::value_ptr(value));
+	}
+};
+
+//skyBoxVert.glsl, skyBoxFrag.glsl
+struct sSkyboxUniforms
+{
+	enum eUniform
+	{
+		PROJECTION,
+		VIEW,
+		SKYBOX,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sSkyboxUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"projection",
+			"view",
+			"skybox",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("projection"),
+			UniformNameHash("view"),
+			UniformNameHash("skybox"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setSkybox(int value) const
+	{
+		glUniform1i(locations[SKYBOX], value);
+	}
+};
+
+//modelVert.glsl, modelFrag.glsl
+struct sSimpleUniforms
+{
+	enum eUniform
+	{
+		MODEL,
+		VIEW,
+		PROJECTION,
+		TEXTURE_DIFFUSE1,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sSimpleUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"model",
+			"view",
+			"projection",
+			"texture_diffuse1",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("model"),
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+			UniformNameHash("texture_diffuse1"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setModel(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[MODEL], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setTextureDiffuse1(int value) const
+	{
+		glUniform1i(locations[TEXTURE_DIFFUSE1], value);
+	}
+};
+
+//quadVert.glsl, quadFrag.glsl
+struct sQuadUniforms
+{
+	enum eUniform
+	{
+		SCREEN_TEXTURE,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sQuadUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"screenTexture",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("screenTexture"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setScreenTexture(int value) const
+	{
+		glUniform1i(locations[SCREEN_TEXTURE], value);
+	}
+};
+
+//lampVert.glsl, lampFrag.glsl
+struct sLampUniforms
+{
+	enum eUniform
+	{
+		MODEL,
+		VIEW,
+		PROJECTION,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sLampUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"model",
+			"view",
+			"projection",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("model"),
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setModel(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[MODEL], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+};
+
+//fallbackVert.glsl, fallbackFrag.glsl
+struct sFallbackUniforms
+{
+	enum eUniform
+	{
+		MODEL,
+		VIEW,
+		PROJECTION,
+		NUM_UNIFORMS
+	};
+
+	int locations[NUM_UNIFORMS];
+
+	sFallbackUniforms()
+	{
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = -1;
+	}
+
+	void bind(const cShaderProgram& program)
+	{
+		static const char* const names[NUM_UNIFORMS] = {
+			"model",
+			"view",
+			"projection",
+		};
+		static constexpr unsigned int hashes[NUM_UNIFORMS] = {
+			UniformNameHash("model"),
+			UniformNameHash("view"),
+			UniformNameHash("projection"),
+		};
+		for (int index = 0; index < NUM_UNIFORMS; index++)
+			locations[index] = program.getUniformLocation(names[index], hashes[index]);
+	}
+
+	void setModel(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[MODEL], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setView(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[VIEW], 1, GL_FALSE, glm::value_ptr(value));
+	}
+
+	void setProjection(const glm::mat4& value) const
+	{
+		glUniformMatrix4fv(locations[PROJECTION], 1, GL_FALSE, glm::value_ptr(value));
+	}
+};
+
+#endif
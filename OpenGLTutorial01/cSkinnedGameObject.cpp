@@ -6,45 +6,19 @@
 
 cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir)
 {
-	this->Model = new cSkinnedMesh(modelDir.c_str());
-
-	this->Position = glm::vec3(0.0f);
-	this->Scale = glm::vec3(1.0f);
+	this->Init(new cSkinnedMesh(modelDir.c_str()), glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(0.0f));
 	this->OrientationQuat = glm::quat(0.0f, 0.0f, 0.0f, 1.0f);
-	this->OrientationEuler = glm::vec3(0.0f);
-
-	this->defaultAnimState = new cAnimationState();
-	this->defaultAnimState->defaultAnimation.name = modelDir;
 	this->defaultAnimState->defaultAnimation.frameStepTime = 0.005f;
-	this->defaultAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
 }
 cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler)
 {
-	this->Model = new cSkinnedMesh(modelDir.c_str());
-
-	this->Position = position;
-	this->Scale = scale;
-	this->OrientationQuat = glm::quat(orientationEuler);
-	this->OrientationEuler = orientationEuler;
-
-	this->defaultAnimState = new cAnimationState();
-	this->defaultAnimState->defaultAnimation.name = modelDir;
+	this->Init(new cSkinnedMesh(modelDir.c_str()), position, scale, orientationEuler);
 	this->defaultAnimState->defaultAnimation.frameStepTime = 0.005f;
-	this->defaultAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
 }
 cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, std::vector<std::string> charAnimations)
 {
-	this->Model = new cSkinnedMesh(modelDir.c_str());
-
-	this->Position = position;
-	this->Scale = scale;
-	this->OrientationQuat = glm::quat(orientationEuler);
-	this->OrientationEuler = orientationEuler;
-
-	this->defaultAnimState = new cAnimationState();
-	this->defaultAnimState->defaultAnimation.name = modelDir;
+	this->Init(new cSkinnedMesh(modelDir.c_str()), position, scale, orientationEuler);
 	this->defaultAnimState->defaultAnimation.frameStepTime = 0.005f;
-	this->defaultAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
 
 	this->vecCharacterAnimations = charAnimations;
 
@@ -54,44 +28,66 @@ cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelD
 	}
 
 	this->animToPlay = this->defaultAnimState->defaultAnimation.name;
-	this->TurnSpeed = 50.0f;
 	this->CurrentSpeed = 1.0f;
-
 }
 cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, std::map<int, std::string> mapAnimations)
+	: cSkinnedGameObject(new cSkinnedMesh(modelDir.c_str()), position, scale, orientationEuler, 1.0f, mapAnimations)
 {
-	this->Model = new cSkinnedMesh(modelDir.c_str());
-
-	this->Position = position;
-	this->Scale = scale;
-	this->OrientationQuat = glm::quat(orientationEuler);
-	this->OrientationEuler = orientationEuler;
-
-	this->defaultAnimState = new cAnimationState();
-	this->defaultAnimState->defaultAnimation.name = modelDir;
+}
+cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, float speed, std::map<int, std::string> mapAnimations)
+	: cSkinnedGameObject(new cSkinnedMesh(modelDir.c_str()), position, scale, orientationEuler, speed, mapAnimations)
+{
+}
+cSkinnedGameObject::cSkinnedGameObject(cSkinnedMesh* model, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, float speed, std::map<int, std::string> mapAnimations)
+{
+	this->Init(model, position, scale, orientationEuler);
 	this->defaultAnimState->defaultAnimation.frameStepTime = 0.05f;
-	this->defaultAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
 
 	this->curAnimState = new cAnimationState();
-	this->curAnimState->defaultAnimation.name = modelDir;
+	this->curAnimState->defaultAnimation.name = model->Filename;
 	this->curAnimState->defaultAnimation.frameStepTime = 0.05f;
 	this->curAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
 
 	this->mapCharacterAnimations = mapAnimations;
 
+	//Already loaded clips are skipped, so every character sharing the model can ask for its own
 	std::map<int, std::string>::iterator mapIter = this->mapCharacterAnimations.begin();
-	for (mapIter; mapIter != this->mapCharacterAnimations.end(); mapIter++)
+	for (; mapIter != this->mapCharacterAnimations.end(); mapIter++)
 	{
 		this->Model->LoadMeshAnimation(mapIter->second);
 	}
-	this->TurnSpeed = 50.0f;
-	this->Speed = 1.0f;
-	this->animToPlay = this->defaultAnimState->defaultAnimation.name;
 
+	this->animToPlay = this->defaultAnimState->defaultAnimation.name;
+	this->Speed = speed;
 }
-cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, float speed, std::map<int, std::string> mapAnimations)
+//Everything the constructors have in common
+void cSkinnedGameObject::Init(cSkinnedMesh* model, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler)
 {
-	this->Model = new cSkinnedMesh(modelDir.c_str());
+	this->Model = model;
+	this->PoseCache = NULL;
+	this->CurrentPose = NULL;
+	this->PosePool = NULL;
+	this->CrossFadeTime = 0.25f;
+	this->LastAnimationTime = 0.0f;
+	this->LastClip = -1;
+	this->FadeFromTime = 0.0f;
+	this->FadeElapsed = 0.0f;
+	this->Visible = true;
+	this->HasBounds = false;
+	this->AnimationLOD = 0;
+	this->AnimationLODSizes[0] = 0.1f;
+	this->AnimationLODSizes[1] = 0.03f;
+	this->UpdateCount = 0;
+	this->Crowd = NULL;
+	this->CrowdAgent = -1;
+	this->Scene = NULL;
+	this->SceneNode = -1;
+	this->curAnimState = NULL;
+
+	this->Speed = 1.0f;
+	this->TurnSpeed = 50.0f;
+	this->CurrentSpeed = 0.0f;
+	this->CurrentTurnSpeed = 0.0f;
 
 	this->Position = position;
 	this->Scale = scale;
@@ -99,47 +95,57 @@ cSkinnedGameObject::cSkinnedGameObject(std::string modelName, std::string modelD
 	this->OrientationEuler = orientationEuler;
 
 	this->defaultAnimState = new cAnimationState();
-	this->defaultAnimState->defaultAnimation.name = modelDir;
-	this->defaultAnimState->defaultAnimation.frameStepTime = 0.05f;
+	this->defaultAnimState->defaultAnimation.name = model->Filename;
 	this->defaultAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
+}
+void cSkinnedGameObject::JoinCrowd(cCrowdSimulation* crowd)
+{
+	this->Crowd = crowd;
+	this->CrowdAgent = crowd->addAgent(this->Position, this->OrientationEuler.y, 0.0f, 0.0f);
+}
 
-	this->curAnimState = new cAnimationState();
-	this->curAnimState->defaultAnimation.name = modelDir;
-	this->curAnimState->defaultAnimation.frameStepTime = 0.05f;
-	this->curAnimState->defaultAnimation.totalTime = this->Model->GetDuration();
-
-	this->mapCharacterAnimations = mapAnimations;
+void cSkinnedGameObject::JoinScene(cScene* scene, int parent)
+{
+	this->Scene = scene;
+	this->SceneNode = scene->addNode(this->Position, this->GetOrientation(), this->Scale, parent);
+}
 
-	std::map<int, std::string>::iterator mapIter = this->mapCharacterAnimations.begin();
-	for (mapIter; mapIter != this->mapCharacterAnimations.end(); mapIter++)
+void cSkinnedGameObject::Move(float deltaTime)
+{
+	if (this->Crowd)
 	{
-		this->Model->LoadMeshAnimation(mapIter->second);
+		//The crowd's step does the moving, we hand it our speeds and pick up where it put us
+		this->Crowd->setVelocity(this->CrowdAgent, this->CurrentSpeed, this->CurrentTurnSpeed);
+		this->Position = this->Crowd->getPosition(this->CrowdAgent);
+		this->OrientationEuler.y = this->Crowd->getHeading(this->CrowdAgent);
+	}
+	else
+	{
+		this->OrientationEuler.y += deltaTime * CurrentTurnSpeed;
+		float distance = this->CurrentSpeed * deltaTime;
+		float dx = distance * glm::sin(glm::radians(this->OrientationEuler.y));
+		float dz = distance * glm::cos(glm::radians(this->OrientationEuler.y));
+		this->Position += glm::vec3(dx, 0.0f, dz);
 	}
 
-	this->animToPlay = this->defaultAnimState->defaultAnimation.name;
-
-	this->TurnSpeed = 50.0f;
-	this->Speed = speed;
-}
-void cSkinnedGameObject::Move(float deltaTime)
-{
-	this->OrientationEuler.y += deltaTime * CurrentTurnSpeed;
-	float distance = this->CurrentSpeed * deltaTime;
-	float dx = distance * glm::sin(glm::radians(this->OrientationEuler.y));
-	float dz = distance * glm::cos(glm::radians(this->OrientationEuler.y));
-	this->Position += glm::vec3(dx, 0.0f, dz);
+	//Standing still leaves the node alone, so its matrix isn't rebuilt
+	if (this->Scene)
+	{
+		this->Scene->setTranslation(this->SceneNode, this->Position);
+		this->Scene->setRotation(this->SceneNode, this->GetOrientation());
+		this->Scene->setScale(this->SceneNode, this->Scale);
+	}
 }
 
-void cSkinnedGameObject::Draw(cShaderProgram Shader)
+void cSkinnedGameObject::Update(cBonePalette* palette, const cFrustum* frustum, glm::vec3 cameraPosition)
 {
 	//std::string animToPlay = "";
 	float curFrameTime = 0.0f;
-
+	cAnimationState::sStateDetails* activeAnimation;
 
 	if (this->defaultAnimState->defaultAnimation.name == this->animToPlay)
 	{
-		this->defaultAnimState->defaultAnimation.IncrementTime();
-		curFrameTime = this->defaultAnimState->defaultAnimation.currentTime;
+		activeAnimation = &this->defaultAnimState->defaultAnimation;
 	}
 	else
 	{
@@ -149,23 +155,226 @@ void cSkinnedGameObject::Draw(cShaderProgram Shader)
 		this->curAnimState->defaultAnimation.totalTime = this->Model->MapAnimationNameToScene[this->animToPlay]->mAnimations[0]->mDuration / 
 		this->Model->MapAnimationNameToScene[this->animToPlay]->mAnimations[0]->mTicksPerSecond;
 		this->curAnimState->defaultAnimation.name = this->animToPlay;
-		this->curAnimState->defaultAnimation.IncrementTime();
-		curFrameTime = this->curAnimState->defaultAnimation.currentTime;
+		activeAnimation = &this->curAnimState->defaultAnimation;
+	}
+	activeAnimation->IncrementTime();
+	curFrameTime = activeAnimation->currentTime;
+
+	//Clocks always move, even when nothing below gets evaluated
+	bool blending = this->AdvanceBlend(curFrameTime, activeAnimation->frameStepTime);
+	bool fromPoseCache = !blending && this->PoseCache;
+	this->UpdateCount++;
+
+	//Decide from last frame's bounds whether the pose is worth evaluating
+	bool evaluate = true;
+	this->Visible = true;
+	this->AnimationLOD = 0;
+	if (frustum && this->HasBounds)
+	{
+		glm::vec3 worldMin, worldMax;
+		TransformAABB(this->GetModelMatrix(), this->BoundsMin, this->BoundsMax, worldMin, worldMax);
+		this->Visible = frustum->intersectsAABB(worldMin, worldMax);
+
+		if (!this->Visible)
+		{
+			//Refresh now and then in case the animation swings us back into view
+			evaluate = this->UpdateCount % CULLED_REFRESH_FRAMES == 0;
+		}
+		else
+		{
+			//How big we are on screen, roughly
+			float radius = glm::length(worldMax - worldMin) * 0.5f;
+			float distance = glm::max(glm::length((worldMin + worldMax) * 0.5f - cameraPosition), 0.001f);
+			float size = radius / distance;
+			this->AnimationLOD = size >= this->AnimationLODSizes[0] ? 0 : (size >= this->AnimationLODSizes[1] ? 1 : 2);
+
+			//Lower LODs reuse our last pose for a frame or three. Pose cache entries are shared
+			//and cheap to look up again, so only poses we own are held.
+			unsigned int interval = 1 << this->AnimationLOD;
+			bool ownPose = this->CurrentPose == &this->vecFinalTransformation && !this->vecFinalTransformation.empty();
+			evaluate = fromPoseCache || !ownPose || this->UpdateCount % interval == 0;
+		}
+	}
+
+	if (!evaluate)
+	{
+		if (this->Visible)
+			this->AllocatePalettes(palette, &this->vecFinalTransformation[0], this->vecMeshPaletteOffsets);
+		else
+			this->vecMeshPaletteOffsets.assign(this->Model->GetMeshes().size(), -1);
+		return;
+	}
+
+	cPoseCache::sPose* pose = NULL;
+	if (blending)
+	{
+		//Blended poses are one of a kind, they skip the pose cache
+		this->EvaluateBlend(curFrameTime);
+		this->CurrentPose = &this->vecFinalTransformation;
+	}
+	else if (this->PoseCache)
+	{
+		//Lock our clock onto the cache's phase once, so we keep landing on the same entries as everyone else
+		//curAnimState is reused for every clip, so it is the clip's name that says whether we snapped
+		if (this->PoseCache->snapPhase && this->SnappedAnimation != this->animToPlay)
+		{
+			activeAnimation->currentTime = this->PoseCache->snapTime(curFrameTime);
+			curFrameTime = activeAnimation->currentTime;
+			this->SnappedAnimation = this->animToPlay;
+		}
+
+		pose = this->PoseCache->getPose(this->Model, this->LastClip, curFrameTime);
+		this->vecBoneTransformation = pose->globals;
+		this->CurrentPose = &pose->finalTransformation;
+	}
+	else
+	{
+		this->Model->BoneTransform(curFrameTime, animToPlay, this->vecFinalTransformation, this->vecBoneTransformation, this->vecOffsets);
+		this->CurrentPose = &this->vecFinalTransformation;
 	}
 
-	std::vector<glm::mat4> vecFinalTransformation;
-	std::vector<glm::mat4> vecOffsets;
+	//Tight box around this pose for next frame's culling
+	this->HasBounds = this->Model->ComputeBounds(&(*this->CurrentPose)[0], this->BoundsMin, this->BoundsMax);
+	if (frustum && this->HasBounds && !this->Visible)
+	{
+		glm::vec3 worldMin, worldMax;
+		TransformAABB(this->GetModelMatrix(), this->BoundsMin, this->BoundsMax, worldMin, worldMax);
+		this->Visible = frustum->intersectsAABB(worldMin, worldMax);
+	}
 
-	this->Model->BoneTransform(curFrameTime, animToPlay, vecFinalTransformation, this->vecBoneTransformation, vecOffsets);
-	
-	GLuint numBonesUsed = static_cast<GLuint>(vecFinalTransformation.size());
-	glUseProgram(Shader.ID);
-	Shader.setInt("numBonesUsed", numBonesUsed);
-	glm::mat4* boneMatrixArray = &(vecFinalTransformation[0]);
-	//glUniformMatrix4fv(glGetUniformLocation(Shader.ID, "Bones"), numBonesUsed, GL_FALSE, (const GLfloat*) glm::value_ptr(*boneMatrixArray));
-	Shader.setMat4("bones", numBonesUsed, *boneMatrixArray);
-	//Shader.setMat4("bones", numBonesUsed, vecFinalTransformation[0]);
+	if (!this->Visible)
+	{
+		this->vecMeshPaletteOffsets.assign(this->Model->GetMeshes().size(), -1);
+	}
+	else if (pose)
+	{
+		//Characters sharing a pose share its slices of the palette as well
+		if (pose->paletteOffsets.empty())
+		{
+			this->AllocatePalettes(palette, &pose->finalTransformation[0], pose->paletteOffsets);
+		}
+		this->vecMeshPaletteOffsets = pose->paletteOffsets;
+	}
+	else
+	{
+		this->AllocatePalettes(palette, &this->vecFinalTransformation[0], this->vecMeshPaletteOffsets);
+	}
+}
+
+void cSkinnedGameObject::AddAnimationLayer(std::string animationName, float weight)
+{
+	sAnimationLayer layer;
+	layer.animationName = animationName;
+	layer.weight = weight;
+	this->vecAnimationLayers.push_back(layer);
+}
 
+bool cSkinnedGameObject::AdvanceBlend(float curFrameTime, float frameStepTime)
+{
+	//A new animToPlay starts a fade out of whatever was playing
+	if (this->animToPlay != this->LastAnimation)
+	{
+		if (!this->LastAnimation.empty() && this->CrossFadeTime > 0.0f)
+		{
+			this->FadeFromAnimation = this->LastAnimation;
+			this->FadeFromTime = this->LastAnimationTime;
+			this->FadeElapsed = 0.0f;
+		}
+		this->LastAnimation = this->animToPlay;
+		this->LastClip = this->Model->FindClip(this->animToPlay);
+	}
+	this->LastAnimationTime = curFrameTime;
+
+	if (!this->FadeFromAnimation.empty())
+	{
+		this->FadeElapsed += frameStepTime;
+		this->FadeFromTime += frameStepTime;
+		if (this->FadeElapsed >= this->CrossFadeTime)
+			this->FadeFromAnimation.clear();
+	}
+
+	for (unsigned int index = 0; index < this->vecAnimationLayers.size(); index++)
+	{
+		sAnimationLayer& layer = this->vecAnimationLayers[index];
+		layer.currentTime += frameStepTime;
+		if (layer.currentTime >= this->Model->GetClipDuration(layer.animationName))
+			layer.currentTime = 0.0f;
+	}
+
+	return !this->FadeFromAnimation.empty() || !this->vecAnimationLayers.empty();
+}
+
+void cSkinnedGameObject::EvaluateBlend(float curFrameTime)
+{
+	const unsigned int MAX_BLEND_CLIPS = 8;
+	sBlendClip clips[MAX_BLEND_CLIPS];
+	unsigned int numClips = 0;
+
+	clips[numClips].clip = this->LastClip;
+	clips[numClips].time = curFrameTime;
+	clips[numClips].weight = 1.0f;
+	numClips++;
+
+	if (!this->FadeFromAnimation.empty())
+	{
+		float fade = glm::clamp(this->FadeElapsed / this->CrossFadeTime, 0.0f, 1.0f);
+
+		clips[0].weight = fade;
+		clips[numClips].clip = this->Model->FindClip(this->FadeFromAnimation);
+		clips[numClips].time = this->FadeFromTime;
+		clips[numClips].weight = 1.0f - fade;
+		numClips++;
+	}
+
+	//Each layer scales down everything under it by (1 - weight)
+	for (unsigned int index = 0; index < this->vecAnimationLayers.size() && numClips < MAX_BLEND_CLIPS; index++)
+	{
+		sAnimationLayer& layer = this->vecAnimationLayers[index];
+		if (layer.clip < 0)
+			layer.clip = this->Model->FindClip(layer.animationName);
+
+		float weight = glm::clamp(layer.weight, 0.0f, 1.0f);
+		for (unsigned int clip = 0; clip < numClips; clip++)
+			clips[clip].weight *= 1.0f - weight;
+
+		clips[numClips].clip = layer.clip;
+		clips[numClips].time = layer.currentTime;
+		clips[numClips].weight = weight;
+		numClips++;
+	}
+
+	cPosePool* pool = this->PosePool;
+	if (pool == NULL)
+	{
+		pool = &this->OwnPosePool;
+		pool->beginFrame();
+	}
+	this->Model->BlendTransform(clips, numClips, *pool, this->vecFinalTransformation, this->vecBoneTransformation);
+}
+
+void cSkinnedGameObject::AllocatePalettes(cBonePalette* palette, const glm::mat4* bones, std::vector<int>& offsets)
+{
+	//Each sub-mesh only uploads the bones it actually references
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	offsets.resize(meshes.size());
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		offsets[index] = palette ? palette->allocate(bones, meshes[index].boneRemap) : -1;
+	}
+}
+
+glm::quat cSkinnedGameObject::GetOrientation()
+{
+	//The same x, then y, then z order GetModelMatrix rotates in
+	return glm::angleAxis(glm::radians(this->OrientationEuler.x), glm::vec3(1.0f, 0.0f, 0.0f))
+		* glm::angleAxis(glm::radians(this->OrientationEuler.y), glm::vec3(0.0f, 1.0f, 0.0f))
+		* glm::angleAxis(glm::radians(this->OrientationEuler.z), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+glm::mat4 cSkinnedGameObject::GetModelMatrix()
+{
+	if (this->Scene)
+		return this->Scene->getWorldMatrix(this->SceneNode);
 
 	glm::mat4 model = glm::mat4(1.0f);
 	model = glm::translate(model, this->Position);
@@ -173,7 +382,117 @@ void cSkinnedGameObject::Draw(cShaderProgram Shader)
 	model = glm::rotate(model, glm::radians(this->OrientationEuler.y), glm::vec3(0.0f, 1.0f, 0.0f));
 	model = glm::rotate(model, glm::radians(this->OrientationEuler.z), glm::vec3(0.0f, 0.0f, 1.0f));
 	model = glm::scale(model, this->Scale);
-	Shader.setMat4("model", model);
 
-	this->Model->Draw(Shader);
-}
\ No newline at end of file
+	return model;
+}
+
+void cSkinnedGameObject::Draw(cShaderProgram& Shader, const sSkinUniforms& uniforms)
+{
+	Shader.useProgram();
+
+	glm::mat4 model = this->GetModelMatrix();
+	uniforms.setModel(model);
+	//Done once here instead of inverting a matrix for every vertex
+	uniforms.setNormalMatrix(glm::transpose(glm::inverse(glm::mat3(model))));
+
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	const cMaterial* boundMaterial = NULL;
+	bool materialBound = false;
+	for (unsigned int index = 0; index < meshes.size() && index < this->vecMeshPaletteOffsets.size(); index++)
+	{
+		//Palette was full this frame, nothing sensible to draw this mesh with
+		if (this->vecMeshPaletteOffsets[index] < 0)
+			continue;
+
+		uniforms.setPaletteOffset(this->vecMeshPaletteOffsets[index]);
+		//Split meshes come one after another with the same material, it only needs binding once
+		if (materialBound && meshes[index].material == boundMaterial)
+		{
+			meshes[index].DrawGeometry();
+			continue;
+		}
+		meshes[index].Draw(Shader);
+		boundMaterial = meshes[index].material;
+		materialBound = true;
+	}
+}
+
+void cSkinnedGameObject::Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sSkinUniforms& uniforms, const glm::mat4& view)
+{
+	if (!this->Visible)
+		return;
+
+	sDrawPacket packet;
+	packet.program = program;
+	packet.modelLocation = uniforms.locations[sSkinUniforms::MODEL];
+	packet.model = this->GetModelMatrix();
+	packet.intLocation = uniforms.locations[sSkinUniforms::PALETTE_OFFSET];
+	packet.indexed = true;
+	float depth = -(view * packet.model[3]).z;
+
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size() && index < this->vecMeshPaletteOffsets.size(); index++)
+	{
+		if (this->vecMeshPaletteOffsets[index] < 0)
+			continue;
+
+		packet.material = meshes[index].material;
+		packet.VAO = meshes[index].getVAO();
+		packet.count = (unsigned int)meshes[index].indices.size();
+		packet.intValue = this->vecMeshPaletteOffsets[index];
+		bucket.submit(pass, packet, depth);
+	}
+}
+
+void cSkinnedGameObject::Skin(cSkinnedVertexCache* cache, cShaderProgram& skinShader)
+{
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	this->vecMeshBaseVertices.resize(meshes.size());
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		int paletteOffset = index < this->vecMeshPaletteOffsets.size() ? this->vecMeshPaletteOffsets[index] : -1;
+		this->vecMeshBaseVertices[index] = cache->skin(meshes[index], paletteOffset, skinShader);
+	}
+}
+
+void cSkinnedGameObject::QueueCPUSkinning(cCPUSkinner* skinner)
+{
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	this->vecMeshBaseVertices.assign(meshes.size(), -1);
+	if (!this->Visible || this->CurrentPose == NULL || this->CurrentPose->empty())
+		return;
+
+	for (unsigned int index = 0; index < meshes.size(); index++)
+	{
+		skinner->addJob(&meshes[index], &(*this->CurrentPose)[0], &this->vecMeshBaseVertices[index]);
+	}
+}
+
+void cSkinnedGameObject::SubmitSkinned(cRenderBucket& bucket, unsigned int pass, cSkinnedVertexCache* cache, cShaderProgram* program,
+	int modelLocation, const glm::mat4& view)
+{
+	if (!this->Visible)
+		return;
+
+	sDrawPacket packet;
+	packet.program = program;
+	packet.modelLocation = modelLocation;
+	packet.model = this->GetModelMatrix();
+	//Every skinned mesh shares the cache's VAO and brings its own indices
+	packet.VAO = cache->VAO;
+	packet.indexed = true;
+	float depth = -(view * packet.model[3]).z;
+
+	std::vector<cMesh>& meshes = this->Model->GetMeshes();
+	for (unsigned int index = 0; index < meshes.size() && index < this->vecMeshBaseVertices.size(); index++)
+	{
+		if (this->vecMeshBaseVertices[index] < 0)
+			continue;
+
+		packet.material = meshes[index].material;
+		packet.elementBuffer = meshes[index].getEBO();
+		packet.baseVertex = this->vecMeshBaseVertices[index];
+		packet.count = (unsigned int)meshes[index].indices.size();
+		bucket.submit(pass, packet, depth);
+	}
+}
@@ -9,6 +9,16 @@
 
 #include "cSkinnedMesh.h"
 #include "cAnimationState.h"
+#include "cPoseCache.h"
+#include "cBonePalette.h"
+#include "cSkinnedVertexCache.h"
+#include "cCPUSkinner.h"
+#include "cPosePool.h"
+#include "cFrustum.h"
+#include "cCrowdSimulation.h"
+#include "cScene.h"
+#include "cShaderUniforms.h"
+#include "cRenderQueue.h"
 
 
 class cSkinnedGameObject
@@ -23,8 +33,38 @@ public:
 	cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, std::vector<std::string> charAnimations);
 	cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, std::map<int, std::string> charAnimations);
 	cSkinnedGameObject(std::string modelName, std::string modelDir, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, float speed, std::map<int, std::string> charAnimations);
-	void Draw(cShaderProgram Shader);
+	//Shares a model loaded once for every character that uses it, instead of loading its own.
+	//The pose cache tells skeletons apart by their cSkinnedMesh, so only characters built this way share poses.
+	cSkinnedGameObject(cSkinnedMesh* model, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler, float speed, std::map<int, std::string> charAnimations);
+	//Advances the animation and writes this frame's bones into the palette.
+	//Update every character, upload the palette once, then Draw them all.
+	//Given a frustum, characters outside it only advance their clocks, and distant ones
+	//evaluate their pose less often (see AnimationLODSizes).
+	void Update(cBonePalette* palette, const cFrustum* frustum = NULL, glm::vec3 cameraPosition = glm::vec3(0.0f));
+	void Draw(cShaderProgram& Shader, const sSkinUniforms& uniforms);
+	//Same draws as packets, one per sub-mesh with a palette slice this frame. The program's palette,
+	//view and projection are left to whoever owns it, and it has to be built with UNIFORM_SCALE.
+	void Submit(cRenderBucket& bucket, unsigned int pass, cShaderProgram* program, const sSkinUniforms& uniforms, const glm::mat4& view);
+	//Alternative to Submit for scenes drawn more than once a frame: after the palette upload,
+	//Skin once into the cache, then SubmitSkinned with the static mesh shader in every pass
+	void Skin(cSkinnedVertexCache* cache, cShaderProgram& skinShader);
+	void SubmitSkinned(cRenderBucket& bucket, unsigned int pass, cSkinnedVertexCache* cache, cShaderProgram* program, int modelLocation,
+		const glm::mat4& view);
+	//CPU version of Skin, the results land in the cache after the skinner runs and uploads.
+	//Update can be given a NULL palette when this is the only path in use.
+	void QueueCPUSkinning(cCPUSkinner* skinner);
 	void Move(float deltaTime);
+	//Hands our movement over to the crowd. Move then only passes CurrentSpeed and CurrentTurnSpeed
+	//to our agent and reads its position back, so Move everyone and then step the crowd once.
+	void JoinCrowd(cCrowdSimulation* crowd);
+	cCrowdSimulation* Crowd;
+	int CrowdAgent;
+	//Gives us a node in the scene (under parent, if there is one) and from then on our model matrix
+	//is its world matrix. Move passes our pose on to it, so Move everyone, update the scene's
+	//world matrices and then Update and Draw.
+	void JoinScene(cScene* scene, int parent = -1);
+	cScene* Scene;
+	int SceneNode;
 	std::vector<std::string> vecCharacterAnimations;
 	std::map<int, std::string> mapCharacterAnimations;
 	cAnimationState* defaultAnimState, *curAnimState;
@@ -33,8 +73,70 @@ public:
 	float TurnSpeed;
 	float CurrentSpeed;
 	float CurrentTurnSpeed;
+	//Optional, shared between characters so identical poses are only evaluated once per frame
+	cPoseCache* PoseCache;
+
+	//Seconds (of animation time) spent blending into a new animToPlay, 0 snaps straight to it
+	float CrossFadeTime;
+	//Extra clips layered over animToPlay in order, each one blended in by its weight.
+	//A Kick layer at 0.5 over Idle gives half of each.
+	struct sAnimationLayer
+	{
+		sAnimationLayer() : weight(0.0f), currentTime(0.0f), clip(-1) {};
+		std::string animationName;
+		float weight;
+		float currentTime;
+		int clip;
+	};
+	std::vector<sAnimationLayer> vecAnimationLayers;
+	void AddAnimationLayer(std::string animationName, float weight);
+	//Scratch poses for blending. Share one between characters and call beginFrame on it
+	//once a frame, or leave it NULL and the object uses (and resets) its own.
+	cPosePool* PosePool;
+
+	//Culling results from the last Update
+	bool Visible;
+	//0 evaluates every frame, 1 every 2nd, 2 every 4th
+	unsigned int AnimationLOD;
+	//Bounds radius over camera distance at which LOD 1 and LOD 2 start
+	float AnimationLODSizes[2];
+	//Box around the last evaluated pose, in model space
+	bool HasBounds;
+	glm::vec3 BoundsMin, BoundsMax;
 private:
 	cSkinnedMesh* Model;
 	std::vector<glm::mat4> vecBoneTransformation;
+	std::vector<glm::mat4> vecFinalTransformation;
+	std::vector<glm::mat4> vecOffsets;
+	//Offset of each sub-mesh's bones in the palette, -1 where the palette was full
+	std::vector<int> vecMeshPaletteOffsets;
+	//Where each sub-mesh's skinned vertices start in the vertex cache, -1 if they didn't fit
+	std::vector<int> vecMeshBaseVertices;
+	//This frame's skeleton bones, either ours or the pose cache's
+	std::vector<glm::mat4>* CurrentPose;
+	//Clip our clock was last snapped onto the pose cache's phase for
+	std::string SnappedAnimation;
+
+	//Cross-fade state, kept between frames
+	std::string LastAnimation;
+	//LastAnimation's index in the model's clips, so the pose cache and blends don't look it up by name
+	int LastClip;
+	float LastAnimationTime;
+	std::string FadeFromAnimation;
+	float FadeFromTime;
+	float FadeElapsed;
+	cPosePool OwnPosePool;
+
+	unsigned int UpdateCount;
+	//Culled characters still evaluate this often, so their bounds can't go stale forever
+	static const unsigned int CULLED_REFRESH_FRAMES = 30;
+
+	void Init(cSkinnedMesh* model, glm::vec3 position, glm::vec3 scale, glm::vec3 orientationEuler);
+	glm::mat4 GetModelMatrix();
+	glm::quat GetOrientation();
+	//Moves the fade and layer clocks on, returns true if more than one clip is in play
+	bool AdvanceBlend(float curFrameTime, float frameStepTime);
+	void EvaluateBlend(float curFrameTime);
+	void AllocatePalettes(cBonePalette* palette, const glm::mat4* bones, std::vector<int>& offsets);
 };
 #endif // !_GAME_OBJECT_
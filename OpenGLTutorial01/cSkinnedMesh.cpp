@@ -7,8 +7,12 @@
 
 #include <glad\glad.h>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
 
 #include "cShaderProgram.h"
+#include "cFrustum.h"
 
 #include <SOIL2\SOIL2.h>
 
@@ -24,16 +28,74 @@ glm::mat4 AIMatrixToGLMMatrix(const aiMatrix4x4& mat)
 
 void cSkinnedMesh::sVertexBoneData::AddBoneData(unsigned int BoneID, float Weight)
 {
-	unsigned int size = sizeof(this->Ids) / sizeof(this->Ids[0]);
-	for (unsigned int Index = 0; Index < size; Index++)
+	//Keep the strongest influences if there are more than we have room for
+	unsigned int weakest = 0;
+	for (unsigned int Index = 0; Index < MAX_BONES_PER_VERTEX; Index++)
 	{
 		if (this->Weights[Index] == 0.0f)
 		{
-			this->Ids[Index] = (float)BoneID;
+			this->Ids[Index] = BoneID;
 			this->Weights[Index] = Weight;
 			return;
 		}
+		if (this->Weights[Index] < this->Weights[weakest])
+			weakest = Index;
 	}
+	if (Weight > this->Weights[weakest])
+	{
+		this->Ids[weakest] = BoneID;
+		this->Weights[weakest] = Weight;
+	}
+}
+
+//Renormalizes the weights to sum to one and quantizes them to unorm16,
+//handing any rounding error to the biggest weight so they still sum to exactly 65535
+void PackBoneWeights(const std::array<float, 4>& weights, unsigned short* packed)
+{
+	float total = weights[0] + weights[1] + weights[2] + weights[3];
+	if (total <= 0.0f)
+	{
+		packed[0] = 65535;
+		packed[1] = packed[2] = packed[3] = 0;
+		return;
+	}
+
+	int sum = 0;
+	unsigned int biggest = 0;
+	for (unsigned int index = 0; index < 4; index++)
+	{
+		packed[index] = (unsigned short)(weights[index] / total * 65535.0f + 0.5f);
+		sum += packed[index];
+		if (weights[index] > weights[biggest])
+			biggest = index;
+	}
+	packed[biggest] = (unsigned short)(packed[biggest] + (65535 - sum));
+}
+
+//Packs a tangent frame into one snorm16 quaternion (a QTangent). The sign of w
+//holds the handedness of the bitangent, and w is kept away from zero so that sign survives quantization.
+glm::i16vec4 EncodeQTangent(glm::vec3 tangent, glm::vec3 bitangent, glm::vec3 normal)
+{
+	normal = glm::normalize(normal);
+	tangent = glm::normalize(tangent - normal * glm::dot(normal, tangent));
+	glm::vec3 rightBitangent = glm::cross(normal, tangent);
+	float handedness = glm::dot(rightBitangent, bitangent) < 0.0f ? -1.0f : 1.0f;
+
+	glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(tangent, rightBitangent, normal)));
+	if (q.w < 0.0f)
+		q = -q;
+
+	const float bias = 1.0f / 32767.0f;
+	if (q.w < bias)
+	{
+		float scale = glm::sqrt(1.0f - bias * bias);
+		q = glm::quat(bias, q.x * scale, q.y * scale, q.z * scale);
+	}
+	if (handedness < 0.0f)
+		q = -q;
+
+	return glm::i16vec4((short)glm::round(q.x * 32767.0f), (short)glm::round(q.y * 32767.0f),
+		(short)glm::round(q.z * 32767.0f), (short)glm::round(q.w * 32767.0f));
 }
 
 cSkinnedMesh::cSkinnedMesh(const std::string& filename)
@@ -74,7 +136,12 @@ bool cSkinnedMesh::LoadMeshFromFile(const std::string &filename)
 		//this->Initialize();
 	}
 	this->directory = filename.substr(0, filename.find_last_of('/'));
+	this->vecMaterials.resize(Scene->mNumMaterials);
+	for (unsigned int i = 0; i < Scene->mNumMaterials; i++)
+		processMaterial(this->vecMaterials[i], Scene->mMaterials[i]);
 	processNode(Scene->mRootNode, Scene);
+	//Bones are known once every mesh is processed
+	flattenSkeleton(Scene->mRootNode, -1);
 	return true;
 }
 
@@ -123,6 +190,11 @@ void cSkinnedMesh::LoadBones(const aiMesh* Mesh, std::vector<sVertexBoneData> &v
 
 			this->VecBoneInfo[BoneIndex].BoneOffset = AIMatrixToGLMMatrix(Mesh->mBones[boneIndex]->mOffsetMatrix);
 			this->MapBoneNameToBoneIndex[BoneName] = BoneIndex;
+
+			sBoneBounds bounds;
+			bounds.Min = glm::vec3(FLT_MAX);
+			bounds.Max = glm::vec3(-FLT_MAX);
+			this->VecBoneBounds.push_back(bounds);
 		}
 		else
 		{
@@ -134,6 +206,13 @@ void cSkinnedMesh::LoadBones(const aiMesh* Mesh, std::vector<sVertexBoneData> &v
 			unsigned int VertexID = /*mMeshEntries[MeshIndex].BaseVertex +*/ Mesh->mBones[boneIndex]->mWeights[WeightIndex].mVertexId;
 			float Weight = Mesh->mBones[boneIndex]->mWeights[WeightIndex].mWeight;
 			vertexBoneData[VertexID].AddBoneData(BoneIndex, Weight);
+
+			if (Weight > 0.0f)
+			{
+				glm::vec3 position(Mesh->mVertices[VertexID].x, Mesh->mVertices[VertexID].y, Mesh->mVertices[VertexID].z);
+				this->VecBoneBounds[BoneIndex].Min = glm::min(this->VecBoneBounds[BoneIndex].Min, position);
+				this->VecBoneBounds[BoneIndex].Max = glm::max(this->VecBoneBounds[BoneIndex].Max, position);
+			}
 		}
 	}
 	return;
@@ -152,6 +231,12 @@ float cSkinnedMesh::FindAnimationTotalTime(std::string animationName)
 
 bool cSkinnedMesh::LoadMeshAnimation(const std::string &filename)
 {
+	//Characters sharing this mesh each ask for their clips, only the first one loads them
+	if (this->MapAnimationNameToScene.find(filename) != this->MapAnimationNameToScene.end())
+	{
+		return true;
+	}
+
 	unsigned int Flags = aiProcess_Triangulate | aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph | aiProcess_JoinIdenticalVertices;
 
 	Assimp::Importer* pImporter = new Assimp::Importer();
@@ -193,6 +278,178 @@ void cSkinnedMesh::BoneTransform(float TimeInSeconds,
 	}
 }
 
+void cSkinnedMesh::flattenSkeleton(const aiNode* node, int parent)
+{
+	sSkeletonNode skeletonNode;
+	skeletonNode.Name = node->mName.data;
+	skeletonNode.Parent = parent;
+
+	std::map<std::string, unsigned int>::iterator it = this->MapBoneNameToBoneIndex.find(skeletonNode.Name);
+	skeletonNode.BoneIndex = it != this->MapBoneNameToBoneIndex.end() ? (int)it->second : -1;
+
+	//Nodes a clip doesn't animate keep their bind transform, which has to be in TRS form to blend
+	glm::vec3 scale, translation, skew;
+	glm::quat rotation;
+	glm::vec4 perspective;
+	glm::decompose(AIMatrixToGLMMatrix(node->mTransformation), scale, rotation, translation, skew, perspective);
+	skeletonNode.BindPose.Rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	skeletonNode.BindPose.Translation = glm::vec4(translation, 0.0f);
+	skeletonNode.BindPose.Scale = glm::vec4(scale, 0.0f);
+
+	int index = (int)this->VecSkeletonNodes.size();
+	this->VecSkeletonNodes.push_back(skeletonNode);
+
+	for (unsigned int ChildIndex = 0; ChildIndex != node->mNumChildren; ChildIndex++)
+	{
+		flattenSkeleton(node->mChildren[ChildIndex], index);
+	}
+}
+
+bool cSkinnedMesh::ComputeBounds(const glm::mat4* finalTransformation, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+
+	bool any = false;
+	for (unsigned int BoneIndex = 0; BoneIndex < this->VecBoneBounds.size(); BoneIndex++)
+	{
+		const sBoneBounds& bounds = this->VecBoneBounds[BoneIndex];
+		if (bounds.Min.x > bounds.Max.x)
+			continue;
+
+		glm::vec3 movedMin, movedMax;
+		TransformAABB(finalTransformation[BoneIndex], bounds.Min, bounds.Max, movedMin, movedMax);
+		boundsMin = glm::min(boundsMin, movedMin);
+		boundsMax = glm::max(boundsMax, movedMax);
+		any = true;
+	}
+	return any;
+}
+
+int cSkinnedMesh::FindClip(const std::string& animationName)
+{
+	for (unsigned int index = 0; index < this->VecClips.size(); index++)
+	{
+		if (this->VecClips[index].Name == animationName)
+			return (int)index;
+	}
+
+	//Same fallback as ReadNodeHierarchy: unknown names play the mesh's own animation
+	sClip clip;
+	clip.Name = animationName;
+	clip.Animation = this->Scene->mAnimations[0];
+	std::map< std::string, const aiScene* >::iterator itAnimation = MapAnimationNameToScene.find(animationName);
+	if (itAnimation != MapAnimationNameToScene.end())
+	{
+		clip.Animation = itAnimation->second->mAnimations[0];
+	}
+
+	clip.Channels.resize(this->VecSkeletonNodes.size());
+	for (unsigned int index = 0; index < this->VecSkeletonNodes.size(); index++)
+	{
+		clip.Channels[index] = this->FindNodeAnimationChannel(clip.Animation, aiString(this->VecSkeletonNodes[index].Name));
+	}
+
+	this->VecClips.push_back(clip);
+	return (int)this->VecClips.size() - 1;
+}
+
+void cSkinnedMesh::SampleLocalPose(int clip, float TimeInSeconds, sLocalTransform* pose)
+{
+	//Ticks are worked out exactly as BoneTransform does
+	float TicksPerSecond = static_cast<float>(this->Scene->mAnimations[0]->mTicksPerSecond != 0 ?
+		this->Scene->mAnimations[0]->mTicksPerSecond : 25.0);
+	float TimeInTicks = TimeInSeconds * TicksPerSecond;
+	float AnimationTime = fmod(TimeInTicks, (float)this->Scene->mAnimations[0]->mDuration);
+
+	const std::vector<const aiNodeAnim*>& channels = this->VecClips[clip].Channels;
+	for (unsigned int index = 0; index < this->VecSkeletonNodes.size(); index++)
+	{
+		const aiNodeAnim* pNodeAnim = channels[index];
+		if (!pNodeAnim)
+		{
+			pose[index] = this->VecSkeletonNodes[index].BindPose;
+			continue;
+		}
+
+		glm::vec3 scale, position;
+		glm::quat rotation;
+		this->CalcGLMInterpolatedScaling(AnimationTime, pNodeAnim, scale);
+		this->CalcGLMInterpolatedRotation(AnimationTime, pNodeAnim, rotation);
+		this->CalcGLMInterpolatedPosition(AnimationTime, pNodeAnim, position);
+
+		pose[index].Rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+		pose[index].Translation = glm::vec4(position, 0.0f);
+		pose[index].Scale = glm::vec4(scale, 0.0f);
+	}
+}
+
+void cSkinnedMesh::LocalToFinalPose(const sLocalTransform* pose, cPosePool& pool,
+	std::vector<glm::mat4>& FinalTransformation, std::vector<glm::mat4>& Globals)
+{
+	unsigned int numNodes = (unsigned int)this->VecSkeletonNodes.size();
+	glm::mat4* objectTransforms = pool.acquireMatrices(numNodes);
+
+	FinalTransformation.resize(this->NumBones);
+	Globals.resize(this->NumBones);
+
+	//Parents come first, so one pass down the array does the whole hierarchy
+	for (unsigned int index = 0; index < numNodes; index++)
+	{
+		const sLocalTransform& local = pose[index];
+		glm::mat4 NodeTransformation = glm::mat4_cast(glm::quat(local.Rotation.w, local.Rotation.x, local.Rotation.y, local.Rotation.z));
+		NodeTransformation[0] *= local.Scale.x;
+		NodeTransformation[1] *= local.Scale.y;
+		NodeTransformation[2] *= local.Scale.z;
+		NodeTransformation[3] = glm::vec4(glm::vec3(local.Translation), 1.0f);
+
+		int parent = this->VecSkeletonNodes[index].Parent;
+		objectTransforms[index] = parent < 0 ? NodeTransformation : objectTransforms[parent] * NodeTransformation;
+
+		int BoneIndex = this->VecSkeletonNodes[index].BoneIndex;
+		if (BoneIndex >= 0)
+		{
+			Globals[BoneIndex] = objectTransforms[index];
+			FinalTransformation[BoneIndex] = this->GlobalInverseTransformation
+				* objectTransforms[index]
+				* this->VecBoneInfo[BoneIndex].BoneOffset;
+		}
+	}
+}
+
+void cSkinnedMesh::BlendTransform(const sBlendClip* clips, unsigned int numClips, cPosePool& pool,
+	std::vector<glm::mat4>& FinalTransformation, std::vector<glm::mat4>& Globals)
+{
+	unsigned int numNodes = (unsigned int)this->VecSkeletonNodes.size();
+
+	float totalWeight = 0.0f;
+	for (unsigned int index = 0; index < numClips; index++)
+		totalWeight += clips[index].weight;
+
+	sLocalTransform* blended = pool.acquireLocal(numNodes);
+	sLocalTransform* sample = pool.acquireLocal(numNodes);
+	std::memset(blended, 0, numNodes * sizeof(sLocalTransform));
+
+	//One evaluation per clip that actually counts
+	for (unsigned int index = 0; index < numClips; index++)
+	{
+		if (clips[index].weight <= 0.0f || totalWeight <= 0.0f)
+			continue;
+
+		this->SampleLocalPose(clips[index].clip, clips[index].time, sample);
+		AccumulateLocalPose(blended, sample, numNodes, clips[index].weight / totalWeight);
+	}
+
+	if (totalWeight <= 0.0f)
+	{
+		for (unsigned int index = 0; index < numNodes; index++)
+			blended[index] = this->VecSkeletonNodes[index].BindPose;
+	}
+	NormalizeLocalPose(blended, numNodes);
+
+	this->LocalToFinalPose(blended, pool, FinalTransformation, Globals);
+}
+
 const aiNodeAnim* cSkinnedMesh::FindNodeAnimationChannel(const aiAnimation* pAnimation, aiString boneName)
 {
 	for (unsigned int ChannelIndex = 0; ChannelIndex != pAnimation->mNumChannels; ChannelIndex++)
@@ -463,12 +720,38 @@ float cSkinnedMesh::GetAnimationDuration(const aiScene* scene)
 	float duration = (float)(scene->mAnimations[0]->mDuration / scene->mAnimations[0]->mTicksPerSecond);
 	return duration;
 }
+float cSkinnedMesh::GetClipDuration(std::string animationName)
+{
+	std::map<std::string, const aiScene*>::iterator itAnimation = this->MapAnimationNameToScene.find(animationName);
+	if (itAnimation == this->MapAnimationNameToScene.end())
+	{
+		return this->GetDuration();
+	}
+	return this->GetAnimationDuration(itAnimation->second);
+}
+
 
+void cSkinnedMesh::Draw(cShaderProgram& shader)
+{
+	//Sub-meshes of one aiMesh sit next to each other and share its material, bind it once for the lot
+	for (unsigned int i = 0; i < this->vecMeshes.size(); i++)
+	{
+		if (i == 0 || this->vecMeshes[i].material != this->vecMeshes[i - 1].material)
+			this->vecMeshes[i].Draw(shader);
+		else
+			this->vecMeshes[i].DrawGeometry();
+	}
+}
 
-void cSkinnedMesh::Draw(cShaderProgram shader)
+void cSkinnedMesh::DrawInstanced(cShaderProgram& shader, unsigned int instanceCount)
 {
 	for (unsigned int i = 0; i < this->vecMeshes.size(); i++)
-		this->vecMeshes[i].Draw(shader);
+		this->vecMeshes[i].DrawInstanced(shader, instanceCount);
+}
+
+std::vector<cMesh>& cSkinnedMesh::GetMeshes()
+{
+	return this->vecMeshes;
 }
 
 void cSkinnedMesh::processNode(aiNode * node, const aiScene * scene)
@@ -478,8 +761,8 @@ void cSkinnedMesh::processNode(aiNode * node, const aiScene * scene)
 		aiMesh * mesh = scene->mMeshes[node->mMeshes[i]];
 		
 		//this->Initialize(i);
-		this->Initialize(i);
-		this->vecMeshes.push_back(processMesh(mesh, scene));
+		this->Initialize(node->mMeshes[i]);
+		processMesh(mesh, scene);
 	}
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
 	{
@@ -487,12 +770,10 @@ void cSkinnedMesh::processNode(aiNode * node, const aiScene * scene)
 	}
 }
 
-cMesh cSkinnedMesh::processMesh(aiMesh * mesh, const aiScene * scene)
+void cSkinnedMesh::processMesh(aiMesh * mesh, const aiScene * scene)
 {
 	std::vector<sSkinnedMeshVertex> vertices;
-	std::vector<GLuint> indices;
-	std::vector<sTexture> textures;
-
+	std::vector<glm::i16vec4> tangentFrames;
 
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 	{
@@ -522,60 +803,128 @@ cMesh cSkinnedMesh::processMesh(aiMesh * mesh, const aiScene * scene)
 			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 		}
 
+		//Only meshes that really have a tangent frame get the extra stream
 		if (mesh->HasTangentsAndBitangents())
 		{
-			vector.x = mesh->mTangents[i].x;
-			vector.y = mesh->mTangents[i].y;
-			vector.z = mesh->mTangents[i].z;
-			vertex.Tangent = vector;
-
-			vector.x = mesh->mBitangents[i].x;
-			vector.y = mesh->mBitangents[i].y;
-			vector.z = mesh->mBitangents[i].z;
-			vertex.BiTangent = vector;
+			glm::vec3 tangent(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+			glm::vec3 bitangent(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+			tangentFrames.push_back(EncodeQTangent(tangent, bitangent, vertex.Normal));
 		}
-		else
-		{
-			vertex.Tangent = glm::vec3(0.0f);
-			vertex.BiTangent = glm::vec3(0.0f);
-		}
-
-		vertex.BoneID[0] = this->VecVertexBoneData[i].Ids[0];
-		vertex.BoneID[1] = this->VecVertexBoneData[i].Ids[1];
-		vertex.BoneID[2] = this->VecVertexBoneData[i].Ids[2];
-		vertex.BoneID[3] = this->VecVertexBoneData[i].Ids[3];
 
-		vertex.BoneWeights[0] = this->VecVertexBoneData[i].Weights[0];
-		vertex.BoneWeights[1] = this->VecVertexBoneData[i].Weights[1];
-		vertex.BoneWeights[2] = this->VecVertexBoneData[i].Weights[2];
-		vertex.BoneWeights[3] = this->VecVertexBoneData[i].Weights[3];
+		//Bone IDs are filled in below, once we know the sub-mesh's local palette
+		PackBoneWeights(this->VecVertexBoneData[i].Weights, vertex.BoneWeights);
 
 		vertices.push_back(vertex);
 	}
+
+	const cMaterial* material = NULL;
+	if (mesh->mMaterialIndex < this->vecMaterials.size())
+		material = &this->vecMaterials[mesh->mMaterialIndex];
+
+	//Walk the triangles, gathering them into sub-meshes that each reference at most
+	//MAX_BONES_PER_MESH bones. Every sub-mesh gets its own compact palette and remap.
+	std::vector<sSkinnedMeshVertex> subVertices;
+	std::vector<glm::i16vec4> subTangentFrames;
+	std::vector<GLuint> subIndices;
+	std::vector<unsigned int> boneRemap;
+	std::map<unsigned int, unsigned int> mapBoneToLocal;
+	std::map<unsigned int, unsigned int> mapVertexToLocal;
+	unsigned int numSubMeshes = 0;
+
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 	{
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
+
+		//Count the bones this face would add to the current sub-mesh
+		std::vector<unsigned int> newBones;
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 		{
-			indices.push_back(face.mIndices[j]);
+			unsigned int vertexIndex = face.mIndices[j];
+			for (unsigned int boneSlot = 0; boneSlot < MAX_BONES_PER_VERTEX; boneSlot++)
+			{
+				unsigned int boneID = this->VecVertexBoneData[vertexIndex].Ids[boneSlot];
+				if (vertices[vertexIndex].BoneWeights[boneSlot] > 0 && mapBoneToLocal.find(boneID) == mapBoneToLocal.end()
+					&& std::find(newBones.begin(), newBones.end(), boneID) == newBones.end())
+				{
+					newBones.push_back(boneID);
+				}
+			}
 		}
-	}
 
-	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		if (boneRemap.size() + newBones.size() > MAX_BONES_PER_MESH && !subIndices.empty())
+		{
+			this->vecMeshes.push_back(cMesh(subVertices, subIndices, material, subTangentFrames));
+			this->vecMeshes.back().boneRemap = boneRemap;
+			numSubMeshes++;
+
+			subVertices.clear();
+			subTangentFrames.clear();
+			subIndices.clear();
+			boneRemap.clear();
+			mapBoneToLocal.clear();
+			mapVertexToLocal.clear();
+		}
+
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+		{
+			unsigned int vertexIndex = face.mIndices[j];
+			std::map<unsigned int, unsigned int>::iterator itVertex = mapVertexToLocal.find(vertexIndex);
+			if (itVertex != mapVertexToLocal.end())
+			{
+				subIndices.push_back(itVertex->second);
+				continue;
+			}
+
+			sSkinnedMeshVertex vertex = vertices[vertexIndex];
+			for (unsigned int boneSlot = 0; boneSlot < MAX_BONES_PER_VERTEX; boneSlot++)
+			{
+				vertex.BoneID[boneSlot] = 0;
+				if (vertex.BoneWeights[boneSlot] == 0)
+					continue;
+
+				unsigned int boneID = this->VecVertexBoneData[vertexIndex].Ids[boneSlot];
+				std::map<unsigned int, unsigned int>::iterator itBone = mapBoneToLocal.find(boneID);
+				if (itBone == mapBoneToLocal.end())
+				{
+					itBone = mapBoneToLocal.insert(std::make_pair(boneID, (unsigned int)boneRemap.size())).first;
+					boneRemap.push_back(boneID);
+				}
+				vertex.BoneID[boneSlot] = (unsigned char)itBone->second;
+			}
+
+			mapVertexToLocal[vertexIndex] = (unsigned int)subVertices.size();
+			subIndices.push_back((GLuint)subVertices.size());
+			subVertices.push_back(vertex);
+			if (!tangentFrames.empty())
+				subTangentFrames.push_back(tangentFrames[vertexIndex]);
+		}
+	}
 
-	std::vector<sTexture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+	if (!subIndices.empty())
+	{
+		this->vecMeshes.push_back(cMesh(subVertices, subIndices, material, subTangentFrames));
+		this->vecMeshes.back().boneRemap = boneRemap;
+		numSubMeshes++;
+	}
 
-	std::vector<sTexture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+	if (numSubMeshes > 1)
+		printf("Skinned mesh %s references too many bones for one draw, split into %d meshes.\n", this->Filename.c_str(), numSubMeshes);
+}
 
-	std::vector<sTexture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-	textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+//Only the maps the shaders sample, normal and height maps would never be read
+void cSkinnedMesh::processMaterial(cMaterial& material, aiMaterial* aiMat)
+{
+	std::vector<sTexture> diffuseMaps = loadMaterialTextures(aiMat, aiTextureType_DIFFUSE, "texture_diffuse");
+	for (unsigned int i = 0; i < diffuseMaps.size(); i++)
+		material.addTexture(diffuseMaps[i]);
 
-	std::vector<sTexture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-	textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+	std::vector<sTexture> specularMaps = loadMaterialTextures(aiMat, aiTextureType_SPECULAR, "texture_specular");
+	for (unsigned int i = 0; i < specularMaps.size(); i++)
+		material.addTexture(specularMaps[i]);
 
-	return cMesh(vertices, indices, textures);
+	float shininess;
+	if (aiMat->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess > 0.0f)
+		material.shininess = shininess;
 }
 
 std::vector<sTexture> cSkinnedMesh::loadMaterialTextures(aiMaterial * mat, aiTextureType type, std::string typeName)
@@ -625,7 +974,7 @@ unsigned int SMTextureFromFile(const char *path, const std::string &directory, b
 	unsigned char * data = SOIL_load_image(filename.c_str(), &width, &height, &nrComponents, SOIL_LOAD_AUTO);
 	if (data)
 	{
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		cGLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 		GLenum format;
 		if (nrComponents == 1)
 			format = GL_RED;
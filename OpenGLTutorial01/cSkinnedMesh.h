@@ -13,6 +13,8 @@
 #include <glm\glm.hpp>
 
 #include "cMesh.h"
+#include "cPosePool.h"
+#include "cGLState.h"
 class cShaderProgram;
 
 class cSkinnedMesh
@@ -21,7 +23,7 @@ private:
 	static const int MAX_BONES_PER_VERTEX = 4;
 	struct sVertexBoneData
 	{
-		std::array<float, MAX_BONES_PER_VERTEX> Ids;
+		std::array<unsigned int, MAX_BONES_PER_VERTEX> Ids;
 		std::array<float, MAX_BONES_PER_VERTEX> Weights;
 
 		void AddBoneData(unsigned int BoneID, float Weight);
@@ -32,7 +34,26 @@ private:
 		glm::mat4 FinalTransformation;
 		glm::mat4 ObjectBoneTransformation;
 	};
+	//The node hierarchy flattened so parents always come before their children
+	struct sSkeletonNode
+	{
+		std::string Name;
+		int Parent;				//-1 for the root
+		int BoneIndex;			//-1 if no bone is attached
+		sLocalTransform BindPose;
+	};
+	//A clip with its channels looked up for every skeleton node (NULL if the node isn't animated)
+	struct sClip
+	{
+		std::string Name;
+		const aiAnimation* Animation;
+		std::vector<const aiNodeAnim*> Channels;
+	};
 public:
+	//Bone IDs are stored as bytes, so a single draw can reference at most this many bones.
+	//Meshes that use more are split when they are loaded.
+	static const unsigned int MAX_BONES_PER_MESH = 256;
+
 	unsigned int NumVertices;
 	unsigned int NumIndices;
 	unsigned int NumTriangles;
@@ -48,10 +69,20 @@ public:
 	std::vector<sVertexBoneData> VecVertexBoneData;
 	std::map<std::string, unsigned int> MapBoneNameToBoneIndex;
 	std::vector<sBoneInfo> VecBoneInfo;
+	//Bind pose box around every vertex each bone moves, empty (min > max) for bones that move none
+	struct sBoneBounds
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+	};
+	std::vector<sBoneBounds> VecBoneBounds;
 	std::vector<cMesh> VecMeshes;
 
 	glm::mat4 GlobalInverseTransformation;
 
+	std::vector<sSkeletonNode> VecSkeletonNodes;
+	std::vector<sClip> VecClips;
+
 	cSkinnedMesh(const std::string& filename);
 	~cSkinnedMesh();
 
@@ -61,9 +92,22 @@ public:
 	float FindAnimationTotalTime(std::string animationName);
 	float GetDuration();
 	float GetAnimationDuration(const aiScene* scene);
+	float GetClipDuration(std::string animationName);
 
 	void BoneTransform(float time, std::string animationName, std::vector<glm::mat4>& finalTransformation, std::vector<glm::mat4>& globals, std::vector<glm::mat4>& offsets);
 
+	//Blending works in local space on the flattened skeleton: each clip is sampled once,
+	//the samples are weighted together, and only the result goes up the hierarchy.
+	//Scratch poses come from the pool, so nothing is allocated once it has warmed up.
+	int FindClip(const std::string& animationName);
+	void SampleLocalPose(int clip, float timeInSeconds, sLocalTransform* pose);
+	void LocalToFinalPose(const sLocalTransform* pose, cPosePool& pool, std::vector<glm::mat4>& finalTransformation, std::vector<glm::mat4>& globals);
+	void BlendTransform(const sBlendClip* clips, unsigned int numClips, cPosePool& pool, std::vector<glm::mat4>& finalTransformation, std::vector<glm::mat4>& globals);
+
+	//Box around the mesh in the given pose. Every skinned vertex is a blend of its bones'
+	//transforms, so it always lands inside the union of those bones' moved boxes.
+	bool ComputeBounds(const glm::mat4* finalTransformation, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
 	bool Initialize();
 	bool Initialize(int index);
 
@@ -88,14 +132,20 @@ public:
 	//void Close();
 
 
-	void Draw(cShaderProgram shader);
+	void Draw(cShaderProgram& shader);
+	void DrawInstanced(cShaderProgram& shader, unsigned int instanceCount);
+	std::vector<cMesh>& GetMeshes();
 private:
 	std::vector<cMesh> vecMeshes;
+	//One per aiMaterial, sized once while loading so the meshes' pointers into it hold
+	std::vector<cMaterial> vecMaterials;
 	std::vector<sTexture> vecTexturesLoaded;
 	std::string directory;
 	void loadModel(std::string path);
 	void processNode(aiNode* node, const aiScene* scene);
-	cMesh processMesh(aiMesh* mesh, const aiScene* scene);
+	void flattenSkeleton(const aiNode* node, int parent);
+	void processMesh(aiMesh* mesh, const aiScene* scene);
+	void processMaterial(cMaterial& material, aiMaterial* aiMat);
 	std::vector<sTexture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
 };
 
@@ -0,0 +1,126 @@
+#include "cSkinnedVertexCache.h"
+
+#include <cstddef>
+
+cSkinnedVertexCache::cSkinnedVertexCache(unsigned int maxVertices)
+{
+	this->maxVertices = maxVertices;
+	this->verticesUsed = 0;
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+
+	cGLState::bindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	//Written by the GPU and read back by the GPU, the CPU never touches it
+	glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(sVertex), NULL, GL_DYNAMIC_COPY);
+
+	//Same layout as a static mesh so the normal shaders can draw it
+	//Position
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(sVertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	//Normals
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(sVertex), (void*)offsetof(sVertex, Normal));
+	glEnableVertexAttribArray(1);
+	//Texture coordinates
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(sVertex), (void*)offsetof(sVertex, TexCoords));
+	glEnableVertexAttribArray(2);
+
+	cGLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+cSkinnedVertexCache::~cSkinnedVertexCache()
+{
+	glDeleteVertexArrays(1, &VAO);
+	cGLState::forgetVertexArray(VAO);
+	glDeleteBuffers(1, &VBO);
+}
+
+void cSkinnedVertexCache::beginFrame()
+{
+	verticesUsed = 0;
+	mapSkinnedThisFrame.clear();
+
+	//Orphan last frame's vertices so we never wait on draws still reading them
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, maxVertices * sizeof(sVertex), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void cSkinnedVertexCache::beginSkinning(cShaderProgram& skinShader)
+{
+	skinShader.useProgram();
+	//Only the captured vertices matter, nothing should reach the framebuffer
+	cGLState::enable(GL_RASTERIZER_DISCARD);
+}
+
+void cSkinnedVertexCache::endSkinning()
+{
+	cGLState::disable(GL_RASTERIZER_DISCARD);
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+}
+
+int cSkinnedVertexCache::skin(cMesh& mesh, int paletteOffset, cShaderProgram& skinShader)
+{
+	if (paletteOffset < 0)
+		return -1;
+
+	//Characters sharing a pose share a palette slice, so they share the skinned vertices too
+	std::pair<const cMesh*, int> key(&mesh, paletteOffset);
+	std::map<std::pair<const cMesh*, int>, int>::iterator it = mapSkinnedThisFrame.find(key);
+	if (it != mapSkinnedThisFrame.end())
+		return it->second;
+
+	unsigned int numVertices = (unsigned int)mesh.skinnedVertices.size();
+	if (verticesUsed + numVertices > maxVertices)
+		return -1;
+
+	int baseVertex = verticesUsed;
+	skinShader.setInt("paletteOffset", paletteOffset);
+
+	//Every vertex is pushed through exactly once as a point, in order
+	glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, VBO, baseVertex * sizeof(sVertex), numVertices * sizeof(sVertex));
+	cGLState::bindVertexArray(mesh.getVAO());
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, numVertices);
+	glEndTransformFeedback();
+	cGLState::bindVertexArray(0);
+
+	verticesUsed += numVertices;
+	mapSkinnedThisFrame[key] = baseVertex;
+
+	return baseVertex;
+}
+
+int cSkinnedVertexCache::write(const sVertex* vertices, unsigned int numVertices)
+{
+	if (verticesUsed + numVertices > maxVertices)
+		return -1;
+
+	int baseVertex = verticesUsed;
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(sVertex), numVertices * sizeof(sVertex), vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	verticesUsed += numVertices;
+
+	return baseVertex;
+}
+
+void cSkinnedVertexCache::draw(cMesh& mesh, int baseVertex, cShaderProgram& shader)
+{
+	if (baseVertex < 0)
+		return;
+
+	mesh.DrawBaseVertex(shader, VAO, baseVertex);
+}
+
+unsigned int cSkinnedVertexCache::getVerticesUsed()
+{
+	return verticesUsed;
+}
+
+unsigned int cSkinnedVertexCache::getMaxVertices()
+{
+	return maxVertices;
+}
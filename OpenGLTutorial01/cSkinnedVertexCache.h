@@ -0,0 +1,52 @@
+#ifndef _HG_cSkinnedVertexCache_
+#define _HG_cSkinnedVertexCache_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <map>
+#include <utility>
+
+#include "cMesh.h"
+#include "cShaderProgram.h"
+#include "cGLState.h"
+
+//Skins each character once per frame, with transform feedback (or cCPUSkinner), into one shared
+//buffer of plain sVertex data. Every pass after that (main view, portal view, shadows)
+//draws the result as static geometry with the ordinary vertShader.glsl path.
+class cSkinnedVertexCache
+{
+public:
+	cSkinnedVertexCache(unsigned int maxVertices);
+	~cSkinnedVertexCache();
+	//Owns its VBO and VAO
+	cSkinnedVertexCache(const cSkinnedVertexCache&) = delete;
+	cSkinnedVertexCache& operator=(const cSkinnedVertexCache&) = delete;
+
+	void beginFrame();
+
+	//Wrap the skin() calls in these, with the bone palette already uploaded and bound to skinShader
+	void beginSkinning(cShaderProgram& skinShader);
+	void endSkinning();
+	//Skins the mesh with the palette slice at paletteOffset and returns where its vertices start,
+	//or -1 if the buffer is full. Meshes already skinned with the same slice this frame are reused.
+	int skin(cMesh& mesh, int paletteOffset, cShaderProgram& skinShader);
+
+	//For vertices skinned somewhere else (cCPUSkinner): streams them into the buffer
+	//and returns where they start, or -1 if the buffer is full
+	int write(const sVertex* vertices, unsigned int numVertices);
+
+	void draw(cMesh& mesh, int baseVertex, cShaderProgram& shader);
+
+	unsigned int getVerticesUsed();
+	unsigned int getMaxVertices();
+
+	unsigned int VAO, VBO;
+
+private:
+	std::map<std::pair<const cMesh*, int>, int> mapSkinnedThisFrame;
+	unsigned int verticesUsed;
+	unsigned int maxVertices;
+};
+
+#endif
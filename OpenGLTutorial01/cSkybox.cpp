@@ -62,7 +62,7 @@ void cSkybox::skyboxInit()
 	boxNames.push_back("back.jpg");
 
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	cGLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
 	int width, height, nrChannels;
 	for (unsigned int i = 0; i < boxNames.size(); i++)
@@ -97,7 +97,7 @@ void cSkybox::skyboxInit()
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
 	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	cGLState::bindVertexArray(VAO);
 
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -12,6 +12,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <SOIL2/SOIL2.h>
 
+#include "cGLState.h"
+
 class cSkybox
 {
 public:
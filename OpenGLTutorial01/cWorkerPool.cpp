@@ -0,0 +1,91 @@
+#include "cWorkerPool.h"
+
+cWorkerPool::cWorkerPool(unsigned int numThreads)
+{
+	this->generation = 0;
+	this->workersBusy = 0;
+	this->quitting = false;
+	this->work = NULL;
+	this->numChunks = 0;
+	this->nextChunk = 0;
+
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	//The calling thread does its share too
+	for (unsigned int index = 1; index < numThreads; index++)
+	{
+		vecWorkers.push_back(std::thread(&cWorkerPool::workerLoop, this));
+	}
+}
+
+cWorkerPool::~cWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	wakeWorkers.notify_all();
+	for (unsigned int index = 0; index < vecWorkers.size(); index++)
+		vecWorkers[index].join();
+}
+
+void cWorkerPool::run(unsigned int numChunks, const std::function<void(unsigned int)>& work)
+{
+	if (numChunks == 0)
+		return;
+
+	this->work = &work;
+	this->numChunks = numChunks;
+	nextChunk = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		workersBusy = (unsigned int)vecWorkers.size();
+		generation++;
+	}
+	wakeWorkers.notify_all();
+
+	processChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	workersDone.wait(lock, [this] { return workersBusy == 0; });
+	this->work = NULL;
+}
+
+void cWorkerPool::workerLoop()
+{
+	unsigned int seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeWorkers.wait(lock, [&] { return quitting || generation != seenGeneration; });
+			if (quitting)
+				return;
+			seenGeneration = generation;
+		}
+
+		processChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			workersBusy--;
+		}
+		workersDone.notify_one();
+	}
+}
+
+void cWorkerPool::processChunks()
+{
+	for (unsigned int index = nextChunk++; index < numChunks; index = nextChunk++)
+	{
+		(*work)(index);
+	}
+}
+
+unsigned int cWorkerPool::getNumThreads()
+{
+	return (unsigned int)vecWorkers.size() + 1;
+}
@@ -0,0 +1,48 @@
+#ifndef _HG_cWorkerPool_
+#define _HG_cWorkerPool_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads for splitting a loop into numbered chunks.
+//Workers sleep between runs, and the calling thread takes chunks too, so a
+//pool of one thread just runs the loop inline.
+class cWorkerPool
+{
+public:
+	//0 threads means one per hardware thread
+	cWorkerPool(unsigned int numThreads = 0);
+	~cWorkerPool();
+	//The workers hold on to this
+	cWorkerPool(const cWorkerPool&) = delete;
+	cWorkerPool& operator=(const cWorkerPool&) = delete;
+
+	//Calls work once for every chunk in 0..numChunks-1, in no particular order or thread,
+	//and returns once they are all done
+	void run(unsigned int numChunks, const std::function<void(unsigned int)>& work);
+
+	unsigned int getNumThreads();
+
+private:
+	std::vector<std::thread> vecWorkers;
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable workersDone;
+	unsigned int generation;
+	unsigned int workersBusy;
+	bool quitting;
+
+	//The current run, only touched between waking the workers and them all finishing
+	const std::function<void(unsigned int)>* work;
+	unsigned int numChunks;
+	std::atomic<unsigned int> nextChunk;
+
+	void workerLoop();
+	void processChunks();
+};
+
+#endif
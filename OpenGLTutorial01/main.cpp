@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cmath>
+#include <algorithm>
 
 #include "cShaderProgram.h"
 #include "cCamera.h"
@@ -21,6 +23,19 @@
 #include "cScreenQuad.h"
 #include "cPlaneObject.h"
 #include "cFrameBuffer.h"
+#include "cLightBuffer.h"
+#include "cShaderManager.h"
+#include "cShaderUniforms.h"
+#include "cGLState.h"
+#include "cResourceRegistry.h"
+#include "cRenderQueue.h"
+#include "cScene.h"
+#include "cAABBTree.h"
+#include "cFrustum.h"
+#include "cBakedAnimation.h"
+#include "cInstancedCrowd.h"
+#include "cClipCurves.h"
+#include "cSampledCrowd.h"
 
 //Setting up a camera GLOBAL
 cCamera Camera(glm::vec3(0.0f, 0.0f, 3.0f),		//Camera Position
@@ -42,18 +57,109 @@ unsigned int SCR_HEIGHT = 800;
 
 int drawType = 1;
 
-std::map<std::string, cModel*> mapModelsToNames;
-std::map<std::string, cSkinnedMesh*> mapSkinnedMeshToNames;
-std::map<std::string, cShaderProgram*> mapShaderToName;
+//How the characters are skinned, M switches between them
+enum eSkinningMode
+{
+	SKIN_IN_SHADER,		//animVert.glsl skins every vertex again in every pass that draws it
+	SKIN_FEEDBACK,		//Skinned once a frame with transform feedback into a cSkinnedVertexCache
+	SKIN_CPU,			//Skinned once a frame by a cCPUSkinner into the same cache, for software GL
+	NUM_SKINNING_MODES
+};
+const char* const skinningModeNames[NUM_SKINNING_MODES] = { "in the vertex shader", "once a frame with transform feedback", "once a frame on the CPU" };
+int skinningMode = SKIN_FEEDBACK;
+
+//The crowd either replays one baked clip or samples clip curves per instance, C switches between them
+bool crowdSampled = false;
+//N swaps every character over to the other animation, which they cross-fade into
+bool swapCharacterAnimations = false;
+//The once a second state change, culling and pose cache report, P or --stats turns it on
+bool printStats = false;
+
+//Models, programs and textures by handle, names are only looked up while loading
+cResourceRegistry registry;
+
+//Where each program's uniforms live, looked up once after linking (see cShaderUniforms.h)
+sMainUniforms mainUniforms, reflectUniforms, refractUniforms;
+sSkyboxUniforms skyboxUniforms;
+sSimpleUniforms simpleUniforms;
+sSkinUniforms skinUniforms;
+sInstancedSkinUniforms instancedSkinUniforms;
+sSampledSkinUniforms sampledSkinUniforms;
+
+//The frame's render queue passes, in the order they run
+enum eScenePass
+{
+	PASS_STENCIL_MASK,		//Planes marking where the space scene doesn't show
+	PASS_SCENE,
+	PASS_SCENE_SKYBOX,
+	PASS_SPACE,				//Shows through wherever the main scene left the stencil alone
+	PASS_SPACE_SKYBOX,
+	PASS_POST,				//The whole scene onto the window through a post effect
+	NUM_SCENE_PASSES
+};
+const char* const scenePassNames[NUM_SCENE_PASSES] = { "stencil mask", "scene", "scene skybox", "space", "space skybox", "post" };
+
+//Something the scene draws that can be culled: where it stands, what it is and which pass draws it
+struct sSceneInstance
+{
+	int node;
+	unsigned int pass;
+	//Null for one of the planes, which draw with the simple program and texture
+	ModelHandle model;
+	ShaderHandle shader;
+	const sMainUniforms* uniforms;
+	TextureHandle texture;
+	//Its leaf in the culling tree
+	int proxy;
+};
+
+//What culling let through and took out of each pass, as of the last time the pass was culled
+struct sCullStats
+{
+	sCullStats() : visible(0), culled(0), meshesVisible(0), meshesCulled(0) {}
+	unsigned int visible, culled;
+	unsigned int meshesVisible, meshesCulled;
+};
+sCullStats cullStats[NUM_SCENE_PASSES];
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 unsigned int loadCubeMap(std::string directory, std::vector<std::string> faces);
+bool checkBlendAgainstBoneTransform(cSkinnedMesh* mesh, const std::string& animationA, const std::string& animationB);
 
-int main()
+int main(int argc, char** argv)
 {
+	//--cpu-skinning starts out skinning on the CPU, --benchmark times the CPU skinning and crowd and quits,
+	//--check-blend compares blended poses with unblended ones once the character has loaded and quits,
+	//--stats starts out printing the once a second report
+	bool runBenchmarks = false;
+	bool checkBlend = false;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		std::string option = argv[arg];
+		if (option == "--benchmark")
+			runBenchmarks = true;
+		else if (option == "--check-blend")
+			checkBlend = true;
+		else if (option == "--stats")
+			printStats = true;
+		else if (option == "--cpu-skinning")
+			skinningMode = SKIN_CPU;
+	}
+	if (runBenchmarks)
+	{
+		//About a dozen characters' worth of vertices
+		cCPUSkinner benchmarkSkinner;
+		benchmarkSkinner.benchmark(200000, 64, 100);
+		//The crowd's target is 10k agents in under a millisecond
+		cCrowdSimulation benchmarkCrowd;
+		benchmarkCrowd.benchmark(10000, 100);
+		return 0;
+	}
+
 	glfwInit();
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -79,49 +185,86 @@ int main()
 	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
 	//Setting up global openGL state
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glEnable(GL_STENCIL_TEST);
-	glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	cGLState::enable(GL_DEPTH_TEST);
+	cGLState::depthFunc(GL_LESS);
+	cGLState::enable(GL_STENCIL_TEST);
+	cGLState::stencilFunc(GL_NOTEQUAL, 1, 0xFF);
+	cGLState::stencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetKeyCallback(window, key_callback);
 
-	//Set up all our programs
-	cShaderProgram* myProgram = new cShaderProgram();
-	myProgram->compileProgram("assets/shaders/", "vertShader.glsl", "fragShader.glsl");
-	mapShaderToName["mainProgram"] = myProgram;
+	//Set up all our programs. Every compile is handed to the driver here but only collected once
+	//the models and textures below have loaded, so the two overlap instead of queueing up.
+	//Timed so a cold binary cache can be told apart from a warm one.
+	double programStartTime = glfwGetTime();
 
-	myProgram = new cShaderProgram();
-	myProgram->compileProgram("assets/shaders/", "animVert.glsl", "animFrag.glsl");
-	mapShaderToName["skinProgram"] = myProgram;
+	//Every light lives in one uniform buffer that any program can attach to
+	cLightBuffer lights;
+	cShaderManager shaderManager("assets/shaders/");
 
-	myProgram = new cShaderProgram();
-	myProgram->compileProgram("assets/shaders/", "skyBoxVert.glsl", "skyBoxFrag.glsl");
-	mapShaderToName["skyboxProgram"] = myProgram;
-
-	myProgram = new cShaderProgram();
-	myProgram->compileProgram("assets/shaders/", "modelVert.glsl", "modelFrag.glsl");
-	mapShaderToName["simpleProgram"] = myProgram;
+	//The main shader is built per kind of surface, so no draw pays for the branches it doesn't take.
+	//Everything in the scene is scaled evenly, which spares all of them an inverse per vertex.
+	cShaderPermutations mainPermutations("assets/shaders/", "vertShader.glsl", "fragShader.glsl");
+	mainPermutations.onCompile = [&lights](cShaderProgram& program)
+	{
+		sMainUniforms uniforms;
+		uniforms.bind(program);
+		program.useProgram();
+		uniforms.setSkybox(0);
+		lights.attach(program);
+	};
+	mainPermutations.prepare({ "LIT", "UNIFORM_SCALE" });
+	mainPermutations.prepare({ "REFLECT", "UNIFORM_SCALE" });
+	mainPermutations.prepare({ "REFRACT", "UNIFORM_SCALE" });
+
+	//The characters are scaled evenly as well
+	shaderManager.add("skinProgram", "animVert.glsl", "animFrag.glsl", { "UNIFORM_SCALE" });
+	shaderManager.add("instancedSkinProgram", "animInstancedVert.glsl", "animFrag.glsl");
+	shaderManager.add("sampledSkinProgram", "animSampledVert.glsl", "animFrag.glsl");
+	shaderManager.add("skyboxProgram", "skyBoxVert.glsl", "skyBoxFrag.glsl", std::vector<std::string>(), [](cShaderProgram& program)
+	{
+		sSkyboxUniforms uniforms;
+		uniforms.bind(program);
+		program.useProgram();
+		uniforms.setSkybox(0);
+	});
+	shaderManager.add("simpleProgram", "modelVert.glsl", "modelFrag.glsl");
+
+	//One post effect per drawType
+	cShaderPermutations quadPermutations("assets/shaders/", "quadVert.glsl", "quadFrag.glsl");
+	quadPermutations.onCompile = [](cShaderProgram& program)
+	{
+		sQuadUniforms uniforms;
+		uniforms.bind(program);
+		program.useProgram();
+		uniforms.setScreenTexture(0);
+	};
+	for (int effect = 1; effect <= 5; effect++)
+		quadPermutations.prepare({ "POST_EFFECT " + std::to_string(effect) });
 
-	myProgram = new cShaderProgram();
-	myProgram->compileProgram("assets/shaders/", "quadVert.glsl", "quadFrag.glsl");
-	mapShaderToName["quadProgram"] = myProgram;
+	double programSubmitTime = glfwGetTime();
 
 	//Assemble all our models
 	std::string path = "assets/models/apple/apple textured obj.obj";
-	mapModelsToNames["Apple"] = new cModel(path);
+	registry.models.add("Apple", new cModel(path));
 
 	path = "assets/models/banana/banana.obj";
-	mapModelsToNames["Banana"] = new cModel(path);
+	registry.models.add("Banana", new cModel(path));
 
 	path = "assets/models/pumpkin/PumpkinOBJ.obj";
-	mapModelsToNames["Pumpkin"] = new cModel(path);
+	registry.models.add("Pumpkin", new cModel(path));
 
 	path = "assets/models/bean/chicago bean.obj";
-	mapModelsToNames["Bean"] = new cModel(path);
+	registry.models.add("Bean", new cModel(path));
+
+	//Loaded once for all the characters, which is what lets the pose cache see them as the same skeleton
+	cSkinnedMesh* characterMesh = new cSkinnedMesh("assets/modelsFBX/RPG-Character(FBX2013).FBX");
+	std::map<int, std::string> characterAnimations;
+	characterAnimations[0] = "assets/modelsFBX/RPG-Character_Unarmed-Idle(FBX2013).FBX";
+	characterAnimations[1] = "assets/modelsFBX/RPG-Character_Unarmed-Attack-Kick-L1(FBX2013).FBX";
 
 	//Creating two frame buffers: one to display within the scene, and one that displays the whole scene
 	cFrameBuffer mainFrameBuffer(SCR_HEIGHT, SCR_WIDTH);
@@ -143,26 +286,80 @@ int main()
 	cSkybox skybox("assets/textures/skybox/");
 	cSkybox spacebox("assets/textures/spacebox/");
 
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	mapShaderToName["skyboxProgram"]->useProgram();
-	mapShaderToName["skyboxProgram"]->setInt("skybox", 0);
-
-	mapShaderToName["mainProgram"]->useProgram();
-	mapShaderToName["mainProgram"]->setInt("skybox", 0);
-
-	mapShaderToName["quadProgram"]->useProgram();
-	mapShaderToName["quadProgram"]->setInt("screenTexture", 0);
-
-	//Before we start looping, save the one frame buffer texture
-	glBindFramebuffer(GL_FRAMEBUFFER, miniFrameBuffer.FBO);
-
-	glEnable(GL_DEPTH_TEST);
-	glStencilMask(0x00);
+	//Everything from here on draws straight away, so wait for whatever the driver hasn't finished
+	shaderManager.update();
+	unsigned int programsStillCompiling = shaderManager.getNumPending();
+	double programWaitTime = glfwGetTime();
+	shaderManager.finishAll();
+	registry.shaders.add("mainProgram", mainPermutations.getProgram({ "LIT", "UNIFORM_SCALE" }));
+	registry.shaders.add("reflectProgram", mainPermutations.getProgram({ "REFLECT", "UNIFORM_SCALE" }));
+	registry.shaders.add("refractProgram", mainPermutations.getProgram({ "REFRACT", "UNIFORM_SCALE" }));
+	registry.shaders.add("skinProgram", shaderManager.get("skinProgram"));
+	registry.shaders.add("instancedSkinProgram", shaderManager.get("instancedSkinProgram"));
+	registry.shaders.add("sampledSkinProgram", shaderManager.get("sampledSkinProgram"));
+	//Only a vertex shader, its outputs are captured into the vertex cache in sVertex order
+	cShaderProgram* skinFeedbackProgram = new cShaderProgram();
+	skinFeedbackProgram->compileFeedbackProgram("assets/shaders/", "skinVert.glsl", { "skinnedPosition", "skinnedNormal", "skinnedTexCoords" });
+	registry.shaders.add("skinFeedbackProgram", skinFeedbackProgram);
+	//Also vertex only, every point it draws is one bone's three palette texels
+	cShaderProgram* clipSampleProgram = new cShaderProgram();
+	clipSampleProgram->compileFeedbackProgram("assets/shaders/", "clipSampleVert.glsl", { "boneRow0", "boneRow1", "boneRow2" });
+	registry.shaders.add("clipSampleProgram", clipSampleProgram);
+	registry.shaders.add("skyboxProgram", shaderManager.get("skyboxProgram"));
+	registry.shaders.add("simpleProgram", shaderManager.get("simpleProgram"));
+	for (int effect = 1; effect <= 5; effect++)
+		registry.shaders.add("postEffect" + std::to_string(effect), quadPermutations.getProgram({ "POST_EFFECT " + std::to_string(effect) }));
+
+	registry.textures.add("skybox", sTextureResource(skybox.textureID, GL_TEXTURE_CUBE_MAP));
+	registry.textures.add("spacebox", sTextureResource(spacebox.textureID, GL_TEXTURE_CUBE_MAP));
+	registry.textures.add("mainScene", sTextureResource(mainFrameBuffer.textureID, GL_TEXTURE_2D));
+	registry.textures.add("miniScene", sTextureResource(miniFrameBuffer.textureID, GL_TEXTURE_2D));
+
+	//The last of the name lookups, from here on everything goes by handle
+	ModelHandle appleModel = registry.models.find("Apple");
+	ModelHandle bananaModel = registry.models.find("Banana");
+	ModelHandle pumpkinModel = registry.models.find("Pumpkin");
+	ModelHandle beanModel = registry.models.find("Bean");
+	ShaderHandle mainShader = registry.shaders.find("mainProgram");
+	ShaderHandle reflectShader = registry.shaders.find("reflectProgram");
+	ShaderHandle refractShader = registry.shaders.find("refractProgram");
+	ShaderHandle skyboxShader = registry.shaders.find("skyboxProgram");
+	ShaderHandle simpleShader = registry.shaders.find("simpleProgram");
+	ShaderHandle skinShader = registry.shaders.find("skinProgram");
+	ShaderHandle instancedSkinShader = registry.shaders.find("instancedSkinProgram");
+	ShaderHandle sampledSkinShader = registry.shaders.find("sampledSkinProgram");
+	ShaderHandle clipSampleShader = registry.shaders.find("clipSampleProgram");
+	ShaderHandle skinFeedbackShader = registry.shaders.find("skinFeedbackProgram");
+	ShaderHandle postEffectShaders[5];
+	for (int effect = 1; effect <= 5; effect++)
+		postEffectShaders[effect - 1] = registry.shaders.find("postEffect" + std::to_string(effect));
+	TextureHandle skyboxTexture = registry.textures.find("skybox");
+	TextureHandle spaceboxTexture = registry.textures.find("spacebox");
+	TextureHandle mainSceneTexture = registry.textures.find("mainScene");
+	TextureHandle miniSceneTexture = registry.textures.find("miniScene");
+
+	mainUniforms.bind(*registry.shaders.get(mainShader));
+	reflectUniforms.bind(*registry.shaders.get(reflectShader));
+	refractUniforms.bind(*registry.shaders.get(refractShader));
+	skyboxUniforms.bind(*registry.shaders.get(skyboxShader));
+	simpleUniforms.bind(*registry.shaders.get(simpleShader));
+	skinUniforms.bind(*registry.shaders.get(skinShader));
+	instancedSkinUniforms.bind(*registry.shaders.get(instancedSkinShader));
+	sampledSkinUniforms.bind(*registry.shaders.get(sampledSkinShader));
+
+	std::vector<ShaderHandle> shaderHandles = registry.shaders.getHandles();
+	unsigned int programsFromCache = 0;
+	for (unsigned int index = 0; index < shaderHandles.size(); index++)
+	{
+		if (registry.shaders.get(shaderHandles[index])->loadedFromBinary)
+			programsFromCache++;
+	}
+	std::cout << "Shader programs submitted in " << (programSubmitTime - programStartTime) * 1000.0 << " ms, then waited "
+		<< (glfwGetTime() - programWaitTime) * 1000.0 << " ms for " << programsStillCompiling << " still compiling after loading ("
+		<< programsFromCache << " of " << shaderHandles.size() << " from the binary cache, parallel compile "
+		<< (cShaderProgram::hasParallelCompile() ? "on" : "off") << ")" << std::endl;
 
-	//All the rendering commands go in here
-	glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	glm::mat4 staticProjection;
 	glm::mat4 staticView;
@@ -173,104 +370,377 @@ int main()
 	staticskyBoxView = glm::mat4(glm::mat3(defaultCamera.getViewMatrix()));
 
 	// view/projection transformations
-	mapShaderToName["mainProgram"]->useProgram();
-	mapShaderToName["mainProgram"]->setMat4("projection", staticProjection);
-	mapShaderToName["mainProgram"]->setMat4("view", staticView);
-	mapShaderToName["mainProgram"]->setInt("reflectRefract", 0);
+	registry.shaders.get(mainShader)->useProgram();
+	mainUniforms.setProjection(staticProjection);
+	mainUniforms.setView(staticView);
 
-	//Light settings go in here until I've made a class for them
 	{
 		//http://devernay.free.fr/cours/opengl/materials.html
-		mapShaderToName["mainProgram"]->setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		mapShaderToName["mainProgram"]->setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-		mapShaderToName["mainProgram"]->setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-		mapShaderToName["mainProgram"]->setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-
-		mapShaderToName["mainProgram"]->setVec3("pointLights[0].position", pointLightPositions[0]);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[0].constant", 1.0f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[0].linear", 0.09f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[0].quadratic", 0.032f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-
-		mapShaderToName["mainProgram"]->setVec3("pointLights[1].position", pointLightPositions[1]);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[1].constant", 1.0f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[1].linear", 0.09f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[1].quadratic", 0.032f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-
-		mapShaderToName["mainProgram"]->setVec3("pointLights[2].position", pointLightPositions[2]);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[2].constant", 1.0f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[2].linear", 0.09f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[2].quadratic", 0.032f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-
-		mapShaderToName["mainProgram"]->setVec3("pointLights[3].position", pointLightPositions[3]);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[3].constant", 1.0f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[3].linear", 0.09f);
-		mapShaderToName["mainProgram"]->setFloat("pointLights[3].quadratic", 0.032f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		mapShaderToName["mainProgram"]->setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-
-		mapShaderToName["mainProgram"]->setVec3("spotLight.position", defaultCamera.position);
-		mapShaderToName["mainProgram"]->setVec3("spotLight.direction", defaultCamera.front);
-		mapShaderToName["mainProgram"]->setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		mapShaderToName["mainProgram"]->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-		mapShaderToName["mainProgram"]->setFloat("spotLight.constant", 1.0f);
-		mapShaderToName["mainProgram"]->setFloat("spotLight.linear", 0.09f);
-		mapShaderToName["mainProgram"]->setFloat("spotLight.quadratic", 0.032f);
-		mapShaderToName["mainProgram"]->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		mapShaderToName["mainProgram"]->setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		mapShaderToName["mainProgram"]->setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+		sDirLight dirLight = sDirLight();
+		dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+		dirLight.ambient = glm::vec3(0.05f);
+		dirLight.diffuse = glm::vec3(0.4f);
+		dirLight.specular = glm::vec3(0.5f);
+		lights.setDirLight(dirLight);
+
+		for (unsigned int index = 0; index < MAX_POINT_LIGHTS; index++)
+		{
+			sPointLight pointLight = sPointLight();
+			pointLight.position = pointLightPositions[index];
+			pointLight.constant = 1.0f;
+			pointLight.linear = 0.09f;
+			pointLight.quadratic = 0.032f;
+			pointLight.ambient = glm::vec3(0.05f);
+			pointLight.diffuse = glm::vec3(0.8f);
+			pointLight.specular = glm::vec3(1.0f);
+			lights.setPointLight(index, pointLight);
+		}
+
+		sSpotLight spotLight = sSpotLight();
+		spotLight.position = defaultCamera.position;
+		spotLight.direction = defaultCamera.front;
+		spotLight.cutOff = glm::cos(glm::radians(12.5f));
+		spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+		spotLight.constant = 1.0f;
+		spotLight.linear = 0.09f;
+		spotLight.quadratic = 0.032f;
+		spotLight.ambient = glm::vec3(0.0f);
+		spotLight.diffuse = glm::vec3(1.0f);
+		spotLight.specular = glm::vec3(1.0f);
+		lights.setSpotLight(spotLight);
 		//http://wiki.ogre3d.org/tiki-index.php?page=-Point+Light+Attenuation
 	}
+	lights.upload();
+
+	//Where everything stands. None of it moves, so after the first frame no world matrix is rebuilt.
+	//The scene behind the stencil hangs off its own root and can be moved as one.
+	const glm::quat noRotation(1.0f, 0.0f, 0.0f, 0.0f);
+	cScene scene;
+	int miniBananaNode = scene.addNode(glm::vec3(1.0f, 0.0f, -2.0f), noRotation, glm::vec3(0.4f));	// it's a bit too big for our scene, so scale it down
+	int miniAppleNode = scene.addNode(glm::vec3(1.0f, 0.0f, -3.0f), noRotation, glm::vec3(0.012f));
+	int miniPumpkinNode = scene.addNode(glm::vec3(-1.0f, 0.4f, -4.0f), noRotation, glm::vec3(0.01f));
+
+	int maskPlaneNodes[2];
+	maskPlaneNodes[0] = scene.addNode(glm::vec3(1.5f, 0.0f, 1.0f), noRotation, glm::vec3(1.0f));
+	maskPlaneNodes[1] = scene.addNode(glm::vec3(-1.5f, 0.0f, 1.0f), noRotation, glm::vec3(1.0f));
+	int screenPlaneNode = scene.addNode(glm::vec3(0.0f, 0.0f, 1.0f), noRotation, glm::vec3(1.0f));
+	int refractBeanNode = scene.addNode(glm::vec3(-5.0f, 0.0f, -10.0f), noRotation, glm::vec3(1.0f));
+	int reflectBeanNode = scene.addNode(glm::vec3(5.0f, 0.0f, -10.0f), noRotation, glm::vec3(1.0f));
+
+	int spaceNode = scene.addNode(glm::vec3(0.0f), noRotation, glm::vec3(1.0f));
+	int spaceBananaNode = scene.addNode(glm::vec3(1.0f, 0.0f, -7.0f), noRotation, glm::vec3(0.4f), spaceNode);
+	int spaceAppleNode = scene.addNode(glm::vec3(1.0f, 0.0f, -8.0f), noRotation, glm::vec3(0.012f), spaceNode);
+	int spacePumpkinNode = scene.addNode(glm::vec3(0.0f, 0.4f, -9.0f), noRotation, glm::vec3(0.01f), spaceNode);
+	int spaceBeanNodes[2];
+	spaceBeanNodes[0] = scene.addNode(glm::vec3(-5.0f, 0.0f, -10.0f), noRotation, glm::vec3(1.0f), spaceNode);
+	spaceBeanNodes[1] = scene.addNode(glm::vec3(5.0f, 0.0f, -10.0f), noRotation, glm::vec3(1.0f), spaceNode);
+
+	//A row of characters taking turns between idling and kicking. Every one of a kind stands on the
+	//same frame, so each frame evaluates two poses between them and the pose cache hands those round.
+	const unsigned int NUM_CHARACTERS = 8;
+	cPoseCache poseCache;
+	poseCache.timeQuantum = 1.0f / 30.0f;
+	poseCache.snapPhase = true;
+	std::vector<cSkinnedGameObject*> characters;
+	//They stand their ground for now, but move (and keep out of each other's way) through the crowd
+	cCrowdSimulation crowd;
+	for (unsigned int index = 0; index < NUM_CHARACTERS; index++)
+	{
+		glm::vec3 position(-3.5f + (float)index, -1.0f, -6.0f);
+		cSkinnedGameObject* character = new cSkinnedGameObject(characterMesh, position, glm::vec3(0.005f), glm::vec3(0.0f), 1.0f,
+			characterAnimations);
+		character->animToPlay = characterAnimations[index % 2];
+		character->PoseCache = &poseCache;
+		character->JoinScene(&scene);
+		character->JoinCrowd(&crowd);
+		characters.push_back(character);
+	}
+	if (checkBlend)
+	{
+		bool blendMatches = checkBlendAgainstBoneTransform(characterMesh, characterAnimations[0], characterAnimations[1]);
+		glfwTerminate();
+		return blendMatches ? 0 : 1;
+	}
+	//Characters sharing a pose share its slice of the palette too, so this is more than they need
+	cBonePalette bonePalette(NUM_CHARACTERS * cSkinnedMesh::MAX_BONES_PER_MESH);
+	//Room for every character skinned on its own, which is also more than sharing needs
+	unsigned int characterVertices = 0;
+	for (unsigned int index = 0; index < characterMesh->GetMeshes().size(); index++)
+		characterVertices += (unsigned int)characterMesh->GetMeshes()[index].skinnedVertices.size();
+	cSkinnedVertexCache vertexCache(NUM_CHARACTERS * characterVertices);
+	cCPUSkinner skinner;
+
+	//A crowd further back. The GPU poses every one of them, so they cost the CPU nothing a frame beyond
+	//one instanced draw per sub-mesh. Baked, they all idle from one clip. Sampled, each runs the curves
+	//for itself and can sit anywhere between idling and kicking.
+	const unsigned int CROWD_ROWS = 16;
+	const unsigned int CROWD_COLUMNS = 16;
+	const float CROWD_SPACING = 1.5f;
+	const glm::vec3 crowdCentre(0.0f, -1.0f, -12.0f - CROWD_SPACING * (CROWD_ROWS - 1) * 0.5f);
+	cBakedAnimation crowdIdle(characterMesh, characterAnimations[0], 30.0f);
+	cInstancedCrowd bakedCrowd(characterMesh, &crowdIdle);
+	cClipCurves crowdClips(characterMesh, 30.0f);
+	int crowdIdleClip = crowdClips.addClip(characterAnimations[0]);
+	int crowdKickClip = crowdClips.addClip(characterAnimations[1]);
+	cSampledCrowd sampledCrowd(characterMesh, &crowdClips);
+	for (unsigned int row = 0; row < CROWD_ROWS; row++)
+	{
+		for (unsigned int column = 0; column < CROWD_COLUMNS; column++)
+		{
+			glm::vec3 position(CROWD_SPACING * ((float)column - (CROWD_COLUMNS - 1) * 0.5f), -1.0f, -12.0f - CROWD_SPACING * row);
+			//Each faces a little off straight ahead and is somewhere else in the clip, so the grid doesn't look stamped out
+			float heading = glm::radians(-30.0f + 15.0f * ((row * 3 + column) % 5));
+			sCrowdInstance instance;
+			instance.Model = glm::translate(glm::mat4(1.0f), position) * glm::rotate(glm::mat4(1.0f), heading, glm::vec3(0.0f, 1.0f, 0.0f))
+				* glm::scale(glm::mat4(1.0f), glm::vec3(0.005f));
+			instance.TimeOffset = crowdIdle.duration * (float)((row * CROWD_COLUMNS + column) * 7 % 32) / 32.0f;
+			bakedCrowd.instances.push_back(instance);
+
+			//Each column leans a little further into the kick than the last
+			sSampledCrowdInstance sampledInstance;
+			sampledInstance.Model = instance.Model;
+			sampledInstance.Clip[0] = crowdIdleClip;
+			sampledInstance.Clip[1] = crowdKickClip;
+			sampledInstance.TimeOffset[0] = instance.TimeOffset;
+			sampledInstance.TimeOffset[1] = instance.TimeOffset;
+			sampledInstance.Blend = (float)column / (CROWD_COLUMNS - 1);
+			sampledCrowd.instances.push_back(sampledInstance);
+		}
+	}
+	bakedCrowd.updateInstances();
+	sampledCrowd.updateInstances();
+	scene.updateWorldMatrices();
+
+	//Every draw goes through a render queue as a packet, sorted by state and depth before it's issued.
+	//These build the packets for the kinds of thing the scene draws.
+	auto submitModel = [](cRenderBucket& bucket, unsigned int pass, ModelHandle modelHandle, ShaderHandle shaderHandle,
+		const sMainUniforms& uniforms, TextureHandle environment, const glm::mat4& view, const glm::mat4& model,
+		const cFrustum* frustum) -> unsigned int
+	{
+		cModel* theModel = registry.models.get(modelHandle);
+		if (theModel == NULL)
+			return 0;
+
+		sTextureResource texture = registry.textures.get(environment);
+		sDrawPacket packet;
+		packet.program = registry.shaders.get(shaderHandle);
+		packet.textureID = texture.ID;
+		packet.textureTarget = texture.target;
+		packet.modelLocation = uniforms.locations[sMainUniforms::MODEL];
+		packet.model = model;
+		//How far in front of the camera the model's origin is
+		return theModel->Submit(bucket, pass, packet, -(view * model[3]).z, frustum);
+	};
+	auto submitPlane = [&planeObject, simpleShader](cRenderBucket& bucket, unsigned int pass, TextureHandle textureHandle,
+		const glm::mat4& view, const glm::mat4& model)
+	{
+		sTextureResource texture = registry.textures.get(textureHandle);
+		sDrawPacket packet;
+		packet.program = registry.shaders.get(simpleShader);
+		packet.textureID = texture.ID;
+		packet.textureTarget = texture.target;
+		packet.modelLocation = simpleUniforms.locations[sSimpleUniforms::MODEL];
+		packet.model = model;
+		packet.VAO = planeObject.VAO;
+		packet.indexed = true;
+		packet.count = 6;
+		bucket.submit(pass, packet, -(view * model[3]).z);
+	};
+	//The skybox and the screen quad are both a plain run of triangles with one texture
+	auto submitArrays = [](cRenderBucket& bucket, unsigned int pass, ShaderHandle shaderHandle, unsigned int VAO,
+		unsigned int count, TextureHandle textureHandle)
+	{
+		sTextureResource texture = registry.textures.get(textureHandle);
+		sDrawPacket packet;
+		packet.program = registry.shaders.get(shaderHandle);
+		packet.textureID = texture.ID;
+		packet.textureTarget = texture.target;
+		packet.VAO = VAO;
+		packet.count = count;
+		bucket.submit(pass, packet, 0.0f);
+	};
+
+	//Everything that can be culled, in one tree for the frame and one for the scene saved up front
+	std::vector<sSceneInstance> miniSceneInstances, frameInstances;
+	auto addInstance = [](std::vector<sSceneInstance>& instances, int node, unsigned int pass, ModelHandle model,
+		ShaderHandle shader, const sMainUniforms* uniforms, TextureHandle texture)
+	{
+		sSceneInstance instance;
+		instance.node = node;
+		instance.pass = pass;
+		instance.model = model;
+		instance.shader = shader;
+		instance.uniforms = uniforms;
+		instance.texture = texture;
+		instance.proxy = -1;
+		instances.push_back(instance);
+	};
+	addInstance(miniSceneInstances, miniBananaNode, PASS_SCENE, bananaModel, mainShader, &mainUniforms, skyboxTexture);
+	addInstance(miniSceneInstances, miniAppleNode, PASS_SCENE, appleModel, mainShader, &mainUniforms, skyboxTexture);
+	addInstance(miniSceneInstances, miniPumpkinNode, PASS_SCENE, pumpkinModel, mainShader, &mainUniforms, skyboxTexture);
+
+	//Two planes to be our stencil buffer mask, and one quad to place the first texture we made on
+	for (unsigned int index = 0; index < 2; index++)
+		addInstance(frameInstances, maskPlaneNodes[index], PASS_STENCIL_MASK, ModelHandle(), simpleShader, NULL, miniSceneTexture);
+	addInstance(frameInstances, screenPlaneNode, PASS_SCENE, ModelHandle(), simpleShader, NULL, miniSceneTexture);
+	//A surprise guest, the Chicago Bean, and another bean
+	addInstance(frameInstances, refractBeanNode, PASS_SCENE, beanModel, refractShader, &refractUniforms, skyboxTexture);
+	addInstance(frameInstances, reflectBeanNode, PASS_SCENE, beanModel, reflectShader, &reflectUniforms, skyboxTexture);
+	//The scene to appear in the stencil buffer
+	addInstance(frameInstances, spaceBananaNode, PASS_SPACE, bananaModel, mainShader, &mainUniforms, spaceboxTexture);
+	addInstance(frameInstances, spaceAppleNode, PASS_SPACE, appleModel, mainShader, &mainUniforms, spaceboxTexture);
+	addInstance(frameInstances, spacePumpkinNode, PASS_SPACE, pumpkinModel, mainShader, &mainUniforms, spaceboxTexture);
+	//Two more Beans, this time they're in space though, and I switched the reflect and refract around
+	for (unsigned int index = 0; index < 2; index++)
+		addInstance(frameInstances, spaceBeanNodes[index], PASS_SPACE, beanModel, refractShader, &refractUniforms, spaceboxTexture);
+
+	//The model's (or plane's) box moved to wherever its node stands
+	auto getInstanceBounds = [&scene, &planeObject](const sSceneInstance& instance, glm::vec3& worldMin, glm::vec3& worldMax)
+	{
+		cModel* model = registry.models.get(instance.model);
+		TransformAABB(scene.getWorldMatrix(instance.node), model ? model->boundsMin : planeObject.boundsMin,
+			model ? model->boundsMax : planeObject.boundsMax, worldMin, worldMax);
+	};
+	cAABBTree miniSceneTree, frameTree;
+	auto buildTree = [&getInstanceBounds](cAABBTree& tree, std::vector<sSceneInstance>& instances)
+	{
+		for (unsigned int index = 0; index < instances.size(); index++)
+		{
+			glm::vec3 worldMin, worldMax;
+			getInstanceBounds(instances[index], worldMin, worldMax);
+			instances[index].proxy = tree.insert(worldMin, worldMax, index);
+		}
+	};
+	buildTree(miniSceneTree, miniSceneInstances);
+	buildTree(frameTree, frameInstances);
+	//So a node that moves can take its box in the tree with it
+	std::vector<int> nodeFrameInstances(scene.getNumNodes(), -1);
+	for (unsigned int index = 0; index < frameInstances.size(); index++)
+		nodeFrameInstances[frameInstances[index].node] = index;
+
+	//Culls one pass against the camera and submits whatever of it is left.
+	//Models the tree lets through have their meshes culled one by one as well.
+	std::vector<int> visibleInstances;
+	auto cullPass = [&](const cAABBTree& tree, const std::vector<sSceneInstance>& instances, unsigned int pass,
+		const glm::mat4& projection, const glm::mat4& view, cRenderBucket& bucket)
+	{
+		cFrustum frustum(projection * view);
+		visibleInstances.clear();
+		tree.query(frustum, visibleInstances);
+
+		//Everything starts out counted as culled, and is moved across as it turns out visible
+		sCullStats& stats = cullStats[pass];
+		stats = sCullStats();
+		for (unsigned int index = 0; index < instances.size(); index++)
+		{
+			if (instances[index].pass != pass)
+				continue;
+			cModel* model = registry.models.get(instances[index].model);
+			stats.culled++;
+			stats.meshesCulled += model ? model->getNumMeshes() : 1;
+		}
+
+		for (unsigned int index = 0; index < visibleInstances.size(); index++)
+		{
+			const sSceneInstance& instance = instances[visibleInstances[index]];
+			if (instance.pass != pass)
+				continue;
+
+			unsigned int numMeshes = 1;
+			if (instance.model.isNull())
+				submitPlane(bucket, pass, instance.texture, view, scene.getWorldMatrix(instance.node));
+			else
+				numMeshes = submitModel(bucket, pass, instance.model, instance.shader, *instance.uniforms, instance.texture,
+					view, scene.getWorldMatrix(instance.node), &frustum);
+
+			stats.visible++;
+			stats.culled--;
+			stats.meshesVisible += numMeshes;
+			stats.meshesCulled -= numMeshes;
+		}
+	};
+
+	//Before we start looping, save the one frame buffer texture
+	cRenderQueue miniSceneQueue;
+	miniSceneQueue.setPassBegin(PASS_SCENE, [&miniFrameBuffer]()
+	{
+		cGLState::bindFramebuffer(miniFrameBuffer.FBO);
+		cGLState::enable(GL_DEPTH_TEST);
+		cGLState::depthFunc(GL_LESS);
+		cGLState::stencilMask(0x00);
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	});
+	miniSceneQueue.setPassBegin(PASS_SCENE_SKYBOX, []()
+	{
+		//So the skybox, drawn at the far plane, passes where nothing else was drawn
+		cGLState::depthFunc(GL_LEQUAL);
+	});
+
+	registry.shaders.get(skyboxShader)->useProgram();
+	skyboxUniforms.setProjection(staticProjection);
+	skyboxUniforms.setView(staticskyBoxView);
+
+	// render the loaded models
+	cRenderBucket& miniSceneBucket = miniSceneQueue.getBucket(0);
+	cullPass(miniSceneTree, miniSceneInstances, PASS_SCENE, staticProjection, staticView, miniSceneBucket);
+
+	submitArrays(miniSceneBucket, PASS_SCENE_SKYBOX, skyboxShader, skybox.VAO, 36, skyboxTexture);
+
+	miniSceneQueue.sort();
+	miniSceneQueue.execute();
+	cGLState::depthFunc(GL_LESS); // set depth function back to default
+
+	//The frame's passes, everything each one draws with is set at its start
+	cRenderQueue frameQueue(2);
+	frameQueue.setPassBegin(PASS_STENCIL_MASK, [&mainFrameBuffer]()
+	{
+		//Begin writing to another frame buffer
+		cGLState::bindFramebuffer(mainFrameBuffer.FBO);
+
+		//The stencil mask has to be open for the clear to reach the stencil buffer
+		cGLState::stencilMask(0xFF);
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-	// render the loaded model
-	glm::mat4 model(1.0f);
-	model = glm::translate(model, glm::vec3(1.0f, 0.0f, -2.0f)); // translate it down so it's at the center of the scene
-	model = glm::scale(model, glm::vec3(0.4f, 0.4f, 0.4f));	// it's a bit too big for our scene, so scale it down
-	mapShaderToName["mainProgram"]->setMat4("model", model);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-	mapModelsToNames["Banana"]->Draw(*mapShaderToName["mainProgram"]);
-
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(1.0f, 0.0f, -3.0f));
-	model = glm::scale(model, glm::vec3(0.012f));
-	mapShaderToName["mainProgram"]->setMat4("model", model);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-	mapModelsToNames["Apple"]->Draw(*mapShaderToName["mainProgram"]);
-
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-1.0f, 0.4f, -4.0f));
-	model = glm::scale(model, glm::vec3(0.01f));
-	mapShaderToName["mainProgram"]->setMat4("model", model);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-	mapModelsToNames["Pumpkin"]->Draw(*mapShaderToName["mainProgram"]);
-
-	//Drawing the skybox
-	mapShaderToName["skyboxProgram"]->useProgram();
-
-	glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-	mapShaderToName["skyboxProgram"]->setMat4("projection", staticProjection);
-	mapShaderToName["skyboxProgram"]->setMat4("view", staticskyBoxView);
-
-	glBindVertexArray(skybox.VAO);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glDepthFunc(GL_LESS); // set depth function back to default
-
-	//Restore these values for the rest of the models we render
-	mapShaderToName["mainProgram"]->useProgram();
-	mapShaderToName["mainProgram"]->setVec3("spotLight.position", Camera.position);
-	mapShaderToName["mainProgram"]->setVec3("spotLight.direction", Camera.front);
-	mapShaderToName["mainProgram"]->setInt("reflectRefract", 0);
+		//Two planes to be our stencil buffer mask
+		cGLState::enable(GL_DEPTH_TEST);
+		cGLState::depthFunc(GL_LESS);
+		cGLState::enable(GL_STENCIL_TEST);
+		cGLState::stencilFunc(GL_ALWAYS, 0, 0xFF);
+	});
+	frameQueue.setPassBegin(PASS_SCENE, []()
+	{
+		//The rest of the objects in the main scene mark the stencil buffer
+		cGLState::stencilFunc(GL_ALWAYS, 1, 0xFF);
+	});
+	frameQueue.setPassBegin(PASS_SCENE_SKYBOX, []()
+	{
+		cGLState::depthFunc(GL_LEQUAL);
+	});
+	frameQueue.setPassBegin(PASS_SPACE, []()
+	{
+		//The scene that appears through the stencil buffer
+		cGLState::depthFunc(GL_LESS);
+		cGLState::stencilFunc(GL_NOTEQUAL, 1, 0xFF);
+		cGLState::stencilMask(0x00);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	});
+	frameQueue.setPassBegin(PASS_SPACE_SKYBOX, []()
+	{
+		cGLState::depthFunc(GL_LEQUAL);
+	});
+	frameQueue.setPassBegin(PASS_POST, []()
+	{
+		//Final pass: Render all of the above on one quad
+		cGLState::depthFunc(GL_LESS);
+		cGLState::bindFramebuffer(0);
+		cGLState::disable(GL_DEPTH_TEST);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	});
 
+	float lastStateReport = glfwGetTime();
 	while (!glfwWindowShouldClose(window))
 	{
 		processInput(window);
@@ -279,159 +749,199 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		mapShaderToName["mainProgram"]->useProgram();
-		mapShaderToName["mainProgram"]->setVec3("cameraPos", Camera.position);
+		//How much of the last frame's state changes the cache and the queue saved, once a second
+		if (printStats && currentFrame - lastStateReport >= 1.0f)
+		{
+			std::cout << "State changes last frame: " << cGLState::getNumIssued() << " issued, "
+				<< cGLState::getNumSkipped() << " skipped, " << frameQueue.getNumPackets() << " draws with "
+				<< frameQueue.getNumProgramChanges() << " program and " << frameQueue.getNumMaterialChanges()
+				<< " material changes" << std::endl;
+			std::cout << "Culled last frame:";
+			for (unsigned int pass = 0; pass < NUM_SCENE_PASSES; pass++)
+			{
+				if (cullStats[pass].visible + cullStats[pass].culled == 0)
+					continue;
+				std::cout << " " << scenePassNames[pass] << " " << cullStats[pass].visible << " visible/" << cullStats[pass].culled
+					<< " culled (" << cullStats[pass].meshesVisible << "/" << cullStats[pass].meshesCulled << " meshes)";
+			}
+			std::cout << std::endl;
+			poseCache.printStats();
+			lastStateReport = currentFrame;
+		}
+		cGLState::beginFrame();
 
 		glm::mat4 projection = glm::perspective(glm::radians(Camera.zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = Camera.getViewMatrix();
 		glm::mat4 skyboxView = glm::mat4(glm::mat3(Camera.getViewMatrix()));
 
-		//Begin writing to another frame buffer
-		glBindFramebuffer(GL_FRAMEBUFFER, mainFrameBuffer.FBO);
+		//Each variant of the main shader is its own program, with its own copy of the camera
+		cShaderProgram* mainVariants[] = { registry.shaders.get(mainShader), registry.shaders.get(reflectShader), registry.shaders.get(refractShader) };
+		const sMainUniforms* mainVariantUniforms[] = { &mainUniforms, &reflectUniforms, &refractUniforms };
+		for (unsigned int index = 0; index < 3; index++)
+		{
+			mainVariants[index]->useProgram();
+			mainVariantUniforms[index]->setCameraPos(Camera.position);
+			mainVariantUniforms[index]->setProjection(projection);
+			mainVariantUniforms[index]->setView(view);
+		}
 
-		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		//The spotlight is a torch held by the camera, only its pose goes up each frame
+		lights.setSpotLightPose(Camera.position, Camera.front);
+		lights.upload();
 
-		//Create two planes to be our stencil buffer mask
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_STENCIL_TEST);
-		glStencilFunc(GL_ALWAYS, 0, 0xFF);
-		glStencilMask(0xFF);
-
-		mapShaderToName["simpleProgram"]->useProgram();
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(1.5f, 0.0f, 1.0f));
-		mapShaderToName["simpleProgram"]->setMat4("projection", projection);
-		mapShaderToName["simpleProgram"]->setMat4("view", view);
-		mapShaderToName["simpleProgram"]->setMat4("model", model);
-		glBindVertexArray(planeObject.VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-1.5f, 0.0f, 1.0f));
-		mapShaderToName["simpleProgram"]->setMat4("model", model);
-		glBindVertexArray(planeObject.VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		//Draw the rest of the objects in the main scene, as well as the skybox
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-
-		//Draw one quad to place the first texture we made on
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 1.0f));
-		mapShaderToName["simpleProgram"]->setMat4("model", model);
-		glBindTexture(GL_TEXTURE_2D, miniFrameBuffer.textureID);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-		glBindVertexArray(planeObject.VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		//A surprise guest, the Chicago Bean
-		mapShaderToName["mainProgram"]->useProgram();
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-5.0f, 0.0f, -10.0f));
-		model = glm::scale(model, glm::vec3(1.0f));
-		mapShaderToName["mainProgram"]->setMat4("projection", projection);
-		mapShaderToName["mainProgram"]->setMat4("view", view);
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 2);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-		mapModelsToNames["Bean"]->Draw(*mapShaderToName["mainProgram"]);
-
-		//And another bean
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(5.0f, 0.0f, -10.0f));
-		model = glm::scale(model, glm::vec3(1.0f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 1);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-		mapModelsToNames["Bean"]->Draw(*mapShaderToName["mainProgram"]);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 0);
-		
-		//Drawing the main scene's skybox
-		mapShaderToName["skyboxProgram"]->useProgram();
-
-		glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-		mapShaderToName["skyboxProgram"]->setMat4("projection", projection);
-		mapShaderToName["skyboxProgram"]->setMat4("view", skyboxView);
-
-		glBindVertexArray(skybox.VAO);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.textureID);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glDepthFunc(GL_LESS); // set depth function back to default
-
-		//Render the scene to appear in the stencil buffer
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00);
-		glClear(GL_DEPTH_BUFFER_BIT);
+		//Characters hand their speeds to the crowd and take last step's positions to their scene nodes
+		for (unsigned int index = 0; index < characters.size(); index++)
+		{
+			characters[index]->Move(deltaTime);
+		}
+		crowd.step(deltaTime);
 
-		mapShaderToName["mainProgram"]->useProgram();
-
-		glm::mat4 model(1.0f);
-		model = glm::translate(model, glm::vec3(1.0f, 0.0f, -7.0f));
-		model = glm::scale(model, glm::vec3(0.4f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		mapModelsToNames["Banana"]->Draw(*mapShaderToName["mainProgram"]);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(1.0f, 0.0f, -8.0f));
-		model = glm::scale(model, glm::vec3(0.012f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		mapModelsToNames["Apple"]->Draw(*mapShaderToName["mainProgram"]);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.4f, -9.0f));
-		model = glm::scale(model, glm::vec3(0.01f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		mapModelsToNames["Pumpkin"]->Draw(*mapShaderToName["mainProgram"]);
-
-		//Two more Beans, this time they're in space though, and I switched the reflect and refract around
-		mapShaderToName["mainProgram"]->useProgram();
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-5.0f, 0.0f, -10.0f));
-		model = glm::scale(model, glm::vec3(1.0f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 2);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		mapModelsToNames["Bean"]->Draw(*mapShaderToName["mainProgram"]);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(5.0f, 0.0f, -10.0f));
-		model = glm::scale(model, glm::vec3(1.0f));
-		mapShaderToName["mainProgram"]->setMat4("model", model);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 2);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		mapModelsToNames["Bean"]->Draw(*mapShaderToName["mainProgram"]);
-		mapShaderToName["mainProgram"]->setInt("reflectRefract", 0);
-
-		//Drawing the skybox for the stencil scene
-		mapShaderToName["skyboxProgram"]->useProgram();
-
-		glDepthFunc(GL_LEQUAL);
-		glBindVertexArray(skybox.VAO);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, spacebox.textureID);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glDepthFunc(GL_LESS);
-		glStencilMask(0xFF);
-
-		//Clear out the stencil buffer
-		glClear(GL_STENCIL_BUFFER_BIT);
-		glStencilMask(0x00);
+		//Only what moved since last frame gets its world matrix rebuilt, and takes its box in the tree along
+		scene.updateWorldMatrices();
+		const std::vector<unsigned int>& movedNodes = scene.getUpdatedNodes();
+		for (unsigned int index = 0; index < movedNodes.size(); index++)
+		{
+			int instance = nodeFrameInstances[movedNodes[index]];
+			if (instance == -1)
+				continue;
+			glm::vec3 worldMin, worldMax;
+			getInstanceBounds(frameInstances[instance], worldMin, worldMax);
+			frameTree.update(frameInstances[instance].proxy, worldMin, worldMax);
+		}
 
-		//Final pass: Render all of the above on one quad
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glDisable(GL_DEPTH_TEST);
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		//Skybox transformations are shared by both skyboxes
+		registry.shaders.get(skyboxShader)->useProgram();
+		skyboxUniforms.setProjection(projection);
+		skyboxUniforms.setView(skyboxView);
+		registry.shaders.get(simpleShader)->useProgram();
+		simpleUniforms.setProjection(projection);
+		simpleUniforms.setView(view);
+		registry.shaders.get(skinShader)->useProgram();
+		skinUniforms.setProjection(projection);
+		skinUniforms.setView(view);
+		cShaderProgram* crowdProgram;
+		if (crowdSampled)
+		{
+			//Every instance's palette for this frame, before anything draws from it
+			sampledCrowd.Sample(*registry.shaders.get(clipSampleShader), currentFrame);
+			crowdProgram = registry.shaders.get(sampledSkinShader);
+			crowdProgram->useProgram();
+			sampledSkinUniforms.setProjection(projection);
+			sampledSkinUniforms.setView(view);
+			sampledCrowd.bind(*crowdProgram);
+		}
+		else
+		{
+			crowdProgram = registry.shaders.get(instancedSkinShader);
+			crowdProgram->useProgram();
+			instancedSkinUniforms.setProjection(projection);
+			instancedSkinUniforms.setView(view);
+			instancedSkinUniforms.setTime(currentFrame);
+			crowdIdle.bind(*crowdProgram);
+		}
+
+		//The characters' poses, shared through the cache where they can be, then all their bones in one upload
+		cFrustum cameraFrustum(projection * view);
+		if (swapCharacterAnimations)
+		{
+			for (unsigned int index = 0; index < characters.size(); index++)
+			{
+				bool idling = characters[index]->animToPlay == characterAnimations[0];
+				characters[index]->animToPlay = characterAnimations[idling ? 1 : 0];
+			}
+			swapCharacterAnimations = false;
+		}
+		poseCache.beginFrame();
+		bonePalette.beginFrame();
+		for (unsigned int index = 0; index < characters.size(); index++)
+		{
+			//Skinning on the CPU reads the poses straight off the characters, the palette goes unused
+			characters[index]->Update(skinningMode == SKIN_CPU ? NULL : &bonePalette, &cameraFrustum, Camera.position);
+		}
+		bonePalette.upload();
+		//The palette keeps a texture unit to itself, so binding it once covers every character's packets
+		cShaderProgram* skinProgram = registry.shaders.get(skinShader);
+		skinProgram->useProgram();
+		bonePalette.bind(*skinProgram);
+
+		//Skinned once here, then both views draw the results as plain meshes
+		if (skinningMode == SKIN_FEEDBACK)
+		{
+			cShaderProgram* skinFeedbackProgram = registry.shaders.get(skinFeedbackShader);
+			vertexCache.beginFrame();
+			vertexCache.beginSkinning(*skinFeedbackProgram);
+			bonePalette.bind(*skinFeedbackProgram);
+			for (unsigned int index = 0; index < characters.size(); index++)
+			{
+				characters[index]->Skin(&vertexCache, *skinFeedbackProgram);
+			}
+			vertexCache.endSkinning();
+		}
+		else if (skinningMode == SKIN_CPU)
+		{
+			vertexCache.beginFrame();
+			for (unsigned int index = 0; index < characters.size(); index++)
+			{
+				characters[index]->QueueCPUSkinning(&skinner);
+			}
+			skinner.run();
+			skinner.upload(&vertexCache);
+		}
+
+		//The main scene and what shows through the stencil go in separately, either could be built on another thread
+		frameQueue.clear();
+		cRenderBucket& sceneBucket = frameQueue.getBucket(0);
+		cRenderBucket& spaceBucket = frameQueue.getBucket(1);
+
+		//Only what the camera can see goes into each pass
+		cullPass(frameTree, frameInstances, PASS_STENCIL_MASK, projection, view, sceneBucket);
+		cullPass(frameTree, frameInstances, PASS_SCENE, projection, view, sceneBucket);
+		cullPass(frameTree, frameInstances, PASS_SPACE, projection, view, spaceBucket);
+
+		//The characters stand in both views. They culled themselves in Update, so they only need counting in.
+		unsigned int numCharacterMeshes = (unsigned int)characterMesh->GetMeshes().size();
+		const unsigned int characterPasses[] = { PASS_SCENE, PASS_SPACE };
+		cRenderBucket* characterBuckets[] = { &sceneBucket, &spaceBucket };
+		for (unsigned int index = 0; index < characters.size(); index++)
+		{
+			for (unsigned int pass = 0; pass < 2; pass++)
+			{
+				if (skinningMode == SKIN_IN_SHADER)
+					characters[index]->Submit(*characterBuckets[pass], characterPasses[pass], skinProgram, skinUniforms, view);
+				else
+					characters[index]->SubmitSkinned(*characterBuckets[pass], characterPasses[pass], &vertexCache,
+						registry.shaders.get(mainShader), mainUniforms.locations[sMainUniforms::MODEL], view);
+
+				sCullStats& stats = cullStats[characterPasses[pass]];
+				if (characters[index]->Visible)
+				{
+					stats.visible++;
+					stats.meshesVisible += numCharacterMeshes;
+				}
+				else
+				{
+					stats.culled++;
+					stats.meshesCulled += numCharacterMeshes;
+				}
+			}
+		}
+
+		//The crowd is one packet per sub-mesh for the lot, sorted as if it all stood at its middle
+		float crowdDepth = -(view * glm::vec4(crowdCentre, 1.0f)).z;
+		if (crowdSampled)
+			sampledCrowd.Submit(sceneBucket, PASS_SCENE, crowdProgram, sampledSkinUniforms, crowdDepth);
+		else
+			bakedCrowd.Submit(sceneBucket, PASS_SCENE, crowdProgram, instancedSkinUniforms, crowdDepth);
+
+		//The skyboxes cover everything, there's nothing to cull
+		submitArrays(sceneBucket, PASS_SCENE_SKYBOX, skyboxShader, skybox.VAO, 36, skyboxTexture);
+		submitArrays(spaceBucket, PASS_SPACE_SKYBOX, skyboxShader, skybox.VAO, 36, spaceboxTexture);
 
 		//Paste the entire scene onto a quad as a single texture
-		mapShaderToName["quadProgram"]->useProgram();
-		mapShaderToName["quadProgram"]->setInt("drawType", drawType);
-		glBindVertexArray(screenQuad.VAO);
-		glBindTexture(GL_TEXTURE_2D, mainFrameBuffer.textureID);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		submitArrays(sceneBucket, PASS_POST, postEffectShaders[drawType - 1], screenQuad.VAO, 6, mainSceneTexture);
+
+		frameQueue.sort();
+		frameQueue.execute();
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -476,6 +986,28 @@ void processInput(GLFWwindow* window)
 		Camera.processKeyboard(Camera_Movement::RIGHT, deltaTime);
 }
 
+//Switches that should flip once per press rather than every frame the key is held
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if (action != GLFW_PRESS)
+		return;
+
+	if (key == GLFW_KEY_M)
+	{
+		skinningMode = (skinningMode + 1) % NUM_SKINNING_MODES;
+		std::cout << "Skinning characters " << skinningModeNames[skinningMode] << std::endl;
+	}
+	else if (key == GLFW_KEY_C)
+	{
+		crowdSampled = !crowdSampled;
+		std::cout << "Crowd " << (crowdSampled ? "sampling clip curves" : "playing its baked clip") << std::endl;
+	}
+	else if (key == GLFW_KEY_N)
+		swapCharacterAnimations = true;
+	else if (key == GLFW_KEY_P)
+		printStats = !printStats;
+}
+
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
 	if (firstMouse) // this bool variable is initially set to true
@@ -502,7 +1034,7 @@ unsigned int loadCubeMap(std::string directory, std::vector<std::string> faces)
 {
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	cGLState::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
 
 	int width, height, nrChannels;
 	for (unsigned int i = 0; i < faces.size(); i++)
@@ -537,4 +1069,56 @@ unsigned int loadCubeMap(std::string directory, std::vector<std::string> faces)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
 	return textureID;
-}
\ No newline at end of file
+}
+
+//A blend giving one clip all the weight has to land on exactly the pose BoneTransform gives for that
+//clip alone. Checks both ends of a two clip blend at a few times and prints the largest difference.
+bool checkBlendAgainstBoneTransform(cSkinnedMesh* mesh, const std::string& animationA, const std::string& animationB)
+{
+	//Bone matrices are in the model's own units, so this is a small fraction of a centimetre
+	const float TOLERANCE = 0.01f;
+	const float times[] = { 0.0f, 0.1f, 0.55f, 1.3f };
+
+	std::vector<glm::mat4> blended, blendedGlobals;
+	std::vector<glm::mat4> expected, expectedGlobals, offsets;
+	cPosePool pool;
+	sBlendClip clips[2];
+	clips[0].clip = mesh->FindClip(animationA);
+	clips[1].clip = mesh->FindClip(animationB);
+	if (clips[0].clip < 0 || clips[1].clip < 0)
+	{
+		std::cout << "Blend check: the clips aren't loaded" << std::endl;
+		return false;
+	}
+
+	float largestError = 0.0f;
+	for (unsigned int time = 0; time < sizeof(times) / sizeof(times[0]); time++)
+	{
+		for (unsigned int weight = 0; weight <= 1; weight++)
+		{
+			clips[0].time = clips[1].time = times[time];
+			clips[0].weight = (float)weight;
+			clips[1].weight = 1.0f - (float)weight;
+			pool.beginFrame();
+			mesh->BlendTransform(clips, 2, pool, blended, blendedGlobals);
+			mesh->BoneTransform(times[time], weight == 1 ? animationA : animationB, expected, expectedGlobals, offsets);
+
+			float error = 0.0f;
+			for (unsigned int bone = 0; bone < expected.size() && bone < blended.size(); bone++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					for (int row = 0; row < 4; row++)
+						error = std::max(error, std::fabs(blended[bone][column][row] - expected[bone][column][row]));
+				}
+			}
+			std::cout << "Blend check: " << (weight == 1 ? "first" : "second") << " clip alone at " << times[time]
+				<< "s is off by at most " << error << std::endl;
+			largestError = std::max(largestError, error);
+		}
+	}
+
+	bool matches = largestError <= TOLERANCE;
+	std::cout << "Blend check " << (matches ? "passed" : "FAILED") << ", largest difference " << largestError << std::endl;
+	return matches;
+}
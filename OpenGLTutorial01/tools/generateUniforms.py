@@ -0,0 +1,270 @@
+"""Writes cShaderUniforms.h, a typed uniform interface for each of our shader programs.
+
+Every plain uniform the program's stages declare (in any #ifdef branch, and inside any
+#include) gets an enum entry, a slot in a location array and a set function taking the
+matching glm type. Struct uniforms are flattened into their members. Uniform blocks are
+skipped, they go through buffers (see cLightBuffer).
+
+Run from the pre-build step of the project:
+    python tools/generateUniforms.py assets/shaders cShaderUniforms.h
+The step is skipped on machines without Python on the PATH, which build with the header as
+checked in, so commit the regenerated header along with any change to a shader's uniforms.
+The header is only rewritten when its contents change, so nothing rebuilds needlessly.
+"""
+
+import os
+import re
+import sys
+
+# Struct name, then the stages that are linked together
+PROGRAMS = [
+    ("Main", ["vertShader.glsl", "fragShader.glsl"]),
+    ("Skin", ["animVert.glsl", "animFrag.glsl"]),
+    ("InstancedSkin", ["animInstancedVert.glsl", "animFrag.glsl"]),
+    ("SampledSkin", ["animSampledVert.glsl", "animFrag.glsl"]),
+    ("SkinFeedback", ["skinVert.glsl"]),
+    ("ClipSample", ["clipSampleVert.glsl"]),
+    ("Skybox", ["skyBoxVert.glsl", "skyBoxFrag.glsl"]),
+    ("Simple", ["modelVert.glsl", "modelFrag.glsl"]),
+    ("Quad", ["quadVert.glsl", "quadFrag.glsl"]),
+    ("Lamp", ["lampVert.glsl", "lampFrag.glsl"]),
+    ("Fallback", ["fallbackVert.glsl", "fallbackFrag.glsl"]),
+]
+
+# GLSL type -> (C++ type, glUniform call for one value, glUniform call for an array)
+# {loc}, {value} and {count} are filled in per uniform
+SCALAR = "{loc}, {value}"
+TYPES = {
+    "float": ("float", "glUniform1f(" + SCALAR + ")", "glUniform1fv({loc}, {count}, {value})"),
+    "int": ("int", "glUniform1i(" + SCALAR + ")", "glUniform1iv({loc}, {count}, {value})"),
+    "bool": ("bool", "glUniform1i(" + SCALAR + ")", None),
+    "uint": ("unsigned int", "glUniform1ui(" + SCALAR + ")", "glUniform1uiv({loc}, {count}, {value})"),
+}
+for size in (2, 3, 4):
+    TYPES["vec%d" % size] = ("glm::vec%d" % size, "glUniform%dfv({loc}, 1, glm::value_ptr({value}))" % size,
+                             "glUniform%dfv({loc}, {count}, &{value}[0].x)" % size)
+    TYPES["ivec%d" % size] = ("glm::ivec%d" % size, "glUniform%div({loc}, 1, glm::value_ptr({value}))" % size,
+                              "glUniform%div({loc}, {count}, &{value}[0].x)" % size)
+for size in (3, 4):
+    TYPES["mat%d" % size] = ("glm::mat%d" % size, "glUniformMatrix%dfv({loc}, 1, GL_FALSE, glm::value_ptr({value}))" % size,
+                             "glUniformMatrix%dfv({loc}, {count}, GL_FALSE, &{value}[0][0].x)" % size)
+
+SAMPLER = re.compile(r"^[iu]?sampler\w+$")
+
+INCLUDE = re.compile(r'^[ \t]*#include[ \t]*"([^"]+)"[^\n]*$', re.M)
+DEFINE = re.compile(r"^[ \t]*#define[ \t]+(\w+)[ \t]+(\d+)[ \t]*$", re.M)
+STRUCT = re.compile(r"\bstruct\s+(\w+)\s*\{([^}]*)\}\s*;")
+BLOCK = re.compile(r"\buniform\s+\w+\s*\{[^}]*\}\s*\w*\s*(\[[^\]]*\])?\s*;")
+UNIFORM = re.compile(r"\buniform\s+(?:(?:lowp|mediump|highp)\s+)?(\w+)\s+([^;{]+);")
+DECLARATION = re.compile(r"\s*(\w+)\s*(?:\[\s*(\w+)\s*\])?\s*$")
+
+
+class GeneratorError(Exception):
+    pass
+
+
+def read_source(directory, name, included):
+    """The file's text with its #includes expanded in place, each file at most once (like cShader)"""
+    included.add(name)
+    with open(os.path.join(directory, name), "r") as file:
+        text = file.read()
+
+    def expand(match):
+        if match.group(1) in included:
+            return ""
+        return read_source(directory, match.group(1), included)
+
+    return INCLUDE.sub(expand, text)
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", " ", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def array_size(size, defines, where):
+    if size is None:
+        return None
+    if size.isdigit():
+        return int(size)
+    if size in defines:
+        return int(defines[size])
+    raise GeneratorError("%s: can't work out the size of array [%s]" % (where, size))
+
+
+def parse_declarations(body, defines, where):
+    """(type, name, array size or None) for every declaration in a struct body or uniform line"""
+    declarations = []
+    for statement in body.split(";"):
+        statement = statement.strip()
+        if not statement:
+            continue
+        parts = statement.split(None, 1)
+        if len(parts) != 2:
+            raise GeneratorError("%s: can't read '%s'" % (where, statement))
+        glsl_type, names = parts
+        for declaration in names.split(","):
+            match = DECLARATION.match(declaration)
+            if match is None:
+                raise GeneratorError("%s: can't read '%s'" % (where, statement))
+            declarations.append((glsl_type, match.group(1), array_size(match.group(2), defines, where)))
+    return declarations
+
+
+def flatten(glsl_type, name, size, structs, where):
+    """The uniforms GL actually gives locations to: struct members and arrays of structs get
+    expanded, arrays of plain types stay one entry that is set all at once"""
+    if glsl_type in structs:
+        members = []
+        elements = [name] if size is None else ["%s[%d]" % (name, index) for index in range(size)]
+        for element in elements:
+            for member_type, member_name, member_size in structs[glsl_type]:
+                members += flatten(member_type, element + "." + member_name, member_size, structs, where)
+        return members
+
+    if glsl_type not in TYPES and not SAMPLER.match(glsl_type):
+        raise GeneratorError("%s: no C++ type for uniform %s %s" % (where, glsl_type, name))
+    return [(glsl_type, name, size)]
+
+
+def parse_program(directory, stages):
+    uniforms = []
+    seen = {}
+    for stage in stages:
+        text = strip_comments(read_source(directory, stage, set()))
+        defines = dict(DEFINE.findall(text))
+        structs = {}
+        for struct_name, body in STRUCT.findall(text):
+            structs[struct_name] = parse_declarations(body, defines, stage)
+        text = BLOCK.sub("", STRUCT.sub("", text))
+
+        for glsl_type, names in UNIFORM.findall(text):
+            for declared_type, name, size in parse_declarations(glsl_type + " " + names, defines, stage):
+                for uniform in flatten(declared_type, name, size, structs, stage):
+                    if uniform[1] in seen:
+                        if seen[uniform[1]] != uniform:
+                            raise GeneratorError("%s: %s is declared differently in another stage" % (stage, uniform[1]))
+                        continue
+                    seen[uniform[1]] = uniform
+                    uniforms.append(uniform)
+    return uniforms
+
+
+def words(name):
+    return [word for word in re.split(r"[^A-Za-z0-9]+|(?<=[a-z0-9])(?=[A-Z])", name) if word]
+
+
+def enum_name(name):
+    return "_".join(word.upper() for word in words(name))
+
+
+def setter_name(name):
+    return "set" + "".join(word[0].upper() + word[1:] for word in words(name))
+
+
+def write_setter(lines, glsl_type, name, size):
+    cpp_type, single_call, array_call = TYPES["int"] if SAMPLER.match(glsl_type) else TYPES[glsl_type]
+    location = "locations[%s]" % enum_name(name)
+    if size is None:
+        parameter = cpp_type + " value" if cpp_type in ("float", "int", "bool", "unsigned int") else "const %s& value" % cpp_type
+        call = single_call.format(loc=location, value="value")
+    else:
+        if array_call is None:
+            raise GeneratorError("no array setter for %s %s[]" % (glsl_type, name))
+        parameter = "const %s* values, int count" % cpp_type
+        call = array_call.format(loc=location, value="values", count="count")
+
+    lines.append("\tvoid %s(%s) const" % (setter_name(name), parameter))
+    lines.append("\t{")
+    lines.append("\t\t%s;" % call)
+    lines.append("\t}")
+
+
+def generate(directory):
+    lines = [
+        "//Generated by tools/generateUniforms.py from assets/shaders, don't edit by hand.",
+        "//The project runs it before every build that can find Python, the rest build with the checked-in copy.",
+        "#ifndef _HG_cShaderUniforms_",
+        "#define _HG_cShaderUniforms_",
+        "",
+        "#include <glad/glad.h>",
+        "#include <glm/glm.hpp>",
+        "#include <glm/gtc/type_ptr.hpp>",
+        "",
+        '#include "cShaderProgram.h"',
+        "",
+        "//One struct per program, bind() it to a linked program once and then set uniforms through it.",
+        "//Setting goes straight to a location in an array, and a misspelt uniform doesn't compile.",
+        "//Uniforms a permutation compiled out keep location -1, which the GL quietly ignores.",
+    ]
+
+    for struct_name, stages in PROGRAMS:
+        uniforms = parse_program(directory, stages)
+        struct_name = "s%sUniforms" % struct_name
+
+        lines.append("")
+        lines.append("//" + ", ".join(stages))
+        lines.append("struct %s" % struct_name)
+        lines.append("{")
+        lines.append("\tenum eUniform")
+        lines.append("\t{")
+        for glsl_type, name, size in uniforms:
+            lines.append("\t\t%s," % enum_name(name))
+        lines.append("\t\tNUM_UNIFORMS")
+        lines.append("\t};")
+        lines.append("")
+        lines.append("\tint locations[NUM_UNIFORMS];")
+        lines.append("")
+        lines.append("\t%s()" % struct_name)
+        lines.append("\t{")
+        lines.append("\t\tfor (int index = 0; index < NUM_UNIFORMS; index++)")
+        lines.append("\t\t\tlocations[index] = -1;")
+        lines.append("\t}")
+        lines.append("")
+        lines.append("\tvoid bind(const cShaderProgram& program)")
+        lines.append("\t{")
+        lines.append("\t\tstatic const char* const names[NUM_UNIFORMS] = {")
+        for glsl_type, name, size in uniforms:
+            lines.append('\t\t\t"%s",' % name)
+        lines.append("\t\t};")
+        lines.append("\t\tstatic constexpr unsigned int hashes[NUM_UNIFORMS] = {")
+        for glsl_type, name, size in uniforms:
+            lines.append('\t\t\tUniformNameHash("%s"),' % name)
+        lines.append("\t\t};")
+        lines.append("\t\tfor (int index = 0; index < NUM_UNIFORMS; index++)")
+        lines.append("\t\t\tlocations[index] = program.getUniformLocation(names[index], hashes[index]);")
+        lines.append("\t}")
+        for glsl_type, name, size in uniforms:
+            lines.append("")
+            write_setter(lines, glsl_type, name, size)
+        lines.append("};")
+
+    lines.append("")
+    lines.append("#endif")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("usage: generateUniforms.py <shader directory> <output header>")
+        return 1
+
+    try:
+        header = generate(sys.argv[1])
+    except (GeneratorError, IOError) as error:
+        print("generateUniforms.py: error: %s" % error)
+        return 1
+
+    output = sys.argv[2]
+    if os.path.exists(output):
+        with open(output, "r") as file:
+            if file.read() == header:
+                return 0
+    with open(output, "w") as file:
+        file.write(header)
+    print("generateUniforms.py: wrote %s" % output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())